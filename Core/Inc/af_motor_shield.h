@@ -1,4 +1,8 @@
+#ifndef MY_SENSORS_AF_MOTOR_SHIELD_H
+#define MY_SENSORS_AF_MOTOR_SHIELD_H
+
 #include <stdint-gcc.h>
+#include <stdbool.h>
 #include "stm32f3xx_hal.h"
 
 struct AFMotorShield;
@@ -20,6 +24,7 @@ typedef struct AFMotorShield AFMotorShield;
 #define MOTOR3_B 7
 
 typedef enum DCMotorCommand {
+    KEEP = 0,   // leaves the motor as it is, for AFMotorShield_RunDCMotors
     FORWARD = 1,
     BACKWARD = 2,
     BRAKE = 3,
@@ -33,11 +38,49 @@ typedef enum MOTOR_t {
     MOTOR_4 = 4
 } MOTOR_t;
 
+#define AF_MOTOR_SHIELD_MOTORS 4
+
 typedef struct AFMotorShieldPeripheral {
     TIM_HandleTypeDef *htim;
     uint16_t channel;
 } AFMotorShieldPeripheral;
 
+typedef struct AFMotorShieldCommand {
+    DCMotorCommand command;
+    uint8_t speed;  // duty cycle of the PWM out of 255; RELEASE sets 0
+} AFMotorShieldCommand;
+
+// freq is the PWM frequency in kHz, which the motors of one timer share
 AFMotorShield * AFMotorShield_InitDCMotor(MOTOR_t num, uint8_t freq, AFMotorShieldPeripheral peripheral);
+/* Sets the duty cycle out of 255 and stops a ramp of the motor. The compare register is preloaded, so the new speed
+ * starts with the next PWM period.
+ */
 void AFMotorShield_SetSpeed(AFMotorShield * self, uint8_t speed);
+/* Changes the duty cycle linearly to speed within ramp_ms without taking task time: the update interrupt of the
+ * timer moves the compare value one step every PWM period, and is disabled again when the last ramp on the timer
+ * ends or is cut short by a new speed.
+ */
+void AFMotorShield_RampSpeed(AFMotorShield * self, uint8_t speed, uint32_t ramp_ms);
+bool AFMotorShield_IsRamping(const AFMotorShield * self);
+/* For control loops in interrupt context, without a ramp on the motor: writes the compare register as it is, from 0
+ * to AFMotorShield_GetPeriodTicks() for a duty cycle of 100 %.
+ */
+void AFMotorShield_SetCompare(AFMotorShield * self, uint32_t compare);
+uint32_t AFMotorShield_GetPeriodTicks(const AFMotorShield * self);
+// Index + 1 of the motor in the commands of AFMotorShield_RunDCMotors()
+MOTOR_t AFMotorShield_GetMotor(const AFMotorShield * self);
+/* Direction in the latch and duty cycle out of 255 of a motor, whoever drives it, e.g. for telemetry.
+ * Returns false when the motor is not initialized.
+ */
+bool AFMotorShield_GetState(MOTOR_t num, AFMotorShieldCommand *state);
+// Called from HAL_TIM_PeriodElapsedCallback
+void AFMotorShield_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
 void AFMotorShield_RunDCMotor(AFMotorShield * self, DCMotorCommand command);
+
+/* Changes several motors at once, e.g. both wheels of a rover: commands is indexed by MOTOR_t - 1 and every motor
+ * but those with KEEP has to be initialized. The directions go out in one transfer of the latch, and the duty
+ * cycles take effect together at the next update event of their timers, whose compare registers are preloaded.
+ */
+void AFMotorShield_RunDCMotors(const AFMotorShieldCommand commands[AF_MOTOR_SHIELD_MOTORS]);
+
+#endif //MY_SENSORS_AF_MOTOR_SHIELD_H
@@ -0,0 +1,12 @@
+#ifndef MY_SENSORS_APP_H
+#define MY_SENSORS_APP_H
+
+/*
+ * Bodies of the application tasks created in main.c.
+ * They live outside of main.c so that the same task set can be built for the host (see Host/).
+ */
+_Noreturn void App_RunBlinkLed(void);
+_Noreturn void App_RunI2cUsers(void);
+_Noreturn void App_RunMotion(void);
+
+#endif //MY_SENSORS_APP_H
@@ -23,8 +23,25 @@
 #define INC_BME280_STM32_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "stm32f3xx_hal.h"
 
+struct BME280;
+typedef struct BME280 BME280;
+
+// Two sensors per bus on each of the buses of i2c_bus.h
+#define BME280_MAX_SENSORS 4
+
+// 7 bit addresses, selected with the SDO pin
+#define BME280_ADDRESS_SDO_LOW  0x76
+#define BME280_ADDRESS_SDO_HIGH 0x77
+
+// The bus is shared through i2c_bus.h and has to be initialized with I2CBus_Init first
+typedef struct BME280Peripheral {
+    I2C_HandleTypeDef *hi2c;
+    uint8_t address;
+} BME280Peripheral;
+
 /* Configuration for the BME280
 
  * @osrs is the oversampling to improve the accuracy
@@ -33,7 +50,7 @@
  *
  * @mode can be used to set the mode for the device
  *       MODE_SLEEP will put the device in sleep
- *       MODE_FORCED device goes back to sleep after one measurement. You need to use the BME280_WakeUP() function before every measurement
+ *       MODE_FORCED device goes back to sleep after one measurement. You need to use the BME280_WakeUP() or BME280_MeasureAll() function before every measurement
  *       MODE_NORMAL device performs measurement in the normal mode. Check datasheet page no 16
  *
  * @t_sb is the standby time. The time sensor waits before performing another measurement
@@ -44,29 +61,89 @@
  *         Check datasheet page no 18 and page no 30
  */
 
-int BME280_Init(uint8_t osrs_t, uint8_t osrs_p, uint8_t osrs_h, uint8_t mode, uint8_t t_sb, uint8_t filter);
+typedef enum {
+    BME280_OK = 0,
+    BME280_ERROR_BUS,       // no acknowledge or a bus error, e.g. the sensor is detached
+    BME280_ERROR_CHIP_ID,   // another device answers at the address
+    BME280_ERROR_CONFIG,    // the registers do not read back as written
+    BME280_ERROR_TIMEOUT,   // still busy after the maximum time of the datasheet
+} BME280_Status_t;
 
-
-// Read the Trimming parameters saved in the NVM ROM of the device
-void TrimRead(void);
+/* Trimming parameters of one sensor as per the datasheet (page no. 24), in the order the compensation reads them;
+ * 34 bytes without padding, so a batch keeps the whole calibration within one cache line.
+ */
+typedef struct BME280_Calibration {
+    uint16_t dig_T1;
+    int16_t dig_T2, dig_T3;
+    uint16_t dig_P1;
+    int16_t dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
+    uint8_t dig_H1, dig_H3;
+    int16_t dig_H2, dig_H4, dig_H5;
+    int8_t dig_H6;
+    bool pressure_32bit;    // 1 Pa resolution; set by BME280_Configure when the IIR filter is off
+} BME280_Calibration;
+
+// Contents of the data registers, 20 bit temperature and pressure and 16 bit humidity
+typedef struct BME280_RawSample {
+    int32_t t, p, h;
+} BME280_RawSample;
+
+// Compensated sample in the fixed-point formats of the datasheet
+typedef struct BME280_Sample {
+    int32_t temperature_centi_c;    // 0.01 C
+    uint32_t pressure_q8_pa;        // Pa in Q24.8, 1/256 Pa
+    uint32_t humidity_q10_pct;      // %RH in Q22.10, 1/1024 %RH
+} BME280_Sample;
+
+// Returns NULL when no BME280 answers at the address; every sensor keeps its own calibration
+BME280 *BME280_Init(BME280Peripheral peripheral, uint8_t osrs_t, uint8_t osrs_p, uint8_t osrs_h, uint8_t mode,
+                    uint8_t t_sb, uint8_t filter);
+
+// Changes the configuration of an initialized sensor, with the parameters of BME280_Init
+BME280_Status_t BME280_Configure(BME280 *self, uint8_t osrs_t, uint8_t osrs_p, uint8_t osrs_h, uint8_t mode,
+                                 uint8_t t_sb, uint8_t filter);
+
+// Maximum time of a measurement with the configured oversampling, about 9.3 ms at OSRS_1 and 113 ms at OSRS_16
+uint32_t BME280_GetMeasurementTimeUs(const BME280 *self);
 
 /* To be used when doing the force measurement
  * the Device need to be put in forced mode every time the measurement is needed
+ * Returns once the data registers hold the new measurement, after about BME280_GetMeasurementTimeUs()
  */
-void BME280_WakeUP(void);
+BME280_Status_t BME280_WakeUP(BME280 *self);
 
-/* measure the temp, pressure and humidity
- * the values will be stored in the parameters passed to the function
+/* measure the temp, pressure and humidity with one burst read of the data registers
+ * After an error the values read 0 and the next call checks the chip ID and configures the sensor again
+ * before reading, so a sensor that was plugged back in recovers by itself.
  */
-void BME280_Measure (void);
+BME280_Status_t BME280_Measure(BME280 *self);
 
-float BME280_GetTemperature(void);
+// Reads the data registers only, e.g. to log raw samples and compensate them later in a batch
+BME280_Status_t BME280_MeasureRaw(BME280 *self, BME280_RawSample *raw);
 
-float BME280_GetPressure(void);
+/* Compensates count raw samples with integer arithmetic only; the pressure takes the 32 bit path of the datasheet
+ * when calib->pressure_32bit is set and the 64 bit one otherwise. raw and samples may not overlap.
+ */
+void BME280_Compensate(const BME280_Calibration *calib, const BME280_RawSample *raw, BME280_Sample *samples,
+                       size_t count);
 
-float BME280_GetHumidity(void);
+const BME280_Calibration *BME280_GetCalibration(const BME280 *self);
 
-bool BME280_IsInitialized();
+/* Samples several sensors, on one bus or several, in the time of the slowest one instead of the sum: the sensors
+ * in forced mode are all woken up before the task sleeps once for the longest measurement time, then every sensor
+ * is read. Sensors in normal mode are read only. statuses receives the status of every sensor and may be NULL;
+ * returns the number of sensors measured.
+ */
+size_t BME280_MeasureAll(BME280 *const *sensors_to_sample, size_t count, BME280_Status_t *statuses);
+
+// Last sample of BME280_Measure or BME280_MeasureAll, all zero after an error
+BME280_Sample BME280_GetSample(const BME280 *self);
+
+float BME280_GetTemperature(const BME280 *self);
+
+float BME280_GetPressure(const BME280 *self);
+
+float BME280_GetHumidity(const BME280 *self);
 
 // Oversampling definitions
 #define OSRS_OFF    	0x00
@@ -99,6 +176,8 @@ bool BME280_IsInitialized();
 #define IIR_16      	0x04
 
 
+#define BME280_CHIP_ID  0x60
+
 // REGISTERS DEFINITIONS
 #define ID_REG      	0xD0
 #define RESET_REG  		0xE0
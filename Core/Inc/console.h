@@ -1,13 +1,37 @@
-
 #ifndef MY_SENSORS_CONSOLE_H
 #define MY_SENSORS_CONSOLE_H
+#include <stddef.h>
 #include "stm32f3xx_hal.h"
 
+/*
+ * Console_Print formats the message and copies it into a transmit ring buffer. The UART sends the buffer
+ * with HAL_UART_Transmit_IT and the transmit complete interrupt starts the next chunk, so the caller does
+ * not wait for the line. A message that does not fit in the free space is dropped as a whole and counted.
+ *
+ * Console_Print may be called from several tasks, but not from interrupts. The UART interrupt must have a
+ * priority that allows RTOS calls (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY or lower).
+ */
+
+#ifndef CONSOLE_TX_BUFFER_SIZE
+#define CONSOLE_TX_BUFFER_SIZE (512)    // power of two
+#endif
+
 struct Console;
 typedef struct Console Console;
 
+typedef struct Console_Stats {
+    uint32_t bytes;             // bytes queued for transmission
+    uint32_t dropped_bytes;     // bytes of the messages that did not fit
+    uint32_t max_used;          // highest fill level of the transmit buffer
+} Console_Stats;
+
 void Console_Init(UART_HandleTypeDef *huart);
 
 void Console_Print(const char *format, ...);
 
+// Queues raw bytes, e.g. binary telemetry frames; dropped as a whole like a message that does not fit
+void Console_Write(const uint8_t *data, size_t size);
+
+Console_Stats Console_GetStats(void);
+
 #endif //MY_SENSORS_CONSOLE_H
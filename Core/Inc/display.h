@@ -17,12 +17,16 @@ typedef struct {
     const uint8_t FontWidth;    /*!< Font width in pixels */
     uint8_t FontHeight;   /*!< Font height in pixels */
     const uint16_t *data; /*!< Pointer to data font data array */
+    const uint32_t *columns; /*!< Same glyphs transposed into columns (bit n = row n), NULL if not generated */
 } DISPLAY_FONT;
 
 extern DISPLAY_FONT Font_11x18;
 
 void Display_Init(I2C_HandleTypeDef * p_hi2c1);
 void Display_Fill(DISPLAY_COLOR color);
+// Publishes the frame drawn so far; a low-priority task sends the changed part of it to the display
+void Display_SwapBuffers(void);
+// Same as Display_SwapBuffers()
 void Display_UpdateScreen(void);
 void Display_DrawPixel(uint8_t x, uint8_t y, DISPLAY_COLOR color);
 char Display_WriteChar(char ch, DISPLAY_FONT Font, DISPLAY_COLOR color);
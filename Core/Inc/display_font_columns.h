@@ -0,0 +1,106 @@
+// Generated by tools/gen_font_columns.py from the fonts of display.c, do not edit.
+#ifndef MY_SENSORS_DISPLAY_FONT_COLUMNS_H
+#define MY_SENSORS_DISPLAY_FONT_COLUMNS_H
+
+#include <stdint.h>
+
+// 11x18, one word per column, bit n is row n
+static const uint32_t Font_columns_11x18 [] = {
+        0x00000, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000,   // sp
+        0x00000, 0x00000, 0x00000, 0x00000, 0x06FFE, 0x06FFE, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000,   // !
+        0x00000, 0x00000, 0x00000, 0x0003E, 0x0003E, 0x00000, 0x0003E, 0x0003E, 0x00000, 0x00000, 0x00000,   // "
+        0x00000, 0x00660, 0x07F60, 0x07FFE, 0x006FE, 0x00660, 0x07F60, 0x07FFE, 0x006FE, 0x00660, 0x00000,   // #
+        0x00000, 0x01C38, 0x03C7C, 0x070EE, 0x060C6, 0x1FFFE, 0x06186, 0x03F1C, 0x01E18, 0x00000, 0x00000,   // $
+        0x0003C, 0x0187E, 0x00C42, 0x0067E, 0x0033C, 0x03D80, 0x07EC0, 0x04260, 0x07E30, 0x03C18, 0x00000,   // %
+        0x00000, 0x01E00, 0x03F3C, 0x0617E, 0x061C6, 0x063C6, 0x0367E, 0x01C3C, 0x07F00, 0x02300, 0x00000,   // &
+        0x00000, 0x00000, 0x00000, 0x00000, 0x0003E, 0x0003E, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000,   // '
+        0x00000, 0x00000, 0x00000, 0x00000, 0x00FC0, 0x07FF8, 0x0E01C, 0x18006, 0x20001, 0x00000, 0x00000,   // (
+        0x00000, 0x00000, 0x20001, 0x18006, 0x0E01C, 0x07FF8, 0x00FC0, 0x00000, 0x00000, 0x00000, 0x00000,   // )
+        0x00000, 0x00000, 0x0002C, 0x00038, 0x0001E, 0x0001E, 0x00038, 0x0002C, 0x00000, 0x00000, 0x00000,   // *
+        0x00180, 0x00180, 0x00180, 0x00180, 0x01FF8, 0x01FF8, 0x00180, 0x00180, 0x00180, 0x00180, 0x00000,   // +
+        0x00000, 0x00000, 0x00000, 0x00000, 0x26000, 0x1E000, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000,   // ,
+        0x00000, 0x00000, 0x00000, 0x00600, 0x00600, 0x00600, 0x00600, 0x00000, 0x00000, 0x00000, 0x00000,   // -
+        0x00000, 0x00000, 0x00000, 0x00000, 0x06000, 0x06000, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000,   // .
+        0x00000, 0x00000, 0x00000, 0x07000, 0x07F00, 0x00FF0, 0x000FE, 0x0000E, 0x00000, 0x00000, 0x00000,   // /
+        0x00000, 0x00FF0, 0x03FFC, 0x0700E, 0x06186, 0x06186, 0x0700E, 0x03FFC, 0x00FF0, 0x00000, 0x00000,   // 0
+        0x00000, 0x00000, 0x00030, 0x00018, 0x0000C, 0x07FFE, 0x07FFE, 0x00000, 0x00000, 0x00000, 0x00000,   // 1
+        0x00000, 0x07038, 0x0783C, 0x06C0E, 0x06606, 0x06306, 0x0618E, 0x060FC, 0x06078, 0x00000, 0x00000,   // 2
+        0x00000, 0x01818, 0x0381C, 0x07006, 0x060C6, 0x060C6, 0x071FC, 0x03F38, 0x01E00, 0x00000, 0x00000,   // 3
+        0x00000, 0x00E00, 0x00F80, 0x00DF0, 0x00C3C, 0x07FFE, 0x07FFE, 0x00C00, 0x00C00, 0x00000, 0x00000,   // 4
+        0x00000, 0x019FE, 0x039FE, 0x07086, 0x060C6, 0x060C6, 0x071C6, 0x03F86, 0x01F00, 0x00000, 0x00000,   // 5
+        0x00000, 0x00FF0, 0x03FFC, 0x0718E, 0x060C6, 0x060C6, 0x071CE, 0x03F9C, 0x01F18, 0x00000, 0x00000,   // 6
+        0x00000, 0x00006, 0x00006, 0x07006, 0x07F06, 0x007C6, 0x000F6, 0x0003E, 0x0000E, 0x00000, 0x00000,   // 7
+        0x00000, 0x01E38, 0x03F7C, 0x06186, 0x06186, 0x06186, 0x0618E, 0x03F7C, 0x01E38, 0x00000, 0x00000,   // 8
+        0x00000, 0x018F8, 0x039FC, 0x0738E, 0x06306, 0x06306, 0x0718E, 0x03FFC, 0x00FF0, 0x00000, 0x00000,   // 9
+        0x00000, 0x00000, 0x00000, 0x00000, 0x06060, 0x06060, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000,   // :
+        0x00000, 0x00000, 0x00000, 0x00000, 0x260C0, 0x1E0C0, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000,   // ;
+        0x00000, 0x00100, 0x00380, 0x00280, 0x006C0, 0x00440, 0x00C60, 0x00820, 0x01830, 0x00000, 0x00000,   // <
+        0x00000, 0x00660, 0x00660, 0x00660, 0x00660, 0x00660, 0x00660, 0x00660, 0x00660, 0x00000, 0x00000,   // =
+        0x00000, 0x01830, 0x00820, 0x00C60, 0x00440, 0x006C0, 0x00280, 0x00380, 0x00100, 0x00000, 0x00000,   // >
+        0x00000, 0x00018, 0x0001C, 0x0000E, 0x06E06, 0x06F06, 0x00386, 0x001CE, 0x000FC, 0x00078, 0x00000,   // ?
+        0x00000, 0x00FF0, 0x03FFC, 0x0701E, 0x063C6, 0x067C6, 0x03666, 0x007FC, 0x007F8, 0x00000, 0x00000,   // @
+        0x00000, 0x07000, 0x07F80, 0x00FF8, 0x0067E, 0x00606, 0x0067E, 0x00FF8, 0x07F80, 0x07000, 0x00000,   // A
+        0x00000, 0x07FFE, 0x07FFE, 0x06186, 0x06186, 0x06186, 0x073FC, 0x03E78, 0x01C00, 0x00000, 0x00000,   // B
+        0x00000, 0x00FF0, 0x03FFC, 0x0700E, 0x06006, 0x06006, 0x06006, 0x0381C, 0x01818, 0x00000, 0x00000,   // C
+        0x00000, 0x07FFE, 0x07FFE, 0x06006, 0x06006, 0x06006, 0x0381C, 0x01FFC, 0x007F0, 0x00000, 0x00000,   // D
+        0x00000, 0x07FFE, 0x07FFE, 0x06186, 0x06186, 0x06186, 0x06186, 0x06186, 0x06006, 0x00000, 0x00000,   // E
+        0x00000, 0x07FFE, 0x07FFE, 0x00186, 0x00186, 0x00186, 0x00186, 0x00186, 0x00006, 0x00000, 0x00000,   // F
+        0x00000, 0x00FF0, 0x03FFC, 0x0700E, 0x06006, 0x06006, 0x06306, 0x03F1C, 0x03F18, 0x00000, 0x00000,   // G
+        0x00000, 0x07FFE, 0x07FFE, 0x00180, 0x00180, 0x00180, 0x00180, 0x07FFE, 0x07FFE, 0x00000, 0x00000,   // H
+        0x00000, 0x00000, 0x06006, 0x06006, 0x07FFE, 0x07FFE, 0x06006, 0x06006, 0x00000, 0x00000, 0x00000,   // I
+        0x00000, 0x01C00, 0x03C00, 0x07000, 0x06000, 0x06000, 0x07000, 0x03FFE, 0x01FFE, 0x00000, 0x00000,   // J
+        0x00000, 0x07FFE, 0x07FFE, 0x00180, 0x001C0, 0x00770, 0x00E38, 0x0380C, 0x07006, 0x04002, 0x00000,   // K
+        0x00000, 0x07FFE, 0x07FFE, 0x06000, 0x06000, 0x06000, 0x06000, 0x06000, 0x06000, 0x00000, 0x00000,   // L
+        0x00000, 0x07FFE, 0x07FFE, 0x0001E, 0x000F8, 0x00180, 0x000F8, 0x0000E, 0x07FFE, 0x07FFE, 0x00000,   // M
+        0x00000, 0x07FFE, 0x07FFE, 0x0003E, 0x001F8, 0x01FC0, 0x07C00, 0x07FFE, 0x07FFE, 0x00000, 0x00000,   // N
+        0x00000, 0x00FF0, 0x03FFC, 0x0700E, 0x06006, 0x06006, 0x0700E, 0x03FFC, 0x00FF0, 0x00000, 0x00000,   // O
+        0x00000, 0x07FFE, 0x07FFE, 0x00306, 0x00306, 0x00306, 0x0038E, 0x001FC, 0x000F8, 0x00000, 0x00000,   // P
+        0x00000, 0x00FF0, 0x03FFC, 0x0700E, 0x06006, 0x06C06, 0x0780E, 0x03FFC, 0x02FF0, 0x04000, 0x00000,   // Q
+        0x00000, 0x07FFE, 0x07FFE, 0x00186, 0x00186, 0x00386, 0x00FCE, 0x03CFC, 0x07078, 0x04000, 0x00000,   // R
+        0x00000, 0x00C00, 0x03C78, 0x070FC, 0x060C6, 0x06186, 0x06386, 0x03F1C, 0x01E18, 0x00000, 0x00000,   // S
+        0x00006, 0x00006, 0x00006, 0x00006, 0x07FFE, 0x07FFE, 0x00006, 0x00006, 0x00006, 0x00006, 0x00000,   // T
+        0x00000, 0x01FFE, 0x03FFE, 0x07000, 0x06000, 0x06000, 0x07000, 0x03FFE, 0x01FFE, 0x00000, 0x00000,   // U
+        0x00000, 0x0000E, 0x0007E, 0x007F0, 0x03F80, 0x07800, 0x03F80, 0x007F0, 0x0007E, 0x0000E, 0x00000,   // V
+        0x0007E, 0x07FFE, 0x07000, 0x01E00, 0x003C0, 0x003C0, 0x01E00, 0x07000, 0x07FFE, 0x0007E, 0x00000,   // W
+        0x04002, 0x0700E, 0x0383C, 0x01E70, 0x00FE0, 0x007C0, 0x00E70, 0x03C38, 0x0700E, 0x04002, 0x00000,   // X
+        0x00002, 0x0000E, 0x0003C, 0x000F0, 0x07FC0, 0x07FC0, 0x000F0, 0x0003C, 0x0000E, 0x00002, 0x00000,   // Y
+        0x00000, 0x07000, 0x07806, 0x06E06, 0x06786, 0x061C6, 0x06076, 0x0603E, 0x0600E, 0x00000, 0x00000,   // Z
+        0x00000, 0x00000, 0x00000, 0x00000, 0x3FFFF, 0x3FFFF, 0x30003, 0x30003, 0x00000, 0x00000, 0x00000,   // [
+        0x00000, 0x00000, 0x00000, 0x0000E, 0x000FE, 0x00FF0, 0x07F00, 0x07000, 0x00000, 0x00000, 0x00000,   /* \ */
+        0x00000, 0x00000, 0x00000, 0x30003, 0x30003, 0x3FFFF, 0x3FFFF, 0x00000, 0x00000, 0x00000, 0x00000,   // ]
+        0x00000, 0x00180, 0x001E0, 0x00078, 0x0000E, 0x0000E, 0x00078, 0x001E0, 0x00180, 0x00000, 0x00000,   // ^
+        0x10000, 0x10000, 0x10000, 0x10000, 0x10000, 0x10000, 0x10000, 0x10000, 0x10000, 0x10000, 0x10000,   // _
+        0x00000, 0x00000, 0x00002, 0x00006, 0x0000E, 0x00008, 0x00000, 0x00000, 0x00000, 0x00000, 0x00000,   // `
+        0x00000, 0x03880, 0x07CC0, 0x06660, 0x06660, 0x02660, 0x03660, 0x03FE0, 0x07FC0, 0x04000, 0x00000,   // a
+        0x00000, 0x07FFE, 0x07FFE, 0x030C0, 0x06060, 0x06060, 0x070E0, 0x03FC0, 0x01F80, 0x00000, 0x00000,   // b
+        0x00000, 0x01F80, 0x03FC0, 0x070E0, 0x06060, 0x06060, 0x070E0, 0x039C0, 0x01980, 0x00000, 0x00000,   // c
+        0x00000, 0x01F80, 0x03FC0, 0x070E0, 0x06060, 0x06060, 0x030C0, 0x07FFE, 0x07FFE, 0x00000, 0x00000,   // d
+        0x00000, 0x01F80, 0x03FC0, 0x076E0, 0x06660, 0x06660, 0x066E0, 0x037C0, 0x01700, 0x00000, 0x00000,   // e
+        0x00000, 0x00060, 0x00060, 0x00060, 0x07FFC, 0x07FFE, 0x00066, 0x00066, 0x00066, 0x00006, 0x00000,   // f
+        0x00000, 0x18FC0, 0x39FE0, 0x33870, 0x33030, 0x33030, 0x39860, 0x1FFF0, 0x0FFF0, 0x00000, 0x00000,   // g
+        0x00000, 0x07FFE, 0x07FFE, 0x000C0, 0x00060, 0x00060, 0x00060, 0x07FE0, 0x07FC0, 0x00000, 0x00000,   // h
+        0x00000, 0x00000, 0x00060, 0x00060, 0x00060, 0x07FE6, 0x07FE6, 0x00000, 0x00000, 0x00000, 0x00000,   // i
+        0x00000, 0x18000, 0x30030, 0x30030, 0x30030, 0x3FFF3, 0x1FFF3, 0x00000, 0x00000, 0x00000, 0x00000,   // j
+        0x00000, 0x07FFE, 0x07FFE, 0x00600, 0x00300, 0x00780, 0x01CC0, 0x03860, 0x06020, 0x04000, 0x00000,   // k
+        0x00000, 0x00000, 0x00006, 0x00006, 0x00006, 0x07FFE, 0x07FFE, 0x00000, 0x00000, 0x00000, 0x00000,   // l
+        0x07FE0, 0x07FE0, 0x00040, 0x00060, 0x07FE0, 0x07FE0, 0x000C0, 0x00060, 0x07FE0, 0x07FC0, 0x00000,   // m
+        0x00000, 0x07FE0, 0x07FE0, 0x000C0, 0x00060, 0x00060, 0x00060, 0x07FE0, 0x07FC0, 0x00000, 0x00000,   // n
+        0x00000, 0x01F80, 0x03FC0, 0x070E0, 0x06060, 0x06060, 0x070E0, 0x03FC0, 0x01F80, 0x00000, 0x00000,   // o
+        0x00000, 0x3FFF0, 0x3FFF0, 0x01860, 0x03030, 0x03030, 0x03870, 0x01FE0, 0x00FC0, 0x00000, 0x00000,   // p
+        0x00000, 0x00FC0, 0x01FE0, 0x03870, 0x03030, 0x03030, 0x01860, 0x3FFF0, 0x3FFF0, 0x00000, 0x00000,   // q
+        0x00000, 0x00020, 0x07FE0, 0x07FC0, 0x000C0, 0x00060, 0x00060, 0x000E0, 0x00040, 0x00000, 0x00000,   // r
+        0x00000, 0x03380, 0x037C0, 0x06660, 0x06660, 0x06660, 0x06660, 0x03EC0, 0x01CC0, 0x00000, 0x00000,   // s
+        0x00000, 0x00060, 0x00060, 0x03FF8, 0x07FFC, 0x06060, 0x06060, 0x06060, 0x06000, 0x00000, 0x00000,   // t
+        0x00000, 0x03FE0, 0x07FE0, 0x06000, 0x06000, 0x06000, 0x03000, 0x07FE0, 0x07FE0, 0x00000, 0x00000,   // u
+        0x00000, 0x00020, 0x001E0, 0x00FC0, 0x03E00, 0x07000, 0x07E00, 0x00FC0, 0x001E0, 0x00020, 0x00000,   // v
+        0x000E0, 0x01FE0, 0x07800, 0x01FE0, 0x000E0, 0x01FE0, 0x07800, 0x01FE0, 0x000E0, 0x00000, 0x00000,   // w
+        0x00000, 0x04020, 0x070E0, 0x039C0, 0x00F00, 0x00F00, 0x039C0, 0x070E0, 0x04020, 0x00000, 0x00000,   // x
+        0x00000, 0x30030, 0x301F0, 0x38FC0, 0x1FE00, 0x1F000, 0x07F80, 0x00FF0, 0x00070, 0x00000, 0x00000,   // y
+        0x00000, 0x06060, 0x07060, 0x07860, 0x06C60, 0x06660, 0x06360, 0x061E0, 0x060E0, 0x06060, 0x00000,   // z
+        0x00000, 0x00000, 0x00000, 0x00300, 0x00780, 0x1FFFE, 0x3FCFF, 0x30003, 0x30003, 0x00000, 0x00000,   // {
+        0x00000, 0x00000, 0x00000, 0x00000, 0x00000, 0x3FFFF, 0x3FFFF, 0x00000, 0x00000, 0x00000, 0x00000,   // |
+        0x00000, 0x00000, 0x30003, 0x30003, 0x3FCFF, 0x1FFFE, 0x00780, 0x00300, 0x00000, 0x00000, 0x00000,   // }
+        0x00000, 0x00300, 0x00180, 0x00180, 0x00180, 0x00300, 0x00300, 0x00300, 0x00180, 0x00000, 0x00000,   // ~
+};
+
+#endif //MY_SENSORS_DISPLAY_FONT_COLUMNS_H
@@ -2,11 +2,34 @@
 #define MY_SENSORS_HCSR04_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint-gcc.h>
 #include "stm32f3xx_hal.h"
 
+struct HCSR04;
+typedef struct HCSR04 HCSR04;
+
 typedef float (*HCSR04_External_Dependency_t)(void);
 
+#define HCSR04_MAX_SENSORS 6
+
+// Thread flag used to wake the task waiting for the echo; do not use it for anything else
+#define HCSR04_THREAD_FLAG (1U << 25)
+
+// The echo pulse lasts at most 38 ms when nothing reflects the burst
+#define HCSR04_ECHO_TIMEOUT_MS 60U
+
+// Trigger rates of the continuous mode; the module ignores triggers while its echo line is high
+#define HCSR04_MIN_RATE_HZ 2U
+#define HCSR04_MAX_RATE_HZ 40U
+// Samples buffered between the capture interrupt and the consumer, per sensor; a power of two
+#define HCSR04_SAMPLE_BUFFER_SIZE 32U
+
+typedef struct HCSR04_Sample {
+    uint32_t timestamp_ms;  // HAL_GetTick() at the end of the echo
+    uint32_t echo_ticks;    // width of the echo pulse in ticks of the echo timer, 38 ms without obstacle
+} HCSR04_Sample;
+
 typedef enum {
     HCSR04_DONE = 0,
     HCSR04_BEGIN = HCSR04_DONE,
@@ -17,10 +40,73 @@ typedef enum {
     HCSR04_CALCULATE_DISTANCE,
 } HCSR04_Execution_State_t;
 
-void HCSR04_Init(GPIO_TypeDef  *GPIOx, uint16_t trig_pin, uint16_t echo_pin,  TIM_HandleTypeDef * htim, HCSR04_External_Dependency_t getHumidity, HCSR04_External_Dependency_t getTemperature);
-float HCSR04_MeasureDistanceInMeters(void);
-HCSR04_Execution_State_t HCSR04_MeasureDistanceInMetersNonBlocking(float * out_distance_m, HCSR04_Execution_State_t current_state);
+/* trigger_htim is a timer in one-pulse mode whose channel output is wired to TRIG, e.g. htim16 with PWM mode 2
+ * at 1 MHz; every sensor needs a timer of its own. echo_htim captures both edges of ECHO on echo_channel at
+ * 1 MHz or faster, counting up to Init.Period; sensors can share the timer, one per channel, so htim15 serves two.
+ * A 16 bit echo timer is extended to 32 bits with its update interrupt, which HAL_TIM_PeriodElapsedCallback
+ * has to pass on to HCSR04_PeriodElapsedCallback.
+ */
+typedef struct HCSR04Peripheral {
+    TIM_HandleTypeDef *trigger_htim;
+    uint32_t trigger_channel;
+    TIM_HandleTypeDef *echo_htim;
+    uint32_t echo_channel;
+} HCSR04Peripheral;
+
+/* Starts the capture interrupt of the echo channel. The speed of sound is common to all the sensors and is taken
+ * from the dependencies of the last sensor initialized.
+ */
+HCSR04 *HCSR04_Init(HCSR04Peripheral peripheral, HCSR04_External_Dependency_t getHumidity,
+                    HCSR04_External_Dependency_t getTemperature);
+/* The speed of sound is cached as a fixed-point factor, computed from getTemperature and getHumidity at init
+ * and by this function only; call it whenever the BME280 has a new sample.
+ */
+void HCSR04_UpdateSpeedOfSound(void);
+// Counts the overflows of the echo timers; call it from HAL_TIM_PeriodElapsedCallback
+void HCSR04_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+/* Triggers a measurement and sleeps until the capture interrupt of the end of the echo wakes the task up
+ * (polls before the kernel runs). Returns false when no echo ended within timeout_ms.
+ */
+bool HCSR04_MeasureDistance(HCSR04 *self, float *out_distance_m, uint32_t timeout_ms);
+// Same in whole millimetres, with one integer multiply and shift
+bool HCSR04_MeasureDistanceMm(HCSR04 *self, uint16_t *out_distance_mm, uint32_t timeout_ms);
+// HCSR04_MeasureDistance with HCSR04_ECHO_TIMEOUT_MS; 0 (not a valid distance) without echo
+float HCSR04_MeasureDistanceInMeters(HCSR04 *self);
+HCSR04_Execution_State_t HCSR04_MeasureDistanceInMetersNonBlocking(HCSR04 *self, float *out_distance_m,
+                                                                   HCSR04_Execution_State_t current_state);
 bool HCSR04_IsValidDistance(float distance_m);
-void HCSR04_ElapsedTimeMeasuredCallback(uint16_t time);
+bool HCSR04_IsValidDistanceMm(uint16_t distance_mm);
+
+/* Continuous mode: the trigger timer runs free and fires a pulse rate_hz times a second, the capture interrupt
+ * queues every echo width. The blocking and non-blocking measurements must not be used meanwhile.
+ * Returns false when rate_hz is out of range.
+ */
+bool HCSR04_StartContinuous(HCSR04 *self, uint32_t rate_hz);
+// Puts the trigger timer back in one-pulse mode; samples still buffered can be read afterwards
+void HCSR04_StopContinuous(HCSR04 *self);
+
+// Longest guard of the round robin, in ticks of the 16 bit trigger timer at 1 MHz
+#define HCSR04_MAX_GUARD_US 65525U
+
+/* Round robin over several sensors: the capture interrupt of the end of an echo queues the sample and starts the
+ * trigger of the next sensor guard_us later, timed by its trigger timer. Only one burst is in the air at any time,
+ * so neighbouring sensors cannot hear each other's echoes, and the next burst leaves as soon as the previous echo
+ * is in, so near obstacles are sampled faster. A sensor that does not answer stalls the round until
+ * HCSR04_CheckRoundRobin moves on. Returns false when a sensor is in another mode, or when guard_us is beyond
+ * HCSR04_MAX_GUARD_US, where the guard and the trigger pulse would not fit the period of the trigger timer.
+ */
+bool HCSR04_StartRoundRobin(HCSR04 *const *sensors, size_t count, uint16_t guard_us);
+void HCSR04_StopRoundRobin(void);
+// Triggers the next sensor when the current one has not answered within HCSR04_ECHO_TIMEOUT_MS; call it periodically
+void HCSR04_CheckRoundRobin(void);
+
+/* Moves up to max_samples of the oldest buffered samples to samples and returns how many.
+ * Only one task may read a sensor; the samples that did not fit into the buffer are counted as dropped.
+ */
+size_t HCSR04_ReadSamples(HCSR04 *self, HCSR04_Sample *samples, size_t max_samples);
+uint32_t HCSR04_GetDroppedSamples(const HCSR04 *self);
+// Samples are in ticks of the echo timer of the sensor that took them
+float HCSR04_SampleToMeters(const HCSR04 *self, const HCSR04_Sample *sample);
+uint16_t HCSR04_SampleToMm(const HCSR04 *self, const HCSR04_Sample *sample);
 
 #endif //MY_SENSORS_HCSR04_H
@@ -0,0 +1,54 @@
+#ifndef MY_SENSORS_HCSR04_FILTER_H
+#define MY_SENSORS_HCSR04_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Streaming filter for HC-SR04 distances in millimetres, one instance per sensor:
+ *
+ *   sliding median of the last `window` samples -> Hampel outlier reject -> exponential smoother
+ *
+ * The median is kept in a pair of heaps indexed by the age of the samples (a max-heap below and a min-heap
+ * above the median), so a new sample replaces the oldest one in O(log window) without sorting the window.
+ *
+ * With hampel_k_q4 = 0 the median is the output of the first stage. Otherwise a sample only gets replaced by the
+ * median when it is further than k times the scale from it; the scale is an exponentially weighted mean of the
+ * absolute deviations from the median, standing in for the MAD of the window, so the update stays O(log window).
+ * Samples without echo must not be fed to the filter.
+ */
+
+#define HCSR04_FILTER_MAX_WINDOW 31U
+
+typedef struct HCSR04Filter_Config {
+    uint8_t window;             // samples in the sliding median, odd, 1 disables the median
+    uint8_t hampel_k_q4;        // outlier threshold in units of the scale, Q4 (48 is 3.0); 0 outputs the median
+    uint8_t smoothing_shift;    // the smoother takes 1/2^shift of every new value; 0 disables it
+    uint16_t min_scale_mm;      // floor of the scale, about the resolution of the sensor
+} HCSR04Filter_Config;
+
+typedef struct HCSR04Filter_Stats {
+    uint32_t samples;
+    uint32_t outliers;          // samples replaced by the median
+} HCSR04Filter_Stats;
+
+typedef struct HCSR04Filter {
+    HCSR04Filter_Config config;
+    uint16_t values[HCSR04_FILTER_MAX_WINDOW];  // ring of the window, oldest at next
+    int8_t pos[HCSR04_FILTER_MAX_WINDOW];       // heap position of every value, 0 is the median
+    int8_t heap[HCSR04_FILTER_MAX_WINDOW];      // value indexes; heap[half + i] is position i, -half..half
+    uint8_t next;
+    uint8_t count;
+    uint32_t scale_q8;          // mm, Q8
+    uint32_t smoothed_q8;       // mm, Q8
+    HCSR04Filter_Stats stats;
+} HCSR04Filter;
+
+void HCSR04Filter_Init(HCSR04Filter *self, const HCSR04Filter_Config *config);
+// Feeds one valid distance and returns the filtered distance
+uint16_t HCSR04Filter_Update(HCSR04Filter *self, uint16_t distance_mm);
+// Median of the samples in the window; 0 before the first sample
+uint16_t HCSR04Filter_GetMedian(const HCSR04Filter *self);
+HCSR04Filter_Stats HCSR04Filter_GetStats(const HCSR04Filter *self);
+
+#endif //MY_SENSORS_HCSR04_FILTER_H
@@ -0,0 +1,45 @@
+#ifndef MY_SENSORS_I2C_BUS_H
+#define MY_SENSORS_I2C_BUS_H
+
+#include <stdbool.h>
+#include "stm32f3xx_hal.h"
+
+/*
+ * Transaction queue of an I2C bus shared by several drivers (BME280 and SSD1306 on hi2c1).
+ *
+ * Every transfer is queued and started with HAL_I2C_Mem_Write_DMA/HAL_I2C_Mem_Read_DMA. The completion
+ * interrupt starts the next queued transfer and wakes the caller, which sleeps on a thread flag in the
+ * meantime, so the CPU is free to run other tasks while the bus is busy. Transfers of different tasks
+ * are served in the order they were submitted. Before the kernel runs, the caller polls instead.
+ *
+ * The I2C event, error and DMA interrupts must have a priority that allows RTOS calls
+ * (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY or lower).
+ */
+
+// Thread flag used to wake a task whose transfer is over; do not use it for anything else
+#define I2C_BUS_THREAD_FLAG (1U << 24)
+
+#define I2C_BUS_MAX_BUSES 2
+
+typedef struct I2CBus_Stats {
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t max_pending;   // longest queue seen, including the transfer in flight
+} I2CBus_Stats;
+
+void I2CBus_Init(I2C_HandleTypeDef *hi2c);
+
+bool I2CBus_IsInitialized(I2C_HandleTypeDef *hi2c);
+
+/* Blocking from the point of view of the caller; 8 bit register addresses.
+ * Returns HAL_ERROR when the device does not acknowledge or the bus fails.
+ */
+HAL_StatusTypeDef I2CBus_MemWrite(I2C_HandleTypeDef *hi2c, uint16_t dev_address, uint16_t mem_address,
+                                  const uint8_t *data, uint16_t size);
+
+HAL_StatusTypeDef I2CBus_MemRead(I2C_HandleTypeDef *hi2c, uint16_t dev_address, uint16_t mem_address,
+                                 uint8_t *data, uint16_t size);
+
+I2CBus_Stats I2CBus_GetStats(I2C_HandleTypeDef *hi2c);
+
+#endif //MY_SENSORS_I2C_BUS_H
@@ -61,6 +61,10 @@ void Error_Handler(void);
 /* Private defines -----------------------------------------------------------*/
 #define B1_Pin GPIO_PIN_13
 #define B1_GPIO_Port GPIOC
+#define DCMOTOR3_ENC_A_Pin GPIO_PIN_0
+#define DCMOTOR3_ENC_A_GPIO_Port GPIOA
+#define DCMOTOR3_ENC_B_Pin GPIO_PIN_1
+#define DCMOTOR3_ENC_B_GPIO_Port GPIOA
 #define USART_TX_Pin GPIO_PIN_2
 #define USART_TX_GPIO_Port GPIOA
 #define USART_RX_Pin GPIO_PIN_3
@@ -75,6 +79,8 @@ void Error_Handler(void);
 #define MOTORENABLE_GPIO_Port GPIOA
 #define MOTORDATA_Pin GPIO_PIN_9
 #define MOTORDATA_GPIO_Port GPIOA
+#define HCSR04_TRIG_Pin GPIO_PIN_12
+#define HCSR04_TRIG_GPIO_Port GPIOA
 #define TMS_Pin GPIO_PIN_13
 #define TMS_GPIO_Port GPIOA
 #define TCK_Pin GPIO_PIN_14
@@ -85,6 +91,10 @@ void Error_Handler(void);
 #define DCMOTOR4_PWM_GPIO_Port GPIOB
 #define MOTORCLK_Pin GPIO_PIN_5
 #define MOTORCLK_GPIO_Port GPIOB
+#define DCMOTOR4_ENC_A_Pin GPIO_PIN_6
+#define DCMOTOR4_ENC_A_GPIO_Port GPIOB
+#define DCMOTOR4_ENC_B_Pin GPIO_PIN_7
+#define DCMOTOR4_ENC_B_GPIO_Port GPIOB
 
 /* USER CODE BEGIN Private defines */
 
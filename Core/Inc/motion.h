@@ -0,0 +1,48 @@
+#ifndef MY_SENSORS_MOTION_H
+#define MY_SENSORS_MOTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint-gcc.h>
+#include "wheel_control.h"
+
+/*
+ * Queue of timed motion segments for the wheels of wheel_control.h, played by a task of its own.
+ *
+ * Any task (or interrupt) enqueues segments without blocking. The motion task takes them in order: it ramps the
+ * setpoints linearly from the speeds the previous segment ended at to the speeds of the segment, then holds them
+ * until the segment is over and goes on with the next one without a gap. A segment of speed 0 after one that
+ * drives closes the trapezoid. When the queue runs dry at the end of a segment the wheels are released.
+ *
+ * The ramp is laid out in a table when the segment is taken from the queue, so every tick of the task is one
+ * lookup per wheel; the ticks follow the kernel tick count, and run as late as the priority of the task lets them.
+ */
+
+#define MOTION_MAX_WHEELS WHEEL_CONTROL_MAX_WHEELS
+#define MOTION_QUEUE_LENGTH 8U
+
+// The setpoints of a ramp change every tick
+#define MOTION_TICK_MS 10U
+#define MOTION_MAX_RAMP_MS 1000U
+
+typedef struct MotionSegment {
+    int32_t speeds[MOTION_MAX_WHEELS];     // counts per second, in the order of the wheels of Motion_Init()
+    uint16_t ramp_ms;                       // up to MOTION_MAX_RAMP_MS, 0 sets the speeds at once
+    uint16_t duration_ms;                   // from the start of the ramp, at least ramp_ms and not 0
+} MotionSegment;
+
+typedef struct Motion_Stats {
+    uint32_t segments;      // played to the end
+    uint32_t rejected;      // enqueued while the queue was full
+    uint32_t max_late_ms;   // latest tick behind its time
+} Motion_Stats;
+
+// Creates the queue, after osKernelInitialize(); the wheels belong to the motion task from then on
+void Motion_Init(WheelControl *const wheels[], size_t count);
+// Returns false, and drops the segment, when the queue is full
+bool Motion_Enqueue(const MotionSegment *segment);
+// Body of the motion task, which should have the highest priority of the tasks
+_Noreturn void Motion_Run(void);
+Motion_Stats Motion_GetStats(void);
+
+#endif //MY_SENSORS_MOTION_H
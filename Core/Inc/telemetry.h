@@ -0,0 +1,93 @@
+#ifndef MY_SENSORS_TELEMETRY_H
+#define MY_SENSORS_TELEMETRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Framed binary telemetry, sent on the console UART instead of formatted text.
+ *
+ * Frame, multi-byte fields little endian:
+ *   0xA5 0x5A | type u8 | length u8 | seq u16 | timestamp ms u32 | payload (length bytes) | crc u16
+ * The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over type..payload. seq counts every frame sent,
+ * so a gap tells the receiver how many frames were lost.
+ *
+ * Payloads, fixed point:
+ *   TELEMETRY_ENVIRONMENT  temperature i16 [0.01 C], humidity u16 [0.01 %RH], pressure u32 [0.1 Pa]
+ *   TELEMETRY_DISTANCE     distance u16 [mm], TELEMETRY_DISTANCE_INVALID without echo
+ *   TELEMETRY_MOTOR        motor u8 (1..4), command u8 (DCMotorCommand), speed u8
+ *
+ * The host decoder (Host/Src/telemetry_main.c) uses the encoder and the parser of this file as well.
+ */
+
+#define TELEMETRY_SYNC_0 0xA5
+#define TELEMETRY_SYNC_1 0x5A
+#define TELEMETRY_HEADER_SIZE 10
+#define TELEMETRY_CRC_SIZE 2
+#define TELEMETRY_MAX_PAYLOAD_SIZE 8
+#define TELEMETRY_MAX_FRAME_SIZE (TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PAYLOAD_SIZE + TELEMETRY_CRC_SIZE)
+
+#define TELEMETRY_DISTANCE_INVALID 0xFFFF
+
+typedef enum {
+    TELEMETRY_ENVIRONMENT = 1,
+    TELEMETRY_DISTANCE = 2,
+    TELEMETRY_MOTOR = 3,
+} Telemetry_Type_t;
+
+typedef struct Telemetry_Sample {
+    Telemetry_Type_t type;
+    uint16_t seq;
+    uint32_t timestamp_ms;
+    union {
+        struct {
+            int16_t temperature_centi_c;
+            uint16_t humidity_centi_pct;
+            uint32_t pressure_deci_pa;
+        } environment;
+        struct {
+            uint16_t distance_mm;
+        } distance;
+        struct {
+            uint8_t motor;
+            uint8_t command;
+            uint8_t speed;
+        } motor;
+    };
+} Telemetry_Sample;
+
+// Sink of the encoded frames, e.g. Console_Write
+typedef void (*Telemetry_Write_t)(const uint8_t *data, size_t size);
+
+typedef struct Telemetry_Parser {
+    uint8_t frame[TELEMETRY_MAX_FRAME_SIZE];
+    size_t received;
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t lost_frames;   // from the gaps in seq
+    uint16_t next_seq;
+    bool synchronized;      // a frame was accepted, so next_seq is known
+} Telemetry_Parser;
+
+uint16_t Telemetry_Crc16(const uint8_t *data, size_t size);
+
+// Returns the size of the frame written to frame, 0 for an unknown type
+size_t Telemetry_Encode(uint8_t frame[TELEMETRY_MAX_FRAME_SIZE], const Telemetry_Sample *sample);
+
+/* Feeds one received byte; returns true and fills sample when it completes a valid frame.
+ * Bytes that do not form a frame are skipped until the next sync pattern.
+ */
+bool Telemetry_Parse(Telemetry_Parser *parser, uint8_t byte, Telemetry_Sample *sample);
+
+/* Firmware side: converts the readings to fixed point and sends them with a running seq and HAL_GetTick().
+ * Frames of concurrent senders may reach the sink out of seq order.
+ */
+void Telemetry_Init(Telemetry_Write_t write);
+void Telemetry_SendEnvironment(float temperature_c, float pressure_pa, float humidity_pct);
+void Telemetry_SendDistance(float distance_m, bool valid);
+// For a reading taken earlier and already in millimetres, e.g. a sample of the HC-SR04 continuous mode
+void Telemetry_SendDistanceAt(uint32_t timestamp_ms, uint16_t distance_mm, bool valid);
+void Telemetry_SendMotor(uint8_t motor, uint8_t command, uint8_t speed);
+
+#endif //MY_SENSORS_TELEMETRY_H
@@ -0,0 +1,60 @@
+#ifndef MY_SENSORS_WHEEL_CONTROL_H
+#define MY_SENSORS_WHEEL_CONTROL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint-gcc.h>
+#include "stm32f3xx_hal.h"
+#include "af_motor_shield.h"
+
+struct WheelControl;
+typedef struct WheelControl WheelControl;
+
+#define WHEEL_CONTROL_MAX_WHEELS 4
+
+// Rate of the control loop, the update rate of the loop timer
+#define WHEEL_CONTROL_RATE_HZ 1000U
+// The speed is the encoder count over this many control periods; a power of two
+#define WHEEL_CONTROL_SPEED_PERIODS 8U
+
+/* encoder_htim is a timer in encoder mode on both edges of both channels (TIM_ENCODERMODE_TI12), counting up to
+ * Init.Period; a 16 bit counter is enough as long as it does not wrap within half a control period.
+ */
+typedef struct WheelControlPeripheral {
+    TIM_HandleTypeDef *encoder_htim;
+    AFMotorShield *motor;
+} WheelControlPeripheral;
+
+/* Gains in 16.16 fixed point, from the speed error in counts per second to compare ticks of the PWM timer.
+ * ki adds up once per control period; kd acts on the change of the measured speed, so that steps of the
+ * setpoint do not kick the output.
+ */
+typedef struct WheelControlGains {
+    int32_t kp_q16;
+    int32_t ki_q16;
+    int32_t kd_q16;
+} WheelControlGains;
+
+// PI tuned on the model of a 6 V gear motor with 48 counts per revolution of its shaft in my_sensors_bench
+#define WHEEL_CONTROL_GEAR_MOTOR_GAINS ((WheelControlGains) {.kp_q16 = 5243, .ki_q16 = 58, .kd_q16 = 0})
+
+// Starts the encoder; the motor is left alone until WheelControl_SetSpeed()
+WheelControl *WheelControl_Init(WheelControlPeripheral peripheral, WheelControlGains gains);
+/* Starts the update interrupt of loop_htim, which has to run at WHEEL_CONTROL_RATE_HZ and be passed on from
+ * HAL_TIM_PeriodElapsedCallback to WheelControl_PeriodElapsedCallback. Every period it measures the speed of all
+ * the wheels and runs the PID of those with a setpoint.
+ */
+void WheelControl_Start(TIM_HandleTypeDef *loop_htim);
+void WheelControl_Stop(void);
+/* Sets the speed in encoder counts per second and takes over the motor, stopping a ramp of it. The sign selects
+ * the direction through the latch, here in task context; the loop only drives the duty cycle, so the motor
+ * coasts rather than brakes when it runs too fast. 0 releases the motor.
+ */
+void WheelControl_SetSpeed(WheelControl *self, int32_t counts_per_s);
+// Same for several wheels at once: the direction changes among them go out in one transfer of the latch
+void WheelControl_SetSpeeds(WheelControl *const wheels[], const int32_t counts_per_s[], size_t count);
+// Measured speed in counts per second, updated every control period
+int32_t WheelControl_GetSpeed(const WheelControl *self);
+void WheelControl_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+
+#endif //MY_SENSORS_WHEEL_CONTROL_H
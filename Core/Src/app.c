@@ -0,0 +1,123 @@
+#include "app.h"
+#include "main.h"
+#include "af_motor_shield.h"
+#include "cmsis_os2.h"
+#include "bme280.h"
+#include "console.h"
+#include "display.h"
+#include "hcsr04.h"
+#include "hcsr04_filter.h"
+#include "i2c_bus.h"
+#include "motion.h"
+#include "telemetry.h"
+#include <assert.h>
+#include <stdbool.h>
+
+extern I2C_HandleTypeDef hi2c1;
+extern TIM_HandleTypeDef htim15;
+extern TIM_HandleTypeDef htim16;
+extern UART_HandleTypeDef huart2;
+
+// The sensor ranges on its own at this rate; the loop below refreshes the display at its own pace
+#define RANGING_RATE_HZ 25U
+#define DISPLAY_PERIOD_MS 100U
+
+// Start-up drive of both wheels: up to speed, a while straight ahead and back to a stop
+static const MotionSegment startup_drive[] = {
+        {.speeds = {2000, 2000}, .ramp_ms = 500, .duration_ms = 2000},
+        {.speeds = {0, 0}, .ramp_ms = 500, .duration_ms = 500},
+};
+
+// Telemetry carries the raw samples, the display the filtered distance
+static const HCSR04Filter_Config distance_filter_config = {
+        .window = 5,
+        .hampel_k_q4 = 3 * 16,
+        .smoothing_shift = 1,
+        .min_scale_mm = 10,
+};
+
+// NULL when the sensor did not answer at boot; the speed of sound then takes 0 C and 0 %RH
+static BME280 *environment;
+
+static float App_GetHumidity(void) {
+    return (environment != NULL) ? BME280_GetHumidity(environment) : 0.0f;
+}
+
+static float App_GetTemperature(void) {
+    return (environment != NULL) ? BME280_GetTemperature(environment) : 0.0f;
+}
+
+_Noreturn void App_RunBlinkLed(void) {
+    while (1) {
+        HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin);
+        osDelay(500);
+    }
+}
+
+_Noreturn void App_RunI2cUsers(void) {
+    Console_Init(&huart2);
+    Telemetry_Init(Console_Write);
+    I2CBus_Init(&hi2c1);
+    environment = BME280_Init((BME280Peripheral) {
+            .hi2c = &hi2c1,
+            .address = BME280_ADDRESS_SDO_LOW,
+    }, OSRS_16, OSRS_16, OSRS_16, MODE_NORMAL, T_SB_0p5, IIR_16);
+    if (environment != NULL) {
+        BME280_Measure(environment);
+    }
+    Display_Init(&hi2c1);
+    HCSR04 *sonar = HCSR04_Init((HCSR04Peripheral) {
+            .trigger_htim = &htim16,
+            .trigger_channel = TIM_CHANNEL_1,
+            .echo_htim = &htim15,
+            .echo_channel = TIM_CHANNEL_1,
+    }, App_GetHumidity, App_GetTemperature);
+    const bool ranging = HCSR04_StartContinuous(sonar, RANGING_RATE_HZ);
+    assert(ranging);
+
+    static HCSR04Filter distance_filter;
+    HCSR04Filter_Init(&distance_filter, &distance_filter_config);
+    uint16_t filtered_mm = 0;
+    // the display follows the filter, whatever the last echo of a pass was
+    bool have_filtered = false;
+    while (true) {
+        osDelay(DISPLAY_PERIOD_MS);
+        // every echo since the last pass goes out as telemetry, the display shows the filtered distance
+        HCSR04_Sample samples[HCSR04_SAMPLE_BUFFER_SIZE];
+        const size_t count = HCSR04_ReadSamples(sonar, samples, HCSR04_SAMPLE_BUFFER_SIZE);
+        for (size_t i = 0; i < count; i++) {
+            const uint16_t distance_mm = HCSR04_SampleToMm(sonar, &samples[i]);
+            const bool valid = HCSR04_IsValidDistanceMm(distance_mm);
+            Telemetry_SendDistanceAt(samples[i].timestamp_ms, distance_mm, valid);
+            if (valid) {
+                filtered_mm = HCSR04Filter_Update(&distance_filter, distance_mm);
+                have_filtered = true;
+            }
+        }
+        // a detached sensor keeps the last speed of sound and sends no environment sample
+        if (environment != NULL && BME280_Measure(environment) == BME280_OK) {
+            HCSR04_UpdateSpeedOfSound();
+            Telemetry_SendEnvironment(BME280_GetTemperature(environment), BME280_GetPressure(environment),
+                                      BME280_GetHumidity(environment));
+        }
+        // the state of the motors as the wheel control and the motion task leave it
+        for (MOTOR_t motor = MOTOR_1; motor <= MOTOR_4; motor++) {
+            AFMotorShieldCommand state;
+            if (AFMotorShield_GetState(motor, &state)) {
+                Telemetry_SendMotor((uint8_t) motor, (uint8_t) state.command, state.speed);
+            }
+        }
+        if (Display_IsInitialized()) {
+            Display_Print("Temp:%.2f Dist:%.2fcm", App_GetTemperature(),
+                          have_filtered ? (float) filtered_mm / 10.0f : 0.0f);
+        }
+    }
+}
+
+_Noreturn void App_RunMotion(void) {
+    for (size_t i = 0; i < sizeof startup_drive / sizeof startup_drive[0]; i++) {
+        const bool queued = Motion_Enqueue(&startup_drive[i]);
+        assert(queued);
+    }
+    Motion_Run();
+}
@@ -28,72 +28,79 @@
 // https://controllerstech.com/bme280-with-stm32/#goog_rewarded
 
 #include "bme280.h"
+#include "i2c_bus.h"
+#include "cmsis_os2.h"
 #include <assert.h>
 #include <string.h>
 
-extern I2C_HandleTypeDef hi2c1;
-#define BME280_I2C &hi2c1
-
-#define SUPPORT_64BIT 1
-// #define SUPPORT_32BIT 1
-
-#define BME280_ADDRESS 0xEC  // SDIO is grounded, the 7 bit address is 0x76 and 8 bit address = 0x76<<1 = 0xEC
-
-struct BME280;
-typedef struct BME280 BME280;
+// Bits of STATUS_REG
+#define STATUS_MEASURING 0x08
+#define STATUS_IM_UPDATE 0x01
+// Start-up time after power-on or soft reset (datasheet table 1)
+#define BME280_STARTUP_MS 2U
+// The data registers of a measurement that is switched off hold 0x80000, 0x8000 for humidity
+#define BME280_RAW_SKIPPED 0x80000
+#define BME280_RAW_H_SKIPPED 0x8000
 
 struct BME280 {
-    float Temperature;
-    float Pressure;
-    float Humidity;
+    BME280Peripheral peripheral;
+    uint16_t dev_address;   // 8 bit address of the HAL
+    BME280_Calibration calib;
+    BME280_Sample sample;
     uint8_t chipID;
+    // written again when the sensor comes back after an error
+    uint8_t ctrl_hum;
+    uint8_t config;
+    uint8_t ctrl_meas;
 
     bool initialized;
+    bool recovering;    // the last transfer failed; the chip ID is checked before the next sample
 };
 
-static BME280 self;
-
-uint8_t TrimParam[36];
-int32_t tRaw, pRaw, hRaw;
-
-uint16_t dig_T1, \
- dig_P1, \
- dig_H1, dig_H3;
+static BME280 sensors[BME280_MAX_SENSORS];
 
-int16_t dig_T2, dig_T3, \
- dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9, \
- dig_H2, dig_H4, dig_H5, dig_H6;
+static HAL_StatusTypeDef BME280_Read(BME280 *self, uint8_t reg, uint8_t *data, uint16_t size) {
+    return I2CBus_MemRead(self->peripheral.hi2c, self->dev_address, reg, data, size);
+}
 
+static HAL_StatusTypeDef BME280_Write(BME280 *self, uint8_t reg, const uint8_t *data, uint16_t size) {
+    return I2CBus_MemWrite(self->peripheral.hi2c, self->dev_address, reg, data, size);
+}
 
 // Read the Trimming parameters saved in the NVM ROM of the device
-void TrimRead(void) {
+static BME280_Status_t BME280_TrimRead(BME280 *self) {
     uint8_t trimdata[32];
     // Read NVM from 0x88 to 0xA1
-    assert(HAL_I2C_Mem_Read(BME280_I2C, BME280_ADDRESS, 0x88, 1, trimdata, 25, HAL_MAX_DELAY) == HAL_OK);
+    if (BME280_Read(self, 0x88, trimdata, 25) != HAL_OK) {
+        return BME280_ERROR_BUS;
+    }
 
     // Read NVM from 0xE1 to 0xE7
-    assert(HAL_I2C_Mem_Read(BME280_I2C, BME280_ADDRESS, 0xE1, 1, (uint8_t *) trimdata + 25, 7, HAL_MAX_DELAY) ==
-           HAL_OK);
+    if (BME280_Read(self, 0xE1, (uint8_t *) trimdata + 25, 7) != HAL_OK) {
+        return BME280_ERROR_BUS;
+    }
 
     // Arrange the data as per the datasheet (page no. 24)
-    dig_T1 = (trimdata[1] << 8) | trimdata[0];
-    dig_T2 = (trimdata[3] << 8) | trimdata[2];
-    dig_T3 = (trimdata[5] << 8) | trimdata[4];
-    dig_P1 = (trimdata[7] << 8) | trimdata[5];
-    dig_P2 = (trimdata[9] << 8) | trimdata[6];
-    dig_P3 = (trimdata[11] << 8) | trimdata[10];
-    dig_P4 = (trimdata[13] << 8) | trimdata[12];
-    dig_P5 = (trimdata[15] << 8) | trimdata[14];
-    dig_P6 = (trimdata[17] << 8) | trimdata[16];
-    dig_P7 = (trimdata[19] << 8) | trimdata[18];
-    dig_P8 = (trimdata[21] << 8) | trimdata[20];
-    dig_P9 = (trimdata[23] << 8) | trimdata[22];
-    dig_H1 = trimdata[24];
-    dig_H2 = (trimdata[26] << 8) | trimdata[25];
-    dig_H3 = (trimdata[27]);
-    dig_H4 = (trimdata[28] << 4) | (trimdata[29] & 0x0f);
-    dig_H5 = (trimdata[30] << 4) | (trimdata[29] >> 4);
-    dig_H6 = (trimdata[31]);
+    BME280_Calibration *const c = &self->calib;
+    c->dig_T1 = (trimdata[1] << 8) | trimdata[0];
+    c->dig_T2 = (trimdata[3] << 8) | trimdata[2];
+    c->dig_T3 = (trimdata[5] << 8) | trimdata[4];
+    c->dig_P1 = (trimdata[7] << 8) | trimdata[6];
+    c->dig_P2 = (trimdata[9] << 8) | trimdata[8];
+    c->dig_P3 = (trimdata[11] << 8) | trimdata[10];
+    c->dig_P4 = (trimdata[13] << 8) | trimdata[12];
+    c->dig_P5 = (trimdata[15] << 8) | trimdata[14];
+    c->dig_P6 = (trimdata[17] << 8) | trimdata[16];
+    c->dig_P7 = (trimdata[19] << 8) | trimdata[18];
+    c->dig_P8 = (trimdata[21] << 8) | trimdata[20];
+    c->dig_P9 = (trimdata[23] << 8) | trimdata[22];
+    c->dig_H1 = trimdata[24];
+    c->dig_H2 = (trimdata[26] << 8) | trimdata[25];
+    c->dig_H3 = (trimdata[27]);
+    c->dig_H4 = (trimdata[28] << 4) | (trimdata[29] & 0x0f);
+    c->dig_H5 = (trimdata[30] << 4) | (trimdata[29] >> 4);
+    c->dig_H6 = (trimdata[31]);
+    return BME280_OK;
 }
 
 /* Configuration for the BME280
@@ -115,254 +122,387 @@ void TrimRead(void) {
  *         Check datasheet page no 18 and page no 30
  */
 
-int BME280_Init(uint8_t osrs_t, uint8_t osrs_p, uint8_t osrs_h, uint8_t mode, uint8_t t_sb, uint8_t filter) {
-    // Read the Trimming parameters
-    assert(self.initialized == false);
-    memset(&self, 0, sizeof self);
-
-    // Check the chip ID before initializing
-    const HAL_StatusTypeDef status = HAL_I2C_Mem_Read(&hi2c1, BME280_ADDRESS, ID_REG, 1, &self.chipID, 1, 2000);
-    if (status != HAL_OK || self.chipID != 0x60) {
-        // bme280 is not connected
-        return -1;
+// Sleeps from a task, polls the tick before the kernel runs
+static void BME280_Sleep(uint32_t ms) {
+    if (osKernelGetState() == osKernelRunning) {
+        osDelay(ms);
+    } else {
+        HAL_Delay(ms);
     }
+}
 
-    TrimRead();
-
-    uint8_t datatowrite = 0;
-    uint8_t datacheck = 0;
-
-    // Reset the device
-    datatowrite = 0xB6;  // reset sequence
-    if (HAL_I2C_Mem_Write(BME280_I2C, BME280_ADDRESS, RESET_REG, 1, &datatowrite, 1, 1000) != HAL_OK) {
-        return -1;
+// Polls STATUS_REG every millisecond until the bits are clear
+static BME280_Status_t BME280_WaitWhile(BME280 *self, uint8_t status_bits, uint32_t timeout_ms) {
+    for (uint32_t waited_ms = 0;; waited_ms++) {
+        uint8_t status = 0;
+        if (BME280_Read(self, STATUS_REG, &status, 1) != HAL_OK) {
+            return BME280_ERROR_BUS;
+        }
+        if ((status & status_bits) == 0) {
+            return BME280_OK;
+        }
+        if (waited_ms == timeout_ms) {
+            return BME280_ERROR_TIMEOUT;
+        }
+        BME280_Sleep(1);
     }
+}
 
-    HAL_Delay(100);
+/* Writes the cached configuration. config is only written reliably in sleep mode and ctrl_hum takes effect with
+ * the next write of ctrl_meas, so the sensor goes to sleep first and ctrl_meas comes last. A sensor in forced
+ * mode is left asleep until BME280_WakeUP.
+ */
+static BME280_Status_t BME280_WriteConfig(BME280 *self) {
+    const uint8_t sleep = self->ctrl_meas & (uint8_t) ~MODE_NORMAL;
+    const uint8_t ctrl_meas = ((self->ctrl_meas & MODE_NORMAL) == MODE_NORMAL) ? self->ctrl_meas : sleep;
+    if (BME280_Write(self, CTRL_MEAS_REG, &sleep, 1) != HAL_OK ||
+        BME280_Write(self, CTRL_HUM_REG, &self->ctrl_hum, 1) != HAL_OK ||
+        BME280_Write(self, CONFIG_REG, &self->config, 1) != HAL_OK ||
+        (ctrl_meas != sleep && BME280_Write(self, CTRL_MEAS_REG, &ctrl_meas, 1) != HAL_OK)) {
+        return BME280_ERROR_BUS;
+    }
 
-    // write the humidity oversampling to 0xF2
-    datatowrite = osrs_h;
-    if (HAL_I2C_Mem_Write(BME280_I2C, BME280_ADDRESS, CTRL_HUM_REG, 1, &datatowrite, 1, 1000) != HAL_OK) {
-        return -1;
+    // ctrl_hum, status, ctrl_meas and config in one read
+    uint8_t datacheck[4];
+    if (BME280_Read(self, CTRL_HUM_REG, datacheck, sizeof datacheck) != HAL_OK) {
+        return BME280_ERROR_BUS;
     }
-    HAL_Delay(100);
-    HAL_I2C_Mem_Read(BME280_I2C, BME280_ADDRESS, CTRL_HUM_REG, 1, &datacheck, 1, 1000);
-    if (datacheck != datatowrite) {
-        return -1;
+    if (datacheck[0] != self->ctrl_hum || datacheck[2] != ctrl_meas || datacheck[3] != self->config) {
+        return BME280_ERROR_CONFIG;
     }
+    return BME280_OK;
+}
 
+BME280_Status_t BME280_Configure(BME280 *self, uint8_t osrs_t, uint8_t osrs_p, uint8_t osrs_h, uint8_t mode,
+                                 uint8_t t_sb, uint8_t filter) {
+    assert(self != NULL);
+    self->ctrl_hum = osrs_h;
+    self->config = (t_sb << 5) | (filter << 2);
+    self->ctrl_meas = (osrs_t << 5) | (osrs_p << 2) | mode;
+    /* The 32 bit compensation stays within 6 Pa of the exact one, inside the relative accuracy of 12 Pa (datasheet
+     * table 2) of a single measurement; the IIR filter brings the noise down to 0.2 Pa, which needs the 64 bit one.
+     */
+    self->calib.pressure_32bit = filter == IIR_OFF;
+    return BME280_WriteConfig(self);
+}
 
-    // write the standby time and IIR filter coeff to 0xF5
-    datatowrite = (t_sb << 5) | (filter << 2);
-    if (HAL_I2C_Mem_Write(BME280_I2C, BME280_ADDRESS, CONFIG_REG, 1, &datatowrite, 1, 1000) != HAL_OK) {
-        return -1;
+BME280 *BME280_Init(BME280Peripheral peripheral, uint8_t osrs_t, uint8_t osrs_p, uint8_t osrs_h, uint8_t mode,
+                    uint8_t t_sb, uint8_t filter) {
+    assert(peripheral.address == BME280_ADDRESS_SDO_LOW || peripheral.address == BME280_ADDRESS_SDO_HIGH);
+    BME280 *self = NULL;
+    for (size_t i = 0; i < BME280_MAX_SENSORS && self == NULL; i++) {
+        assert(!sensors[i].initialized || sensors[i].peripheral.hi2c != peripheral.hi2c ||
+               sensors[i].peripheral.address != peripheral.address);
+        if (!sensors[i].initialized) {
+            self = &sensors[i];
+        }
     }
-    HAL_Delay(100);
-    HAL_I2C_Mem_Read(BME280_I2C, BME280_ADDRESS, CONFIG_REG, 1, &datacheck, 1, 1000);
-    if (datacheck != datatowrite) {
-        return -1;
+    assert(self != NULL);
+    *self = (BME280) {
+            .peripheral = peripheral,
+            .dev_address = (uint16_t) (peripheral.address << 1U),
+    };
+
+    // Check the chip ID before initializing
+    const HAL_StatusTypeDef status = BME280_Read(self, ID_REG, &self->chipID, 1);
+    if (status != HAL_OK || self->chipID != BME280_CHIP_ID) {
+        // bme280 is not connected
+        return NULL;
     }
 
+    // Reset the device and wait for the copy of the NVM, which takes the start-up time
+    uint8_t datatowrite = 0xB6;  // reset sequence
+    if (BME280_Write(self, RESET_REG, &datatowrite, 1) != HAL_OK) {
+        return NULL;
+    }
+    BME280_Sleep(BME280_STARTUP_MS);
+    if (BME280_WaitWhile(self, STATUS_IM_UPDATE, BME280_STARTUP_MS) != BME280_OK) {
+        return NULL;
+    }
 
-    // write the pressure and temp oversampling along with mode to 0xF4
-    datatowrite = (osrs_t << 5) | (osrs_p << 2) | mode;
-    if (HAL_I2C_Mem_Write(BME280_I2C, BME280_ADDRESS, CTRL_MEAS_REG, 1, &datatowrite, 1, 1000) != HAL_OK) {
-        return -1;
+    // Read the Trimming parameters
+    if (BME280_TrimRead(self) != BME280_OK) {
+        return NULL;
     }
-    HAL_Delay(100);
-    HAL_I2C_Mem_Read(BME280_I2C, BME280_ADDRESS, CTRL_MEAS_REG, 1, &datacheck, 1, 1000);
-    if (datacheck != datatowrite) {
-        return -1;
+    if (BME280_Configure(self, osrs_t, osrs_p, osrs_h, mode, t_sb, filter) != BME280_OK) {
+        return NULL;
     }
 
-    self.initialized = true;
-    return 0;
+    self->initialized = true;
+    return self;
+}
+
+static uint32_t BME280_Oversampling(uint8_t osrs) {
+    return (osrs == OSRS_OFF) ? 0U : (osrs >= OSRS_16) ? 16U : 1U << (osrs - 1U);
+}
+
+uint32_t BME280_GetMeasurementTimeUs(const BME280 *self) {
+    const uint32_t t = BME280_Oversampling(self->ctrl_meas >> 5);
+    const uint32_t p = BME280_Oversampling((self->ctrl_meas >> 2) & 0x07);
+    const uint32_t h = BME280_Oversampling(self->ctrl_hum & 0x07);
+    // maximum of the datasheet (appendix B): 1.25 ms + 2.3 ms per conversion + 0.575 ms for P and H each
+    return 1250U + 2300U * t + (p ? 2300U * p + 575U : 0U) + (h ? 2300U * h + 575U : 0U);
 }
 
+/* Brings a sensor that failed a transfer back: the chip ID tells whether it answers again, and one that lost
+ * power comes back in sleep mode with its configuration reset.
+ */
+static BME280_Status_t BME280_Recover(BME280 *self) {
+    if (BME280_Read(self, ID_REG, &self->chipID, 1) != HAL_OK) {
+        return BME280_ERROR_BUS;
+    }
+    if (self->chipID != BME280_CHIP_ID) {
+        return BME280_ERROR_CHIP_ID;
+    }
+    const BME280_Status_t status = BME280_TrimRead(self);
+    if (status != BME280_OK) {
+        return status;
+    }
+    return BME280_WriteConfig(self);
+}
 
-int BMEReadRaw(void) {
+// The chip ID is checked at init and after errors only, so a sample is a single transaction
+static BME280_Status_t BME280_ReadRaw(BME280 *self, BME280_RawSample *raw) {
     uint8_t RawData[8];
 
-    // Check the chip ID before reading
-    const HAL_StatusTypeDef status = HAL_I2C_Mem_Read(&hi2c1, BME280_ADDRESS, ID_REG, 1, &self.chipID, 1, 2000);
-    assert(status == HAL_OK);
+    // Read the Registers 0xF7 to 0xFE
+    if (BME280_Read(self, PRESS_MSB_REG, RawData, 8) != HAL_OK) {
+        return BME280_ERROR_BUS;
+    }
 
-    if (self.chipID == 0x60) {
-        // Read the Registers 0xF7 to 0xFE
-        HAL_I2C_Mem_Read(BME280_I2C, BME280_ADDRESS, PRESS_MSB_REG, 1, RawData, 8, HAL_MAX_DELAY);
+    /* Calculate the Raw data for the parameters
+     * Here the Pressure and Temperature are in 20 bit format and humidity in 16 bit format
+     */
+    raw->p = (RawData[0] << 12) | (RawData[1] << 4) | (RawData[2] >> 4);
+    raw->t = (RawData[3] << 12) | (RawData[4] << 4) | (RawData[5] >> 4);
+    raw->h = (RawData[6] << 8) | (RawData[7]);
+    return BME280_OK;
+}
 
-        /* Calculate the Raw data for the parameters
-         * Here the Pressure and Temperature are in 20 bit format and humidity in 16 bit format
-         */
-        pRaw = (RawData[0] << 12) | (RawData[1] << 4) | (RawData[2] >> 4);
-        tRaw = (RawData[3] << 12) | (RawData[4] << 4) | (RawData[5] >> 4);
-        hRaw = (RawData[6] << 8) | (RawData[7]);
+// Brings the sensor back if the last transfer failed and puts it in forced mode, which starts one measurement
+static BME280_Status_t BME280_Trigger(BME280 *self) {
+    assert(self != NULL && self->initialized);
+    BME280_Status_t status = self->recovering ? BME280_Recover(self) : BME280_OK;
+    const uint8_t datatowrite = (self->ctrl_meas & (uint8_t) ~MODE_NORMAL) | MODE_FORCED;
+    if (status == BME280_OK && BME280_Write(self, CTRL_MEAS_REG, &datatowrite, 1) != HAL_OK) {
+        status = BME280_ERROR_BUS;
+    }
+    self->recovering = status != BME280_OK;
+    return status;
+}
 
-        return 0;
-    } else return -1;
+static uint32_t BME280_GetMeasurementTimeMs(const BME280 *self) {
+    return (BME280_GetMeasurementTimeUs(self) + 999U) / 1000U;
 }
 
 /* To be used when doing the force measurement
  * the Device need to be put in forced mode every time the measurement is needed
+ * Sleeps for the maximum measurement time, then polls the measuring bit until the data registers are updated.
  */
-void BME280_WakeUP(void) {
-    uint8_t datatowrite = 0;
-
-    // first read the register
-    HAL_I2C_Mem_Read(BME280_I2C, BME280_ADDRESS, CTRL_MEAS_REG, 1, &datatowrite, 1, 1000);
-
-    // modify the data with the forced mode
-    datatowrite = datatowrite | MODE_FORCED;
-
-    // write the new data to the register
-    HAL_I2C_Mem_Write(BME280_I2C, BME280_ADDRESS, CTRL_MEAS_REG, 1, &datatowrite, 1, 1000);
-
-    HAL_Delay(100);
+BME280_Status_t BME280_WakeUP(BME280 *self) {
+    BME280_Status_t status = BME280_Trigger(self);
+    if (status == BME280_OK) {
+        const uint32_t measurement_ms = BME280_GetMeasurementTimeMs(self);
+        BME280_Sleep(measurement_ms);
+        status = BME280_WaitWhile(self, STATUS_MEASURING, measurement_ms);
+        self->recovering = status != BME280_OK;
+    }
+    return status;
 }
 
 /************* COMPENSATION CALCULATION AS PER DATASHEET (page 25) **************************/
 
 /* Returns temperature in DegC, resolution is 0.01 DegC. Output value of “5123” equals 51.23 DegC.
-   t_fine carries fine temperature as global value
+   t_fine carries fine temperature to the pressure and humidity compensation
 */
-int32_t t_fine;
-
-int32_t BME280_compensate_T_int32(int32_t adc_T) {
+static inline int32_t BME280_compensate_T_int32(const BME280_Calibration *c, int32_t adc_T, int32_t *t_fine) {
     int32_t var1, var2, T;
-    var1 = ((((adc_T >> 3) - ((int32_t) dig_T1 << 1))) * ((int32_t) dig_T2)) >> 11;
-    var2 = (((((adc_T >> 4) - ((int32_t) dig_T1)) * ((adc_T >> 4) - ((int32_t) dig_T1))) >> 12) * ((int32_t) dig_T3))
-            >> 14;
-    t_fine = var1 + var2;
-    T = (t_fine * 5 + 128) >> 8;
+    var1 = ((((adc_T >> 3) - ((int32_t) c->dig_T1 << 1))) * ((int32_t) c->dig_T2)) >> 11;
+    var2 = (((((adc_T >> 4) - ((int32_t) c->dig_T1)) * ((adc_T >> 4) - ((int32_t) c->dig_T1))) >> 12) *
+            ((int32_t) c->dig_T3)) >> 14;
+    *t_fine = var1 + var2;
+    T = (*t_fine * 5 + 128) >> 8;
     return T;
 }
 
-
-#if SUPPORT_64BIT
-
 /* Returns pressure in Pa as unsigned 32 bit integer in Q24.8 format (24 integer bits and 8 fractional bits).
    Output value of “24674867” represents 24674867/256 = 96386.2 Pa = 963.862 hPa
 */
-uint32_t BME280_compensate_P_int64(int32_t adc_P) {
+static inline uint32_t BME280_compensate_P_int64(const BME280_Calibration *c, int32_t adc_P, int32_t t_fine) {
     int64_t var1, var2, p;
     var1 = ((int64_t) t_fine) - 128000;
-    var2 = var1 * var1 * (int64_t) dig_P6;
-    var2 = var2 + ((var1 * (int64_t) dig_P5) << 17);
-    var2 = var2 + (((int64_t) dig_P4) << 35);
-    var1 = ((var1 * var1 * (int64_t) dig_P3) >> 8) + ((var1 * (int64_t) dig_P2) << 12);
-    var1 = (((((int64_t) 1) << 47) + var1)) * ((int64_t) dig_P1) >> 33;
+    var2 = var1 * var1 * (int64_t) c->dig_P6;
+    var2 = var2 + ((var1 * (int64_t) c->dig_P5) << 17);
+    var2 = var2 + (((int64_t) c->dig_P4) << 35);
+    var1 = ((var1 * var1 * (int64_t) c->dig_P3) >> 8) + ((var1 * (int64_t) c->dig_P2) << 12);
+    var1 = (((((int64_t) 1) << 47) + var1)) * ((int64_t) c->dig_P1) >> 33;
     if (var1 == 0) {
         return 0; // avoid exception caused by division by zero
     }
     p = 1048576 - adc_P;
     p = (((p << 31) - var2) * 3125) / var1;
-    var1 = (((int64_t) dig_P9) * (p >> 13) * (p >> 13)) >> 25;
-    var2 = (((int64_t) dig_P8) * p) >> 19;
-    p = ((p + var1 + var2) >> 8) + (((int64_t) dig_P7) << 4);
+    var1 = (((int64_t) c->dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (((int64_t) c->dig_P8) * p) >> 19;
+    p = ((p + var1 + var2) >> 8) + (((int64_t) c->dig_P7) << 4);
     return (uint32_t) p;
 }
 
-#elif SUPPORT_32BIT
-// Returns pressure in Pa as unsigned 32 bit integer. Output value of “96386” equals 96386 Pa = 963.86 hPa
-uint32_t BME280_compensate_P_int32(int32_t adc_P)
-{
+/* Returns pressure in Pa as unsigned 32 bit integer. Output value of “96386” equals 96386 Pa = 963.86 hPa
+   No 64 bit multiplication and a 32 bit division only, which the Cortex-M4 does in hardware
+*/
+static inline uint32_t BME280_compensate_P_int32(const BME280_Calibration *c, int32_t adc_P, int32_t t_fine) {
     int32_t var1, var2;
     uint32_t p;
-    var1 = (((int32_t)t_fine)>>1) - (int32_t)64000;
-    var2 = (((var1>>2) * (var1>>2)) >> 11 ) * ((int32_t)dig_P6);
-    var2 = var2 + ((var1*((int32_t)dig_P5))<<1);
-    var2 = (var2>>2)+(((int32_t)dig_P4)<<16);
-    var1 = (((dig_P3 * (((var1>>2) * (var1>>2)) >> 13 )) >> 3) + ((((int32_t)dig_P2) *var1)>>1))>>18;
-    var1 =((((32768+var1))*((int32_t)dig_P1))>>15);
-    if (var1 == 0)
-    {
+    var1 = (((int32_t) t_fine) >> 1) - (int32_t) 64000;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t) c->dig_P6);
+    var2 = var2 + ((var1 * ((int32_t) c->dig_P5)) << 1);
+    var2 = (var2 >> 2) + (((int32_t) c->dig_P4) << 16);
+    var1 = (((c->dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t) c->dig_P2) * var1) >> 1)) >> 18;
+    var1 = ((((32768 + var1)) * ((int32_t) c->dig_P1)) >> 15);
+    if (var1 == 0) {
         return 0; // avoid exception caused by division by zero
     }
-    p = (((uint32_t)(((int32_t)1048576)-adc_P)-(var2>>12)))*3125;
-    if (p < 0x80000000)
-    {
-        p = (p << 1) / ((uint32_t)var1);
+    p = (((uint32_t) (((int32_t) 1048576) - adc_P) - (var2 >> 12))) * 3125;
+    if (p < 0x80000000) {
+        p = (p << 1) / ((uint32_t) var1);
+    } else {
+        p = (p / (uint32_t) var1) * 2;
     }
-    else
-    {
-        p = (p / (uint32_t)var1) * 2;
-    }
-    var1 = (((int32_t)dig_P9) * ((int32_t)(((p>>3) * (p>>3))>>13)))>>12;
-    var2 = (((int32_t)(p>>2)) * ((int32_t)dig_P8))>>13;
-    p = (uint32_t)((int32_t)p + ((var1 + var2 + dig_P7) >> 4));
+    var1 = (((int32_t) c->dig_P9) * ((int32_t) (((p >> 3) * (p >> 3)) >> 13))) >> 12;
+    var2 = (((int32_t) (p >> 2)) * ((int32_t) c->dig_P8)) >> 13;
+    p = (uint32_t) ((int32_t) p + ((var1 + var2 + c->dig_P7) >> 4));
     return p;
 }
-#endif
 
 /* Returns humidity in %RH as unsigned 32 bit integer in Q22.10 format (22 integer and 10 fractional bits).
    Output value of “47445” represents 47445/1024 = 46.333 %RH
 */
-uint32_t bme280_compensate_H_int32(int32_t adc_H) {
+static inline uint32_t bme280_compensate_H_int32(const BME280_Calibration *c, int32_t adc_H, int32_t t_fine) {
     int32_t v_x1_u32r;
     v_x1_u32r = (t_fine - ((int32_t) 76800));
-    v_x1_u32r = (((((adc_H << 14) - (((int32_t) dig_H4) << 20) - (((int32_t) dig_H5) * \
+    v_x1_u32r = (((((adc_H << 14) - (((int32_t) c->dig_H4) << 20) - (((int32_t) c->dig_H5) * \
             v_x1_u32r)) + ((int32_t) 16384)) >> 15) * (((((((v_x1_u32r * \
-                    ((int32_t) dig_H6)) >> 10) * (((v_x1_u32r * ((int32_t) dig_H3)) >> 11) + \
-                            ((int32_t) 32768))) >> 10) + ((int32_t) 2097152)) * ((int32_t) dig_H2) + \
+                    ((int32_t) c->dig_H6)) >> 10) * (((v_x1_u32r * ((int32_t) c->dig_H3)) >> 11) + \
+                            ((int32_t) 32768))) >> 10) + ((int32_t) 2097152)) * ((int32_t) c->dig_H2) + \
                     8192) >> 14));
     v_x1_u32r = (v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) * \
-            ((int32_t) dig_H1)) >> 4));
+            ((int32_t) c->dig_H1)) >> 4));
     v_x1_u32r = (v_x1_u32r < 0 ? 0 : v_x1_u32r);
     v_x1_u32r = (v_x1_u32r > 419430400 ? 419430400 : v_x1_u32r);
     return (uint32_t) (v_x1_u32r >> 12);
 }
 /*********************************************************************************************************/
 
+// pressure_32bit is a constant in both loops of BME280_Compensate, so each gets a copy without the branch
+static inline void BME280_CompensateSample(const BME280_Calibration *c, const BME280_RawSample *raw,
+                                           BME280_Sample *sample, bool pressure_32bit) {
+    int32_t t_fine = 0;
+    // values in case the measurement was disabled
+    sample->temperature_centi_c = (raw->t == BME280_RAW_SKIPPED) ? 0 : BME280_compensate_T_int32(c, raw->t, &t_fine);
+    if (raw->p == BME280_RAW_SKIPPED) {
+        sample->pressure_q8_pa = 0;
+    } else if (pressure_32bit) {
+        sample->pressure_q8_pa = BME280_compensate_P_int32(c, raw->p, t_fine) << 8;
+    } else {
+        sample->pressure_q8_pa = BME280_compensate_P_int64(c, raw->p, t_fine);
+    }
+    sample->humidity_q10_pct = (raw->h == BME280_RAW_H_SKIPPED) ? 0 : bme280_compensate_H_int32(c, raw->h, t_fine);
+}
 
-/* measure the temp, pressure and humidity
- * the values will be stored in the parameters passed to the function
- */
-void BME280_Measure(void) {
-    assert(self.initialized);
-    if (BMEReadRaw() == 0) {
-        if (tRaw == 0x800000) self.Temperature = 0; // value in case temp measurement was disabled
-        else {
-            self.Temperature = (BME280_compensate_T_int32(tRaw)) / 100.0;  // as per datasheet, the temp is x100
+void BME280_Compensate(const BME280_Calibration *calib, const BME280_RawSample *raw, BME280_Sample *samples,
+                       size_t count) {
+    if (calib->pressure_32bit) {
+        for (size_t i = 0; i < count; i++) {
+            BME280_CompensateSample(calib, &raw[i], &samples[i], true);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            BME280_CompensateSample(calib, &raw[i], &samples[i], false);
         }
+    }
+}
 
-        if (pRaw == 0x800000) self.Pressure = 0; // value in case temp measurement was disabled
-        else {
-#if SUPPORT_64BIT
-            self.Pressure = (BME280_compensate_P_int64(pRaw)) / 256.0;  // as per datasheet, the pressure is x256
+BME280_Status_t BME280_MeasureRaw(BME280 *self, BME280_RawSample *raw) {
+    assert(self != NULL && self->initialized);
+    BME280_Status_t status = self->recovering ? BME280_Recover(self) : BME280_OK;
+    if (status == BME280_OK) {
+        status = BME280_ReadRaw(self, raw);
+    }
+    self->recovering = status != BME280_OK;
+    return status;
+}
 
-#elif SUPPORT_32BIT
-            Pressure = (BME280_compensate_P_int32 (pRaw));  // as per datasheet, the pressure is Pa
+/* measure the temp, pressure and humidity
+ * the values will be stored in the parameters passed to the function
+ */
+BME280_Status_t BME280_Measure(BME280 *self) {
+    BME280_RawSample raw;
+    const BME280_Status_t status = BME280_MeasureRaw(self, &raw);
+    if (status == BME280_OK) {
+        BME280_Compensate(&self->calib, &raw, &self->sample, 1);
+    } else { // the device is detached
+        self->sample = (BME280_Sample) {0};
+    }
+    return status;
+}
 
-#endif
+size_t BME280_MeasureAll(BME280 *const *sensors_to_sample, size_t count, BME280_Status_t *statuses) {
+    assert(count <= BME280_MAX_SENSORS);
+    BME280_Status_t status[BME280_MAX_SENSORS];
+    bool triggered[BME280_MAX_SENSORS];
+
+    // every sensor in forced mode starts converting before the first one is read, so the conversions overlap
+    uint32_t measurement_ms = 0;
+    for (size_t i = 0; i < count; i++) {
+        BME280 *self = sensors_to_sample[i];
+        const bool forced = (self->ctrl_meas & MODE_NORMAL) != MODE_NORMAL;
+        status[i] = forced ? BME280_Trigger(self) : BME280_OK;
+        triggered[i] = forced && status[i] == BME280_OK;
+        if (triggered[i] && BME280_GetMeasurementTimeMs(self) > measurement_ms) {
+            measurement_ms = BME280_GetMeasurementTimeMs(self);
         }
+    }
+    if (measurement_ms > 0U) {
+        BME280_Sleep(measurement_ms);
+    }
 
-        if (hRaw == 0x8000) self.Humidity = 0; // value in case temp measurement was disabled
-        else {
-            self.Humidity = (bme280_compensate_H_int32(hRaw)) / 1024.0;  // as per datasheet, the temp is x1024
+    size_t measured = 0;
+    for (size_t i = 0; i < count; i++) {
+        BME280 *self = sensors_to_sample[i];
+        if (triggered[i]) {
+            status[i] = BME280_WaitWhile(self, STATUS_MEASURING, BME280_GetMeasurementTimeMs(self));
+            self->recovering = status[i] != BME280_OK;
+        }
+        // a sensor that failed to trigger reads 0 and recovers at the next call
+        status[i] = (status[i] == BME280_OK) ? BME280_Measure(self) : status[i];
+        if (status[i] != BME280_OK) {
+            self->sample = (BME280_Sample) {0};
+        } else {
+            measured++;
+        }
+        if (statuses != NULL) {
+            statuses[i] = status[i];
         }
     }
+    return measured;
+}
 
-
-        // if the device is detached
-    else {
-        self.Temperature = 0;
-        self.Pressure = 0;
-        self.Humidity = 0;
-    }
+BME280_Sample BME280_GetSample(const BME280 *self) {
+    return self->sample;
 }
 
-float BME280_GetTemperature(void) {
-    return self.Temperature;
+const BME280_Calibration *BME280_GetCalibration(const BME280 *self) {
+    return &self->calib;
 }
 
-float BME280_GetPressure(void) {
-    return self.Pressure;
+float BME280_GetTemperature(const BME280 *self) {
+    return (float) self->sample.temperature_centi_c / 100.0f;
 }
 
-float BME280_GetHumidity(void) {
-    return self.Humidity;
+float BME280_GetPressure(const BME280 *self) {
+    return (float) self->sample.pressure_q8_pa / 256.0f;
 }
 
-bool BME280_IsInitialized() {
-    return self.initialized;
-}
\ No newline at end of file
+float BME280_GetHumidity(const BME280 *self) {
+    return (float) self->sample.humidity_q10_pct / 1024.0f;
+}
@@ -1,4 +1,5 @@
 #include "console.h"
+#include "cmsis_os2.h"
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
@@ -7,36 +8,134 @@
 
 #define BUFFER_SIZE (100)
 
+_Static_assert((CONSOLE_TX_BUFFER_SIZE & (CONSOLE_TX_BUFFER_SIZE - 1)) == 0, "CONSOLE_TX_BUFFER_SIZE must be a power of two");
+
 struct Console
 {
     UART_HandleTypeDef * huart;
     bool initialized;
+    osMutexId_t lock;           // serializes the writers of buffer and head
     uint8_t buffer[BUFFER_SIZE];
+    // Free-running positions in tx: Console_Print advances head, the transmit complete interrupt advances tail
+    uint8_t tx[CONSOLE_TX_BUFFER_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint16_t in_flight;         // bytes from tail handed to the UART, 0 when it is idle
+    Console_Stats stats;
 };
 
 Console console;
 
+static void Console_Lock(void)
+{
+    if (osKernelGetState() == osKernelRunning)
+    {
+        osMutexAcquire(console.lock, osWaitForever);
+    }
+}
+
+static void Console_Unlock(void)
+{
+    if (osKernelGetState() == osKernelRunning)
+    {
+        osMutexRelease(console.lock);
+    }
+}
+
+// Sends the bytes from tail up to head or to the end of the buffer, whichever comes first.
+// Called from the transmit complete interrupt or with interrupts disabled.
+static void Console_StartTransmit(void)
+{
+    const uint32_t used = console.head - console.tail;
+    const uint32_t offset = console.tail & (CONSOLE_TX_BUFFER_SIZE - 1);
+    const uint32_t chunk = (used < CONSOLE_TX_BUFFER_SIZE - offset) ? used : CONSOLE_TX_BUFFER_SIZE - offset;
+    if (chunk == 0)
+    {
+        return;
+    }
+    console.in_flight = chunk;
+    if (HAL_UART_Transmit_IT(console.huart, &console.tx[offset], chunk) != HAL_OK)
+    {
+        // try again with the next message
+        console.in_flight = 0;
+    }
+}
+
 void Console_Init(UART_HandleTypeDef *huart)
 {
     assert(console.initialized == false);
     console.huart = huart;
+    console.lock = osMutexNew(NULL);
+    assert(console.lock != NULL);
     console.initialized = true;
 }
 
+// Copies data behind head and starts the transmission if the UART is idle; called with the lock held
+static void Console_Queue(const uint8_t *data, uint32_t len)
+{
+    // tail only moves forward, so the free space can only grow while the message is copied
+    const uint32_t used = console.head - console.tail;
+    if (len > CONSOLE_TX_BUFFER_SIZE - used)
+    {
+        console.stats.dropped_bytes += len;
+        return;
+    }
+    const uint32_t offset = console.head & (CONSOLE_TX_BUFFER_SIZE - 1);
+    const uint32_t first = (len < CONSOLE_TX_BUFFER_SIZE - offset) ? len : CONSOLE_TX_BUFFER_SIZE - offset;
+    memcpy(&console.tx[offset], data, first);
+    memcpy(console.tx, &data[first], len - first);
+    console.stats.bytes += len;
+    if (used + len > console.stats.max_used)
+    {
+        console.stats.max_used = used + len;
+    }
+
+    __disable_irq();
+    console.head += len;
+    if (console.in_flight == 0)
+    {
+        Console_StartTransmit();
+    }
+    __enable_irq();
+}
+
 void Console_Print(const char *format, ...)
 {
     assert(console.initialized == true);
-    memset(console.buffer, '\0', sizeof console.buffer);
+    Console_Lock();
 
     va_list args;
     va_start(args, format);
-    vsnprintf((char*)console.buffer, BUFFER_SIZE, format, args);
+    const int formatted = vsnprintf((char*)console.buffer, BUFFER_SIZE, format, args);
+    va_end(args);
+    const uint32_t len = (formatted < 0) ? 0 : (formatted < BUFFER_SIZE) ? (uint32_t)formatted : BUFFER_SIZE - 1;
+    Console_Queue(console.buffer, len);
+
+    Console_Unlock();
+}
 
-    const size_t len = strlen((char*)console.buffer);
-    if(HAL_UART_Transmit(console.huart, (uint8_t *)console.buffer, len, HAL_MAX_DELAY) != HAL_OK)
+void Console_Write(const uint8_t *data, size_t size)
+{
+    assert(console.initialized == true);
+    Console_Lock();
+    Console_Queue(data, size);
+    Console_Unlock();
+}
+
+Console_Stats Console_GetStats(void)
+{
+    assert(console.initialized == true);
+    return console.stats;
+}
+
+// Overrides the weak HAL_UART_TxCpltCallback function
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart != console.huart)
     {
-        va_end(args);
-        assert(false);
+        return;
     }
-    va_end(args);
+    console.tail += console.in_flight;
+    console.in_flight = 0;
+    Console_StartTransmit();
 }
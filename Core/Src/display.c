@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include "display.h"
+#include "display_font_columns.h"
+#include "i2c_bus.h"
+#include "cmsis_os2.h"
 
 #ifndef SSD1306_I2C_ADDR
 #define SSD1306_I2C_ADDR        (0x3C << 1)
@@ -33,14 +36,12 @@
 #define SSD1306_BUFFER_SIZE   SSD1306_WIDTH * SSD1306_HEIGHT / 8
 #endif
 
-#ifdef SSD1306_X_OFFSET
-#define SSD1306_X_OFFSET_LOWER (SSD1306_X_OFFSET & 0x0F)
-#define SSD1306_X_OFFSET_UPPER ((SSD1306_X_OFFSET >> 4) & 0x07)
-#else
-#define SSD1306_X_OFFSET_LOWER 0
-#define SSD1306_X_OFFSET_UPPER 0
+#ifndef SSD1306_X_OFFSET
+#define SSD1306_X_OFFSET 0
 #endif
 
+#define SSD1306_PAGES (SSD1306_HEIGHT / 8)
+
 static const uint16_t Font_data_11x18 [] = {
         0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,   // sp
         0x0000, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0000, 0x0C00, 0x0C00, 0x0000, 0x0000, 0x0000,   // !
@@ -139,11 +140,28 @@ static const uint16_t Font_data_11x18 [] = {
         0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x3880, 0x7F80, 0x4700, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,   // ~
 };
 
-DISPLAY_FONT Font_11x18 = {11,18, Font_data_11x18};
+DISPLAY_FONT Font_11x18 = {11,18, Font_data_11x18, Font_columns_11x18};
+
+typedef struct DisplayDirty {
+    uint8_t first;
+    uint8_t last;
+} DisplayDirty;
 
 struct Display {
     I2C_HandleTypeDef *p_hi2c1;
-    uint8_t screen[SSD1306_BUFFER_SIZE];
+    // the application draws into back, Display_SwapBuffers() publishes it as front for the flush task
+    uint8_t buffers[2][SSD1306_BUFFER_SIZE];
+    uint8_t *back;
+    uint8_t *front;
+    // columns of every page written since the last swap (back) or flush (front); clean when first > last
+    DisplayDirty back_dirty[SSD1306_PAGES];
+    DisplayDirty front_dirty[SSD1306_PAGES];
+    // copy of the display RAM, i.e. what the panel acknowledged
+    uint8_t panel[SSD1306_BUFFER_SIZE];
+    // changed part of the front buffer in horizontal addressing order, sent with one transfer
+    uint8_t window[SSD1306_BUFFER_SIZE];
+    osMutexId_t lock;           // guards front, front_dirty and panel
+    osThreadId_t flush_task;
     uint16_t x;
     uint16_t y;
     bool is_on;
@@ -152,18 +170,158 @@ struct Display {
 
 static Display self;
 
+static const osThreadAttr_t displayFlush_attributes = {
+        .name = "displayFlush",
+        .stack_size = 128 * 4,
+        .priority = (osPriority_t) osPriorityBelowNormal,
+};
+
+#define DISPLAY_FLUSH_FLAG (1U << 0)
+
 bool Display_WriteCommand(uint8_t cmd) {
-    return (HAL_I2C_Mem_Write(self.p_hi2c1, SSD1306_I2C_ADDR, SSD1306_I2C_CMD_ADDR, 1, &cmd, 1, HAL_MAX_DELAY) == HAL_OK);
+    return (I2CBus_MemWrite(self.p_hi2c1, SSD1306_I2C_ADDR, SSD1306_I2C_CMD_ADDR, &cmd, 1) == HAL_OK);
 }
 
-void Display_WriteData(uint8_t *buffer, size_t buff_size) {
+bool Display_WriteData(uint8_t *buffer, size_t buff_size) {
     assert(self.initialized == true);
-    HAL_I2C_Mem_Write(self.p_hi2c1, SSD1306_I2C_ADDR, SSD1306_I2C_DATA_ADDR, 1, buffer, buff_size, HAL_MAX_DELAY);
+    return (I2CBus_MemWrite(self.p_hi2c1, SSD1306_I2C_ADDR, SSD1306_I2C_DATA_ADDR, buffer, buff_size) == HAL_OK);
+}
+
+// A clean page is {first = WIDTH - 1, last = 0}, so that marking is a plain min/max
+static void Display_MarkDirty(DisplayDirty *dirty, uint8_t first, uint8_t last) {
+    if (first < dirty->first) {
+        dirty->first = first;
+    }
+    if (last > dirty->last) {
+        dirty->last = last;
+    }
+}
+
+static void Display_MarkAllDirty(DisplayDirty *dirty) {
+    for (uint8_t page = 0; page < SSD1306_PAGES; page++) {
+        dirty[page].first = 0;
+        dirty[page].last = SSD1306_WIDTH - 1;
+    }
+}
+
+static void Display_MarkAllClean(DisplayDirty *dirty) {
+    for (uint8_t page = 0; page < SSD1306_PAGES; page++) {
+        dirty[page].first = SSD1306_WIDTH - 1;
+        dirty[page].last = 0;
+    }
+}
+
+// The flush task and the application only contend once the scheduler runs
+static void Display_Lock(void) {
+    if (osKernelGetState() == osKernelRunning) {
+        osMutexAcquire(self.lock, osWaitForever);
+    }
+}
+
+static void Display_Unlock(void) {
+    if (osKernelGetState() == osKernelRunning) {
+        osMutexRelease(self.lock);
+    }
+}
+
+/* Packs the smallest window of pages and columns that covers every column of the front buffer that differs
+ * from the display RAM, and marks the front buffer clean; Display_SettleWindow() tells how the transfer went.
+ * Returns the number of bytes packed, 0 when the display is up to date.
+ */
+static size_t Display_PackWindow(uint8_t *first_page, uint8_t *last_page, uint8_t *first_column, uint8_t *last_column) {
+    uint8_t page_start = SSD1306_PAGES, page_end = 0;
+    DisplayDirty columns = {.first = SSD1306_WIDTH - 1, .last = 0};
+
+    Display_Lock();
+    for (uint8_t page = 0; page < SSD1306_PAGES; page++) {
+        uint8_t first = self.front_dirty[page].first;
+        uint8_t last = self.front_dirty[page].last;
+        // Drawing often puts back what is already shown (Display_Print redraws everything), so keep only
+        // the columns that differ from the display RAM
+        const uint8_t *front = &self.front[SSD1306_WIDTH * page];
+        const uint8_t *panel = &self.panel[SSD1306_WIDTH * page];
+        while (first <= last && front[first] == panel[first]) {
+            first++;
+        }
+        if (first > last) {
+            continue;
+        }
+        while (front[last] == panel[last]) {
+            last--;
+        }
+        if (page_start == SSD1306_PAGES) {
+            page_start = page;
+        }
+        page_end = page;
+        Display_MarkDirty(&columns, first, last);
+    }
+    Display_MarkAllClean(self.front_dirty);
+
+    size_t size = 0;
+    if (page_start < SSD1306_PAGES) {
+        const size_t width = columns.last - columns.first + 1;
+        for (uint8_t page = page_start; page <= page_end; page++) {
+            const size_t offset = (size_t) page * SSD1306_WIDTH + columns.first;
+            memcpy(&self.window[size], &self.front[offset], width);
+            size += width;
+        }
+    }
+    Display_Unlock();
+
+    *first_page = page_start;
+    *last_page = page_end;
+    *first_column = columns.first;
+    *last_column = columns.last;
+    return size;
+}
+
+/* A window the panel took is now in the display RAM; a failed one is marked dirty again, so the next flush sends it
+ * once more along with whatever changed in the meantime
+ */
+static void Display_SettleWindow(bool sent, uint8_t first_page, uint8_t last_page, uint8_t first_column,
+                                 uint8_t last_column) {
+    const size_t width = last_column - first_column + 1;
+    Display_Lock();
+    for (uint8_t page = first_page; page <= last_page; page++) {
+        if (sent) {
+            memcpy(&self.panel[(size_t) page * SSD1306_WIDTH + first_column],
+                   &self.window[(size_t) (page - first_page) * width], width);
+        } else {
+            Display_MarkDirty(&self.front_dirty[page], first_column, last_column);
+        }
+    }
+    Display_Unlock();
+}
+
+// Sends the changes of the front buffer: one command transfer for the window, one data transfer for its content
+static void Display_Flush(void) {
+    uint8_t first_page, last_page, first_column, last_column;
+    const size_t size = Display_PackWindow(&first_page, &last_page, &first_column, &last_column);
+    if (size == 0) {
+        return;
+    }
+    // In horizontal addressing mode the column pointer wraps to the next page of the window
+    const uint8_t window[] = {
+            0x21, first_column + SSD1306_X_OFFSET, last_column + SSD1306_X_OFFSET, // column start and end address
+            0x22, first_page, last_page,                                           // page start and end address
+    };
+    const bool sent = I2CBus_MemWrite(self.p_hi2c1, SSD1306_I2C_ADDR, SSD1306_I2C_CMD_ADDR, window,
+                                      sizeof window) == HAL_OK && Display_WriteData(self.window, size);
+    Display_SettleWindow(sent, first_page, last_page, first_column, last_column);
+}
+
+static void Display_FlushTask(void *argument) {
+    (void) argument;
+    while (true) {
+        osThreadFlagsWait(DISPLAY_FLUSH_FLAG, osFlagsWaitAny, osWaitForever);
+        Display_Flush();
+    }
 }
 
 bool Display_FillBuffer(uint8_t const *const buf, const uint32_t len) {
     if (len <= SSD1306_BUFFER_SIZE) {
-        memcpy(self.screen, buf, len);
+        memcpy(self.back, buf, len);
+        Display_MarkAllDirty(self.back_dirty);
         return true;
     }
     return false;
@@ -177,6 +335,10 @@ bool Display_SetOn(const bool on) {
 void Display_Init(I2C_HandleTypeDef * p_hi2c1) {
     assert(self.initialized == false);
     self.p_hi2c1 = p_hi2c1;
+    self.back = self.buffers[0];
+    self.front = self.buffers[1];
+    Display_MarkAllClean(self.back_dirty);
+    Display_MarkAllClean(self.front_dirty);
 
     self.initialized = Display_SetOn(false);
     self.initialized = self.initialized && Display_WriteCommand(0x20); // Set Memory Addressing Mode
@@ -217,11 +379,20 @@ void Display_Init(I2C_HandleTypeDef * p_hi2c1) {
     self.initialized = self.initialized && Display_WriteCommand(0x14); //
     self.initialized = self.initialized && Display_SetOn(true); //--turn on SSD1306 panel
 
+    if (self.initialized) {
+        // a panel that does not answer leaves the display off, running out of heap is a bug
+        self.lock = osMutexNew(NULL);
+        assert(self.lock != NULL);
+        self.flush_task = osThreadNew(Display_FlushTask, NULL, &displayFlush_attributes);
+        assert(self.flush_task != NULL);
+    }
+
     if (self.initialized) {
         // Clear screen
         Display_Fill(Black);
 
-        // Flush buffer to screen
+        // The display RAM is undefined after power-up, make every column differ from the cleared screen
+        memset(self.panel, 0xFF, sizeof self.panel);
         Display_UpdateScreen();
 
         // Set default values for screen object
@@ -232,19 +403,35 @@ void Display_Init(I2C_HandleTypeDef * p_hi2c1) {
 
 void Display_Fill(DISPLAY_COLOR color) {
     assert(self.initialized == true);
-    memset(self.screen, (color == Black) ? 0x00 : 0xFF, sizeof self.screen);
+    memset(self.back, (color == Black) ? 0x00 : 0xFF, SSD1306_BUFFER_SIZE);
+    Display_MarkAllDirty(self.back_dirty);
 }
 
-void Display_UpdateScreen(void) {
+void Display_SwapBuffers(void) {
     assert(self.initialized == true);
-    for (uint8_t i = 0; i < SSD1306_HEIGHT / 8; i++) {
-        Display_WriteCommand(0xB0 + i); // Set the current RAM page address.
-        Display_WriteCommand(0x00 + SSD1306_X_OFFSET_LOWER);
-        Display_WriteCommand(0x10 + SSD1306_X_OFFSET_UPPER);
-        Display_WriteData(&self.screen[SSD1306_WIDTH * i], SSD1306_WIDTH);
+    Display_Lock();
+    uint8_t *const published = self.back;
+    self.back = self.front;
+    self.front = published;
+    // drawing goes on from the published frame; changes not flushed yet stay in front_dirty
+    memcpy(self.back, self.front, SSD1306_BUFFER_SIZE);
+    for (uint8_t page = 0; page < SSD1306_PAGES; page++) {
+        Display_MarkDirty(&self.front_dirty[page], self.back_dirty[page].first, self.back_dirty[page].last);
+    }
+    Display_MarkAllClean(self.back_dirty);
+    Display_Unlock();
+
+    if (osKernelGetState() == osKernelRunning) {
+        osThreadFlagsSet(self.flush_task, DISPLAY_FLUSH_FLAG);
+    } else {
+        Display_Flush();
     }
 }
 
+void Display_UpdateScreen(void) {
+    Display_SwapBuffers();
+}
+
 void Display_DrawPixel(uint8_t x, uint8_t y, DISPLAY_COLOR color) {
     assert(self.initialized == true);
     if (x >= SSD1306_WIDTH || y >= SSD1306_HEIGHT) {
@@ -252,10 +439,39 @@ void Display_DrawPixel(uint8_t x, uint8_t y, DISPLAY_COLOR color) {
     }
 
     // Draw in the right color
-    if (color == White) {
-        self.screen[x + (y / 8) * SSD1306_WIDTH] |= 1 << (y % 8);
-    } else {
-        self.screen[x + (y / 8) * SSD1306_WIDTH] &= ~(1 << (y % 8));
+    uint8_t *const byte = &self.back[x + (y / 8) * SSD1306_WIDTH];
+    const uint8_t value = (color == White) ? (*byte | (1 << (y % 8))) : (*byte & ~(1 << (y % 8)));
+    if (value != *byte) {
+        *byte = value;
+        Display_MarkDirty(&self.back_dirty[y / 8], x, x);
+    }
+}
+
+/* Writes a glyph at the cursor a page byte at a time: every column of the transposed font is shifted to the
+ * row of the cursor and merged into the pages it covers, background pixels included.
+ */
+static void Display_BlitGlyph(const uint32_t *columns, uint8_t width, uint8_t height, DISPLAY_COLOR color) {
+    const uint8_t shift = self.y % 8;
+    const uint8_t first_page = self.y / 8;
+    const uint32_t cell = (((uint32_t) 1 << height) - 1) << shift;
+    const uint8_t last_column = self.x + width - 1;
+    uint8_t last_page = (self.y + height - 1) / 8;
+    if (last_page >= SSD1306_PAGES) {
+        last_page = SSD1306_PAGES - 1;
+    }
+
+    for (uint8_t page = first_page; page <= last_page; page++) {
+        const uint8_t offset = (page - first_page) * 8;
+        const uint8_t mask = (uint8_t) (cell >> offset);
+        uint8_t *const bytes = &self.back[page * SSD1306_WIDTH + self.x];
+        for (uint8_t j = 0; j < width; j++) {
+            uint8_t ink = (uint8_t) ((columns[j] << shift) >> offset);
+            if (color == Black) {
+                ink = ~ink;
+            }
+            bytes[j] = (bytes[j] & ~mask) | (ink & mask);
+        }
+        Display_MarkDirty(&self.back_dirty[page], self.x, last_column);
     }
 }
 
@@ -274,6 +490,13 @@ char Display_WriteChar(char ch, DISPLAY_FONT Font, DISPLAY_COLOR color) {
         Display_SetCursor(0, self.y + Font.FontHeight);
     }
 
+    // a shifted column must fit in one word
+    if (Font.columns != NULL && Font.FontHeight <= 32 - 7) {
+        Display_BlitGlyph(&Font.columns[(ch - 32) * Font.FontWidth], Font.FontWidth, Font.FontHeight, color);
+        self.x += Font.FontWidth;
+        return ch;
+    }
+
     for (uint8_t i = 0; i < Font.FontHeight; i++) {
         int b = Font.data[(ch - 32) * Font.FontHeight + i];
         for (uint8_t j = 0; j < Font.FontWidth; j++) {
@@ -309,8 +532,56 @@ void Display_SetCursor(uint8_t x, uint8_t y) {
     self.y = y;
 }
 
+/* Sets or clears the pixels of x_start..x_end and y_start..y_end (inclusive, start <= end) a page byte at a time:
+ * the rows a page has in the area become a mask, so partly covered pages cost one read-modify-write per column
+ * and fully covered pages a memset.
+ */
+static void Display_FillSpan(uint8_t x_start, uint8_t x_end, uint8_t y_start, uint8_t y_end, DISPLAY_COLOR color) {
+    if (x_start >= SSD1306_WIDTH || y_start >= SSD1306_HEIGHT) {
+        return;
+    }
+    if (x_end >= SSD1306_WIDTH) {
+        x_end = SSD1306_WIDTH - 1;
+    }
+    if (y_end >= SSD1306_HEIGHT) {
+        y_end = SSD1306_HEIGHT - 1;
+    }
+
+    const uint8_t width = x_end - x_start + 1;
+    for (uint8_t page = y_start / 8; page <= y_end / 8; page++) {
+        // head and tail masks of the rows the page has in the area
+        uint8_t mask = 0xFF;
+        if (page == y_start / 8) {
+            mask &= (uint8_t) (0xFF << (y_start % 8));
+        }
+        if (page == y_end / 8) {
+            mask &= (uint8_t) (0xFF >> (7 - y_end % 8));
+        }
+
+        uint8_t *const bytes = &self.back[page * SSD1306_WIDTH + x_start];
+        if (mask == 0xFF) {
+            memset(bytes, (color == White) ? 0xFF : 0x00, width);
+        } else if (color == White) {
+            for (uint8_t j = 0; j < width; j++) {
+                bytes[j] |= mask;
+            }
+        } else {
+            for (uint8_t j = 0; j < width; j++) {
+                bytes[j] &= ~mask;
+            }
+        }
+        Display_MarkDirty(&self.back_dirty[page], x_start, x_end);
+    }
+}
+
 void Display_DrawLine(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, DISPLAY_COLOR color) {
     assert(self.initialized == true);
+    if (x1 == x2 || y1 == y2) {
+        // horizontal and vertical lines are spans
+        Display_FillSpan((x1 <= x2) ? x1 : x2, (x1 <= x2) ? x2 : x1, (y1 <= y2) ? y1 : y2, (y1 <= y2) ? y2 : y1, color);
+        return;
+    }
+
     int32_t deltaX = abs(x2 - x1);
     int32_t deltaY = abs(y2 - y1);
     int32_t signX = ((x1 < x2) ? 1 : -1);
@@ -351,17 +622,15 @@ void Display_FillRectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, DISPL
     uint8_t y_start = ((y1<=y2) ? y1 : y2);
     uint8_t y_end   = ((y1<=y2) ? y2 : y1);
 
-    for (uint8_t y= y_start; (y<= y_end)&&(y<SSD1306_HEIGHT); y++) {
-        for (uint8_t x= x_start; (x<= x_end)&&(x<SSD1306_WIDTH); x++) {
-            Display_DrawPixel(x, y, color);
-        }
-    }
+    Display_FillSpan(x_start, x_end, y_start, y_end, color);
 }
 
 bool Display_SetContrast(const uint8_t value) {
     assert(self.initialized == true);
-    static const uint8_t setContrastControlRegister = 0x81;
-    return Display_WriteCommand(setContrastControlRegister) && Display_WriteCommand(value);
+    // command and argument in one transfer, so that a flush cannot get in between
+    const uint8_t setContrastControl[] = {0x81, value};
+    return I2CBus_MemWrite(self.p_hi2c1, SSD1306_I2C_ADDR, SSD1306_I2C_CMD_ADDR, setContrastControl,
+                           sizeof setContrastControl) == HAL_OK;
 }
 
 bool Display_IsOn() {
@@ -385,6 +654,6 @@ void Display_Print(const char *format, ...) {
     vsnprintf(message, SSD1306_BUFFER_SIZE, format, args);
     Display_WriteString(message, Font_11x18, White);
 
-    Display_UpdateScreen();
+    Display_SwapBuffers();
     va_end(args);
 }
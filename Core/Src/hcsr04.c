@@ -1,90 +1,302 @@
 #include "hcsr04.h"
-#include "stm32f3xx_hal_gpio.h"
+#include "cmsis_os2.h"
 #include <assert.h>
 #include <math.h>
 
-typedef struct HCSR04 {
-    uint32_t trig_pin;
-    uint16_t _elapsed;
-    GPIO_TypeDef *GPIOx;
-    TIM_HandleTypeDef *htim; // timer to use for delay of <= 10 microseconds
-    HCSR04_External_Dependency_t getHumidity;
-    HCSR04_External_Dependency_t getTemperature;
+_Static_assert((HCSR04_SAMPLE_BUFFER_SIZE & (HCSR04_SAMPLE_BUFFER_SIZE - 1)) == 0,
+               "HCSR04_SAMPLE_BUFFER_SIZE must be a power of two");
+
+// Width of the trigger pulse in ticks of the trigger timer (1 us), at least the 10 us of the datasheet
+#define TRIGGER_PULSE_TICKS 11U
+_Static_assert(HCSR04_MAX_GUARD_US + TRIGGER_PULSE_TICKS - 1U == 0xFFFFU,
+               "the longest delay of a trigger has to end the pulse at the top of the 16 bit period");
+// The trigger timer ticks 10 times slower in continuous mode, so that 2 Hz still fits the 16 bit period
+#define CONTINUOUS_TICK_US 10U
+// Trigger pulse of 20 us in continuous mode
+#define CONTINUOUS_PULSE_TICKS 2U
+
+typedef enum HCSR04_Mode {
+    HCSR04_MODE_SINGLE,         // one measurement per call
+    HCSR04_MODE_CONTINUOUS,     // free-running trigger timer
+    HCSR04_MODE_ROUND_ROBIN,    // triggered by the end of the echo of the previous sensor
+} HCSR04_Mode;
+
+/* Extends the counter of an echo timer to 32 bits with the number of its overflows. The update interrupt only
+ * runs while a sensor on the timer is measuring; a 32 bit counter (TIM2) needs no interrupt at all.
+ */
+typedef struct HCSR04_Timebase {
+    TIM_HandleTypeDef *htim;
+    uint32_t period;        // Init.Period + 1, 0 for a 32 bit counter
+    uint32_t overflows;
+    uint8_t users;
+} HCSR04_Timebase;
+
+struct HCSR04 {
+    uint32_t _elapsed;      // ticks of the echo timer
+    HCSR04Peripheral peripheral;
+    HCSR04_Timebase *timebase;
+    uint32_t tick_hz;
+    // Half the speed of sound in millimetres per tick of the echo timer, Q32, and in metres per tick
+    uint32_t mm_per_tick_q32;
+    float m_per_tick;
+    HAL_TIM_ActiveChannel echo_active_channel;  // htim->Channel in the capture callback of this sensor
     struct {
-        uint32_t then;
         bool old_flag;
     } non_blocking_state_memory;
     bool _elapsed_last_value_flag;
+    bool first_edge;        // the next capture is the rising edge of the echo
+    uint32_t rising_edge;   // extended capture
+    osThreadId_t waiting;   // task sleeping in HCSR04_MeasureDistance, NULL when polling
+    HCSR04_Mode mode;
+    uint32_t prescaler;     // of the trigger timer in one-pulse mode, restored by HCSR04_StopContinuous
+    // Single producer, single consumer: the capture interrupt advances head, HCSR04_ReadSamples advances tail
+    HCSR04_Sample samples[HCSR04_SAMPLE_BUFFER_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
     bool initialized;
-} HCSR04;
+};
+
+static HCSR04 sensors[HCSR04_MAX_SENSORS];
 
-static HCSR04 self = {.initialized = false};
+static HCSR04_Timebase timebases[HCSR04_MAX_SENSORS];
 
-void HCSR04_Init(GPIO_TypeDef *GPIOx, uint16_t trig_pin, uint16_t echo_pin, TIM_HandleTypeDef *htim,
-                 HCSR04_External_Dependency_t getHumidity, HCSR04_External_Dependency_t getTemperature) {
-    assert(!self.initialized);
-    (void) echo_pin;
+static struct {
+    HCSR04_External_Dependency_t getHumidity;
+    HCSR04_External_Dependency_t getTemperature;
+} air;
+
+static struct {
+    HCSR04 *sensors[HCSR04_MAX_SENSORS];
+    size_t count;
+    size_t current;         // sensor whose echo is awaited
+    uint16_t guard_us;
+    uint32_t triggered_ms;
+    bool running;
+} round_robin;
+
+static HCSR04 *HCSR04_Find(const TIM_HandleTypeDef *htim, HAL_TIM_ActiveChannel channel) {
+    for (size_t i = 0; i < HCSR04_MAX_SENSORS; i++) {
+        if (sensors[i].initialized && sensors[i].peripheral.echo_htim == htim &&
+            sensors[i].echo_active_channel == channel) {
+            return &sensors[i];
+        }
+    }
+    return NULL;
+}
 
-    self.trig_pin = trig_pin;
-    self.GPIOx = GPIOx;
-    self.htim = htim;
-    self.getHumidity = getHumidity;
-    self.getTemperature = getTemperature;
-    self._elapsed_last_value_flag = false;
-    self.initialized = true;
+static HCSR04_Timebase *HCSR04_Timebase_Get(TIM_HandleTypeDef *htim) {
+    for (size_t i = 0; i < HCSR04_MAX_SENSORS; i++) {
+        if (timebases[i].htim == htim) {
+            return &timebases[i];
+        }
+        if (timebases[i].htim == NULL) {
+            timebases[i] = (HCSR04_Timebase) {.htim = htim, .period = htim->Init.Period + 1U};
+            return &timebases[i];
+        }
+    }
+    assert(false);
+    return NULL;
 }
 
-static float to_seconds(float microseconds) {
-    return microseconds / 1000000.0f;
+// Starts counting the overflows for one more measurement; called with interrupts disabled
+static void HCSR04_Timebase_Acquire(HCSR04_Timebase *self) {
+    if (self->period != 0U && self->users++ == 0U) {
+        // an overflow before this point is of no interest, one after it raises the interrupt right away
+        __HAL_TIM_CLEAR_FLAG(self->htim, TIM_FLAG_UPDATE);
+        __HAL_TIM_ENABLE_IT(self->htim, TIM_IT_UPDATE);
+    }
 }
 
-static void HCSR04_Trigger() {
-    HAL_GPIO_WritePin(self.GPIOx, self.trig_pin, GPIO_PIN_SET);
-    const uint32_t then = __HAL_TIM_GET_COUNTER(self.htim);
-    while (__HAL_TIM_GET_COUNTER(self.htim) - then < 11) {
-        // wait for at least 11 microseconds, blocking
+static void HCSR04_Timebase_Release(HCSR04_Timebase *self) {
+    if (self->period != 0U && --self->users == 0U) {
+        __HAL_TIM_DISABLE_IT(self->htim, TIM_IT_UPDATE);
     }
-    HAL_GPIO_WritePin(self.GPIOx, self.trig_pin, GPIO_PIN_RESET);
 }
 
-static float HCSR04_SpeedOfSound_Ms(void) {
-    return (331.3f + (0.606f * floorf(self.getTemperature())) + (0.0124f * floorf(self.getHumidity())));
+/* Called from the capture interrupt. HAL_TIM_IRQHandler serves the captures before the update, so a capture in
+ * the first half of the period while the update is still pending was taken after that overflow.
+ */
+static uint32_t HCSR04_Timebase_Extend(const HCSR04_Timebase *self, uint32_t captured) {
+    uint32_t overflows = self->overflows;
+    if (__HAL_TIM_GET_FLAG(self->htim, TIM_FLAG_UPDATE) && captured < self->period / 2U) {
+        overflows++;
+    }
+    // wraps at 2^32 like the counter of a 32 bit timer, so differences stay right either way
+    return overflows * self->period + captured;
 }
 
-float HCSR04_MeasureDistanceInMeters(void) {
-    assert(self.initialized);
-    const bool old_flag = self._elapsed_last_value_flag;
-    HCSR04_Trigger();
-    while (old_flag == self._elapsed_last_value_flag) {
-        // wait for the interrupt to update the time elapsed, blocking
-        // this takes at most 38 milliseconds
+void HCSR04_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
+    for (size_t i = 0; i < HCSR04_MAX_SENSORS && timebases[i].htim != NULL; i++) {
+        if (timebases[i].htim == htim) {
+            timebases[i].overflows++;
+            return;
+        }
     }
-    const float dist = (to_seconds(self._elapsed) * HCSR04_SpeedOfSound_Ms()) / 2;
-    return dist;
 }
 
-HCSR04_Execution_State_t HCSR04_MeasureDistanceInMetersNonBlocking(float *out_distance_m, HCSR04_Execution_State_t current_state) {
-    assert(self.initialized);
+HCSR04 *HCSR04_Init(HCSR04Peripheral peripheral, HCSR04_External_Dependency_t getHumidity,
+                    HCSR04_External_Dependency_t getTemperature) {
+    HCSR04 *self = NULL;
+    for (size_t i = 0; i < HCSR04_MAX_SENSORS && self == NULL; i++) {
+        assert(!sensors[i].initialized || sensors[i].peripheral.trigger_htim != peripheral.trigger_htim);
+        if (!sensors[i].initialized) {
+            self = &sensors[i];
+        }
+    }
+    assert(self != NULL);
+
+    *self = (HCSR04) {
+            .peripheral = peripheral,
+            .echo_active_channel = (HAL_TIM_ActiveChannel) (1U << (peripheral.echo_channel >> 2U)),
+            .timebase = HCSR04_Timebase_Get(peripheral.echo_htim),
+            // the timers run on the core clock at 72 MHz
+            .tick_hz = SystemCoreClock / (peripheral.echo_htim->Init.Prescaler + 1U),
+            .first_edge = true,
+            .mode = HCSR04_MODE_SINGLE,
+    };
+    // enables the output only; every __HAL_TIM_ENABLE starts one pulse
+    HAL_StatusTypeDef status = HAL_TIM_OnePulse_Start(peripheral.trigger_htim, peripheral.trigger_channel);
+    assert(status == HAL_OK);
+    status = HAL_TIM_IC_Start_IT(peripheral.echo_htim, peripheral.echo_channel);
+    assert(status == HAL_OK);
+    self->initialized = true;
+
+    air.getHumidity = getHumidity;
+    air.getTemperature = getTemperature;
+    HCSR04_UpdateSpeedOfSound();
+    return self;
+}
+
+/* The trigger timer drives its output high from the compare value to the end of the period and stops by itself.
+ * The compare and period registers are preloaded, so the update event generated here loads them.
+ */
+static void HCSR04_TriggerAfter(HCSR04 *self, uint16_t delay_us) {
+    assert(delay_us <= HCSR04_MAX_GUARD_US);
+    TIM_HandleTypeDef *htim = self->peripheral.trigger_htim;
+    const uint32_t start = (delay_us > 0U) ? delay_us : 1U;
+    __HAL_TIM_SET_AUTORELOAD(htim, start + TRIGGER_PULSE_TICKS - 1U);
+    __HAL_TIM_SET_COMPARE(htim, self->peripheral.trigger_channel, start);
+    htim->Instance->EGR = TIM_EGR_UG;
+    __HAL_TIM_ENABLE(htim);
+}
+
+static void HCSR04_Trigger(HCSR04 *self) {
+    HCSR04_TriggerAfter(self, 0);
+}
+
+void HCSR04_UpdateSpeedOfSound(void) {
+    assert(air.getTemperature != NULL && air.getHumidity != NULL);
+    const float speed_of_sound_ms =
+            331.3f + (0.606f * floorf(air.getTemperature())) + (0.0124f * floorf(air.getHumidity()));
+    for (size_t i = 0; i < HCSR04_MAX_SENSORS; i++) {
+        HCSR04 *self = &sensors[i];
+        if (!self->initialized) {
+            continue;
+        }
+        // 1000 mm per metre, halved for the round trip; below 1 MHz ticks the factor would not fit Q32
+        const float mm_per_tick = speed_of_sound_ms * 500.0f / (float) self->tick_hz;
+        assert(mm_per_tick < 1.0f);
+        self->mm_per_tick_q32 = (uint32_t) llroundf(mm_per_tick * 4294967296.0f);
+        self->m_per_tick = mm_per_tick / 1000.0f;
+    }
+}
+
+// A missed edge can pair unrelated captures, so the width is not bounded by the 38 ms of the module
+static uint16_t HCSR04_TicksToMm(const HCSR04 *self, uint32_t ticks) {
+    const uint32_t mm = (uint32_t) (((uint64_t) ticks * self->mm_per_tick_q32 + (1ULL << 31U)) >> 32U);
+    return (mm > UINT16_MAX) ? UINT16_MAX : (uint16_t) mm;
+}
+
+static float HCSR04_TicksToMeters(const HCSR04 *self, uint32_t ticks) {
+    return (float) ticks * self->m_per_tick;
+}
+
+// Triggers one measurement and waits for the end of its echo, whose width is left in _elapsed
+static bool HCSR04_Measure(HCSR04 *self, uint32_t timeout_ms) {
+    assert(self->initialized);
+    assert(self->mode == HCSR04_MODE_SINGLE);
+    const bool kernel_running = osKernelGetState() == osKernelRunning;
+
+    __disable_irq();
+    // an echo that ended after the previous timeout must not complete this measurement
+    self->first_edge = true;
+    self->waiting = kernel_running ? osThreadGetId() : NULL;
+    HCSR04_Timebase_Acquire(self->timebase);
+    __enable_irq();
+    if (kernel_running) {
+        osThreadFlagsClear(HCSR04_THREAD_FLAG);
+    }
+
+    const bool old_flag = self->_elapsed_last_value_flag;
+    HCSR04_Trigger(self);
+    bool echoed;
+    if (kernel_running) {
+        // the capture interrupt of the falling edge of the echo wakes the task up
+        echoed = (osThreadFlagsWait(HCSR04_THREAD_FLAG, osFlagsWaitAny, timeout_ms) & osFlagsError) == 0U;
+    } else {
+        const uint32_t start = HAL_GetTick();
+        while (old_flag == self->_elapsed_last_value_flag && HAL_GetTick() - start < timeout_ms) {
+            // no scheduler to sleep on yet
+        }
+        echoed = old_flag != self->_elapsed_last_value_flag;
+    }
+
+    __disable_irq();
+    self->waiting = NULL;
+    HCSR04_Timebase_Release(self->timebase);
+    __enable_irq();
+    return echoed;
+}
+
+bool HCSR04_MeasureDistance(HCSR04 *self, float *out_distance_m, uint32_t timeout_ms) {
+    if (!HCSR04_Measure(self, timeout_ms)) {
+        return false;
+    }
+    *out_distance_m = HCSR04_TicksToMeters(self, self->_elapsed);
+    return true;
+}
+
+bool HCSR04_MeasureDistanceMm(HCSR04 *self, uint16_t *out_distance_mm, uint32_t timeout_ms) {
+    if (!HCSR04_Measure(self, timeout_ms)) {
+        return false;
+    }
+    *out_distance_mm = HCSR04_TicksToMm(self, self->_elapsed);
+    return true;
+}
+
+float HCSR04_MeasureDistanceInMeters(HCSR04 *self) {
+    float distance_m = 0.0f;
+    HCSR04_MeasureDistance(self, &distance_m, HCSR04_ECHO_TIMEOUT_MS);
+    return distance_m;
+}
+
+HCSR04_Execution_State_t HCSR04_MeasureDistanceInMetersNonBlocking(HCSR04 *self, float *out_distance_m,
+                                                                   HCSR04_Execution_State_t current_state) {
+    assert(self->initialized);
+    assert(self->mode == HCSR04_MODE_SINGLE);
 
     switch (current_state) {
         case HCSR04_PRE_TRIGGER: {
-            self.non_blocking_state_memory.then = __HAL_TIM_GET_COUNTER(self.htim);
-            self.non_blocking_state_memory.old_flag = self._elapsed_last_value_flag;
-            HAL_GPIO_WritePin(self.GPIOx, self.trig_pin, GPIO_PIN_SET);
-        }
-        case HCSR04_TRIGGER: {
-            if (__HAL_TIM_GET_COUNTER(self.htim) - self.non_blocking_state_memory.then < 11) {
-                return HCSR04_TRIGGER;
-            }
+            self->non_blocking_state_memory.old_flag = self->_elapsed_last_value_flag;
+            __disable_irq();
+            self->first_edge = true;
+            HCSR04_Timebase_Acquire(self->timebase);
+            __enable_irq();
+            HCSR04_Trigger(self);
         }
+        case HCSR04_TRIGGER:
         case HCSR04_POST_TRIGGER:
-            HAL_GPIO_WritePin(self.GPIOx, self.trig_pin, GPIO_PIN_RESET);
+            // the pulse is timed by the hardware
         case HCSR04_WAIT_FOR_ECHO:
-            if (self._elapsed_last_value_flag == self.non_blocking_state_memory.old_flag) {
+            if (self->_elapsed_last_value_flag == self->non_blocking_state_memory.old_flag) {
                 return HCSR04_WAIT_FOR_ECHO;
             }
         case HCSR04_CALCULATE_DISTANCE: {
-            *out_distance_m = (to_seconds(self._elapsed) * HCSR04_SpeedOfSound_Ms()) / 2;
+            __disable_irq();
+            HCSR04_Timebase_Release(self->timebase);
+            __enable_irq();
+            *out_distance_m = HCSR04_TicksToMeters(self, self->_elapsed);
             return HCSR04_DONE;
         }
         default:
@@ -97,34 +309,186 @@ static float to_cm(float meters) {
 }
 
 bool HCSR04_IsValidDistance(float distance_m) {
-    assert(self.initialized);
     return to_cm(distance_m) >= 2.0f && to_cm(distance_m) <= 400.0f;
 }
 
-void HCSR04_ElapsedTimeMeasuredCallback(uint16_t time) {
-    self._elapsed = time;
-    self._elapsed_last_value_flag = !self._elapsed_last_value_flag;
+bool HCSR04_IsValidDistanceMm(uint16_t distance_mm) {
+    return distance_mm >= 20U && distance_mm <= 4000U;
+}
+
+bool HCSR04_StartContinuous(HCSR04 *self, uint32_t rate_hz) {
+    assert(self->initialized);
+    assert(self->mode == HCSR04_MODE_SINGLE);
+    if (rate_hz < HCSR04_MIN_RATE_HZ || rate_hz > HCSR04_MAX_RATE_HZ) {
+        return false;
+    }
+    TIM_HandleTypeDef *htim = self->peripheral.trigger_htim;
+    self->prescaler = htim->Instance->PSC;
+
+    __disable_irq();
+    self->first_edge = true;
+    self->mode = HCSR04_MODE_CONTINUOUS;
+    HCSR04_Timebase_Acquire(self->timebase);
+    __enable_irq();
+
+    // PWM mode 2 keeps the output high from the compare value to the end of every period
+    const uint32_t period = 1000000U / CONTINUOUS_TICK_US / rate_hz;
+    __HAL_TIM_SET_PRESCALER(htim, (self->prescaler + 1U) * CONTINUOUS_TICK_US - 1U);
+    __HAL_TIM_SET_AUTORELOAD(htim, period - 1U);
+    __HAL_TIM_SET_COMPARE(htim, self->peripheral.trigger_channel, period - CONTINUOUS_PULSE_TICKS);
+    CLEAR_BIT(htim->Instance->CR1, TIM_CR1_OPM);
+    // loads the prescaler and restarts the counter
+    htim->Instance->EGR = TIM_EGR_UG;
+    __HAL_TIM_ENABLE(htim);
+    return true;
+}
+
+void HCSR04_StopContinuous(HCSR04 *self) {
+    assert(self->mode == HCSR04_MODE_CONTINUOUS);
+    TIM_HandleTypeDef *htim = self->peripheral.trigger_htim;
+    // __HAL_TIM_DISABLE leaves the counter running while the channel output is enabled
+    CLEAR_BIT(htim->Instance->CR1, TIM_CR1_CEN);
+    SET_BIT(htim->Instance->CR1, TIM_CR1_OPM);
+    __HAL_TIM_SET_PRESCALER(htim, self->prescaler);
+    htim->Instance->EGR = TIM_EGR_UG;
+
+    __disable_irq();
+    self->mode = HCSR04_MODE_SINGLE;
+    HCSR04_Timebase_Release(self->timebase);
+    __enable_irq();
+}
+
+// Called from the capture interrupt or with interrupts disabled
+static void HCSR04_RoundRobinNext(uint16_t delay_us) {
+    round_robin.current = (round_robin.current + 1U) % round_robin.count;
+    HCSR04 *next = round_robin.sensors[round_robin.current];
+    next->first_edge = true;
+    round_robin.triggered_ms = HAL_GetTick();
+    HCSR04_TriggerAfter(next, delay_us);
+}
+
+bool HCSR04_StartRoundRobin(HCSR04 *const *sensors_in_turn, size_t count, uint16_t guard_us) {
+    assert(!round_robin.running);
+    assert(count > 0 && count <= HCSR04_MAX_SENSORS);
+    if (guard_us > HCSR04_MAX_GUARD_US) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        assert(sensors_in_turn[i]->initialized);
+        if (sensors_in_turn[i]->mode != HCSR04_MODE_SINGLE) {
+            return false;
+        }
+    }
+
+    __disable_irq();
+    for (size_t i = 0; i < count; i++) {
+        round_robin.sensors[i] = sensors_in_turn[i];
+        sensors_in_turn[i]->mode = HCSR04_MODE_ROUND_ROBIN;
+        HCSR04_Timebase_Acquire(sensors_in_turn[i]->timebase);
+    }
+    round_robin.count = count;
+    round_robin.current = count - 1U;
+    round_robin.guard_us = guard_us;
+    round_robin.running = true;
+    HCSR04_RoundRobinNext(0);
+    __enable_irq();
+    return true;
+}
+
+void HCSR04_StopRoundRobin(void) {
+    assert(round_robin.running);
+    __disable_irq();
+    // a trigger already armed still fires, but its echo is not queued any more
+    for (size_t i = 0; i < round_robin.count; i++) {
+        round_robin.sensors[i]->mode = HCSR04_MODE_SINGLE;
+        HCSR04_Timebase_Release(round_robin.sensors[i]->timebase);
+    }
+    round_robin.running = false;
+    __enable_irq();
+}
+
+void HCSR04_CheckRoundRobin(void) {
+    __disable_irq();
+    if (round_robin.running && HAL_GetTick() - round_robin.triggered_ms > HCSR04_ECHO_TIMEOUT_MS) {
+        HCSR04_RoundRobinNext(round_robin.guard_us);
+    }
+    __enable_irq();
+}
+
+// Producer side, from the capture interrupt; a full buffer keeps the older samples
+static void HCSR04_PushSample(HCSR04 *self, uint32_t echo_ticks) {
+    const uint32_t head = self->head;
+    if (head - __atomic_load_n(&self->tail, __ATOMIC_ACQUIRE) == HCSR04_SAMPLE_BUFFER_SIZE) {
+        self->dropped++;
+        return;
+    }
+    self->samples[head & (HCSR04_SAMPLE_BUFFER_SIZE - 1)] = (HCSR04_Sample) {
+            .timestamp_ms = HAL_GetTick(),
+            .echo_ticks = echo_ticks,
+    };
+    __atomic_store_n(&self->head, head + 1U, __ATOMIC_RELEASE);
+}
+
+size_t HCSR04_ReadSamples(HCSR04 *self, HCSR04_Sample *samples, size_t max_samples) {
+    assert(self->initialized);
+    const uint32_t tail = self->tail;
+    const uint32_t available = __atomic_load_n(&self->head, __ATOMIC_ACQUIRE) - tail;
+    const size_t count = (available < max_samples) ? available : max_samples;
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = self->samples[(tail + i) & (HCSR04_SAMPLE_BUFFER_SIZE - 1)];
+    }
+    __atomic_store_n(&self->tail, tail + (uint32_t) count, __ATOMIC_RELEASE);
+    return count;
+}
+
+uint32_t HCSR04_GetDroppedSamples(const HCSR04 *self) {
+    return __atomic_load_n(&self->dropped, __ATOMIC_RELAXED);
+}
+
+float HCSR04_SampleToMeters(const HCSR04 *self, const HCSR04_Sample *sample) {
+    return HCSR04_TicksToMeters(self, sample->echo_ticks);
+}
+
+uint16_t HCSR04_SampleToMm(const HCSR04 *self, const HCSR04_Sample *sample) {
+    return HCSR04_TicksToMm(self, sample->echo_ticks);
+}
+
+static void HCSR04_ElapsedTimeMeasuredCallback(HCSR04 *self, uint32_t time) {
+    switch (self->mode) {
+        case HCSR04_MODE_SINGLE:
+            self->_elapsed = time;
+            self->_elapsed_last_value_flag = !self->_elapsed_last_value_flag;
+            if (self->waiting != NULL) {
+                osThreadFlagsSet(self->waiting, HCSR04_THREAD_FLAG);
+            }
+            break;
+        case HCSR04_MODE_CONTINUOUS:
+            HCSR04_PushSample(self, time);
+            break;
+        case HCSR04_MODE_ROUND_ROBIN:
+            HCSR04_PushSample(self, time);
+            if (round_robin.running && round_robin.sensors[round_robin.current] == self) {
+                HCSR04_RoundRobinNext(round_robin.guard_us);
+            }
+            break;
+    }
 }
 
 // Overrides the weak HAL_TIM_IC_CaptureCallback function
 void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim) {
-    static uint16_t first = 0;
-    static uint32_t second = 0;
-    static bool first_edge = true;
-
-    if (htim != self.htim) {
+    HCSR04 *self = HCSR04_Find(htim, htim->Channel);
+    if (self == NULL) {
         return;
     }
 
-    if (first_edge) {
-        first = HAL_TIM_ReadCapturedValue(self.htim, TIM_CHANNEL_1);
+    const uint32_t captured = HCSR04_Timebase_Extend(self->timebase,
+                                                     HAL_TIM_ReadCapturedValue(htim, self->peripheral.echo_channel));
+    if (self->first_edge) {
+        self->rising_edge = captured;
+        self->first_edge = false;
     } else {
-        second = HAL_TIM_ReadCapturedValue(self.htim, TIM_CHANNEL_1);
-        if (second < first) {
-            // the timer counter is 16 bit, so it will overflow at UINT16_MAX + 1
-            second += UINT16_MAX;
-        }
-        HCSR04_ElapsedTimeMeasuredCallback(second - first);
+        // before the callback, which may trigger this sensor again when it is alone in the round robin
+        self->first_edge = true;
+        HCSR04_ElapsedTimeMeasuredCallback(self, captured - self->rising_edge);
     }
-    first_edge = !first_edge;
-}
\ No newline at end of file
+}
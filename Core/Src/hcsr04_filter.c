@@ -0,0 +1,164 @@
+#include "hcsr04_filter.h"
+#include <assert.h>
+#include <string.h>
+
+// Weight 1/2^SCALE_SHIFT of a new deviation in the scale
+#define SCALE_SHIFT 3
+
+/* Heap positions run from -half (max-heap, below the median) over 0 (the median) to half (min-heap, above it).
+ * Position i > 0 has the children 2i and 2i + 1 and -i has -2i and -2i - 1; the parent of both 1 and -1 is 0.
+ */
+static int HCSR04Filter_MinCount(const HCSR04Filter *self) {
+    return (self->count - 1) / 2;
+}
+
+static int HCSR04Filter_MaxCount(const HCSR04Filter *self) {
+    return self->count / 2;
+}
+
+static uint16_t HCSR04Filter_At(const HCSR04Filter *self, int position) {
+    return self->values[self->heap[self->config.window / 2 + position]];
+}
+
+static bool HCSR04Filter_Less(const HCSR04Filter *self, int i, int j) {
+    return HCSR04Filter_At(self, i) < HCSR04Filter_At(self, j);
+}
+
+// Swaps positions i and j when the value at i is the smaller one; returns whether it did
+static bool HCSR04Filter_Exchange(HCSR04Filter *self, int i, int j) {
+    if (!HCSR04Filter_Less(self, i, j)) {
+        return false;
+    }
+    int8_t *heap = &self->heap[self->config.window / 2];
+    const int8_t t = heap[i];
+    heap[i] = heap[j];
+    heap[j] = t;
+    self->pos[heap[i]] = (int8_t) i;
+    self->pos[heap[j]] = (int8_t) j;
+    return true;
+}
+
+// Restores the min-heap from position i, whose parent may have grown, downwards
+static void HCSR04Filter_MinSortDown(HCSR04Filter *self, int i) {
+    for (; i <= HCSR04Filter_MinCount(self); i *= 2) {
+        if (i > 1 && i < HCSR04Filter_MinCount(self) && HCSR04Filter_Less(self, i + 1, i)) {
+            i++;
+        }
+        if (!HCSR04Filter_Exchange(self, i, i / 2)) {
+            break;
+        }
+    }
+}
+
+static void HCSR04Filter_MaxSortDown(HCSR04Filter *self, int i) {
+    for (; i >= -HCSR04Filter_MaxCount(self); i *= 2) {
+        if (i < -1 && i > -HCSR04Filter_MaxCount(self) && HCSR04Filter_Less(self, i, i - 1)) {
+            i--;
+        }
+        if (!HCSR04Filter_Exchange(self, i / 2, i)) {
+            break;
+        }
+    }
+}
+
+// Moves a shrunk value up the min-heap; returns true when it reached the median
+static bool HCSR04Filter_MinSortUp(HCSR04Filter *self, int i) {
+    while (i > 0 && HCSR04Filter_Exchange(self, i, i / 2)) {
+        i /= 2;
+    }
+    return i == 0;
+}
+
+static bool HCSR04Filter_MaxSortUp(HCSR04Filter *self, int i) {
+    while (i < 0 && HCSR04Filter_Exchange(self, i / 2, i)) {
+        i /= 2;
+    }
+    return i == 0;
+}
+
+// Replaces the oldest value of the window, or adds one while it fills up
+static void HCSR04Filter_Insert(HCSR04Filter *self, uint16_t value) {
+    const bool added = self->count < self->config.window;
+    const int p = self->pos[self->next];
+    const uint16_t old = self->values[self->next];
+    self->values[self->next] = value;
+    self->next = (uint8_t) ((self->next + 1U) % self->config.window);
+    if (added) {
+        self->count++;
+    }
+
+    if (p > 0) {
+        if (!added && old < value) {
+            HCSR04Filter_MinSortDown(self, p * 2);
+        } else if (HCSR04Filter_MinSortUp(self, p)) {
+            HCSR04Filter_MaxSortDown(self, -1);
+        }
+    } else if (p < 0) {
+        if (!added && value < old) {
+            HCSR04Filter_MaxSortDown(self, p * 2);
+        } else if (HCSR04Filter_MaxSortUp(self, p)) {
+            HCSR04Filter_MinSortDown(self, 1);
+        }
+    } else {
+        if (HCSR04Filter_MaxCount(self) > 0) {
+            HCSR04Filter_MaxSortDown(self, -1);
+        }
+        if (HCSR04Filter_MinCount(self) > 0) {
+            HCSR04Filter_MinSortDown(self, 1);
+        }
+    }
+}
+
+void HCSR04Filter_Init(HCSR04Filter *self, const HCSR04Filter_Config *config) {
+    assert(config->window >= 1 && config->window <= HCSR04_FILTER_MAX_WINDOW && config->window % 2 == 1);
+    assert(config->smoothing_shift < 16);
+    memset(self, 0, sizeof *self);
+    self->config = *config;
+    // the window fills up alternately below and above the median: 0, -1, 1, -2, 2, ...
+    for (int i = 0; i < config->window; i++) {
+        const int position = ((i + 1) / 2) * ((i % 2) ? -1 : 1);
+        self->pos[i] = (int8_t) position;
+        self->heap[config->window / 2 + position] = (int8_t) i;
+    }
+    self->scale_q8 = (uint32_t) config->min_scale_mm << 8U;
+}
+
+uint16_t HCSR04Filter_Update(HCSR04Filter *self, uint16_t distance_mm) {
+    HCSR04Filter_Insert(self, distance_mm);
+    const uint16_t median = HCSR04Filter_GetMedian(self);
+    self->stats.samples++;
+
+    uint16_t value = median;
+    if (self->config.hampel_k_q4 > 0) {
+        const uint32_t scale_q8 = (self->scale_q8 > ((uint32_t) self->config.min_scale_mm << 8U))
+                                  ? self->scale_q8 : ((uint32_t) self->config.min_scale_mm << 8U);
+        const uint32_t threshold_q8 = (scale_q8 * self->config.hampel_k_q4) >> 4U;
+        uint32_t deviation_q8 = (uint32_t) ((distance_mm > median) ? distance_mm - median : median - distance_mm) << 8U;
+        if (deviation_q8 > threshold_q8) {
+            self->stats.outliers++;
+            // an outlier moves the scale no more than a sample at the threshold would
+            deviation_q8 = threshold_q8;
+        } else {
+            value = distance_mm;
+        }
+        self->scale_q8 = (uint32_t) ((int32_t) self->scale_q8 +
+                                     (((int32_t) deviation_q8 - (int32_t) self->scale_q8) >> SCALE_SHIFT));
+    }
+
+    if (self->stats.samples == 1U) {
+        self->smoothed_q8 = (uint32_t) value << 8U;
+    } else {
+        self->smoothed_q8 = (uint32_t) ((int32_t) self->smoothed_q8 +
+                                        (((int32_t) ((uint32_t) value << 8U) - (int32_t) self->smoothed_q8)
+                                                >> self->config.smoothing_shift));
+    }
+    return (uint16_t) ((self->smoothed_q8 + (1U << 7U)) >> 8U);
+}
+
+uint16_t HCSR04Filter_GetMedian(const HCSR04Filter *self) {
+    return (self->count > 0) ? HCSR04Filter_At(self, 0) : 0;
+}
+
+HCSR04Filter_Stats HCSR04Filter_GetStats(const HCSR04Filter *self) {
+    return self->stats;
+}
@@ -0,0 +1,177 @@
+#include "i2c_bus.h"
+#include "cmsis_os2.h"
+#include <assert.h>
+
+typedef struct I2CBus_Job I2CBus_Job;
+
+// Lives on the stack of the caller, which waits until the job is retired
+struct I2CBus_Job {
+    I2CBus_Job *next;
+    uint16_t dev_address;
+    uint16_t mem_address;
+    uint8_t *data;
+    uint16_t size;
+    bool read;
+    osThreadId_t owner;     // NULL when the caller polls `done`
+    HAL_StatusTypeDef status;
+    volatile bool done;
+};
+
+typedef struct I2CBus {
+    I2C_HandleTypeDef *hi2c;
+    I2CBus_Job *head;       // transfer in flight
+    I2CBus_Job *tail;
+    uint32_t pending;
+    I2CBus_Stats stats;
+} I2CBus;
+
+static I2CBus buses[I2C_BUS_MAX_BUSES];
+
+static I2CBus *I2CBus_Find(I2C_HandleTypeDef *hi2c) {
+    for (size_t i = 0; i < I2C_BUS_MAX_BUSES; i++) {
+        if (buses[i].hi2c == hi2c) {
+            return &buses[i];
+        }
+    }
+    return NULL;
+}
+
+void I2CBus_Init(I2C_HandleTypeDef *hi2c) {
+    assert(I2CBus_Find(hi2c) == NULL);
+    I2CBus *bus = I2CBus_Find(NULL);
+    assert(bus != NULL);
+    *bus = (I2CBus) {.hi2c = hi2c};
+}
+
+bool I2CBus_IsInitialized(I2C_HandleTypeDef *hi2c) {
+    return I2CBus_Find(hi2c) != NULL;
+}
+
+static HAL_StatusTypeDef I2CBus_Start(I2CBus *bus, I2CBus_Job *job) {
+    if (job->read) {
+        return HAL_I2C_Mem_Read_DMA(bus->hi2c, job->dev_address, job->mem_address, I2C_MEMADD_SIZE_8BIT,
+                                    job->data, job->size);
+    }
+    return HAL_I2C_Mem_Write_DMA(bus->hi2c, job->dev_address, job->mem_address, I2C_MEMADD_SIZE_8BIT,
+                                 job->data, job->size);
+}
+
+// Removes the job in flight, starts the next one and wakes the owner of the removed job.
+// Called from the completion interrupts or with interrupts disabled.
+static void I2CBus_Retire(I2CBus *bus, HAL_StatusTypeDef status) {
+    while (bus->head != NULL) {
+        I2CBus_Job *job = bus->head;
+        bus->head = job->next;
+        if (bus->head == NULL) {
+            bus->tail = NULL;
+        }
+        bus->pending--;
+        if (status != HAL_OK) {
+            bus->stats.errors++;
+        }
+
+        // keep the bus busy before waking anybody up
+        const HAL_StatusTypeDef next_status = (bus->head != NULL) ? I2CBus_Start(bus, bus->head) : HAL_OK;
+
+        const osThreadId_t owner = job->owner;
+        job->status = status;
+        job->done = true;   // the job may go out of scope from here on
+        if (owner != NULL) {
+            osThreadFlagsSet(owner, I2C_BUS_THREAD_FLAG);
+        }
+
+        if (next_status == HAL_OK) {
+            return;
+        }
+        status = next_status;
+    }
+}
+
+static HAL_StatusTypeDef I2CBus_Transfer(I2C_HandleTypeDef *hi2c, I2CBus_Job *job) {
+    I2CBus *bus = I2CBus_Find(hi2c);
+    assert(bus != NULL);
+    job->owner = (osKernelGetState() == osKernelRunning) ? osThreadGetId() : NULL;
+
+    __disable_irq();
+    if (bus->tail != NULL) {
+        bus->tail->next = job;
+    } else {
+        bus->head = job;
+    }
+    bus->tail = job;
+    bus->pending++;
+    bus->stats.transactions++;
+    if (bus->pending > bus->stats.max_pending) {
+        bus->stats.max_pending = bus->pending;
+    }
+    if (bus->head == job) {
+        const HAL_StatusTypeDef status = I2CBus_Start(bus, job);
+        if (status != HAL_OK) {
+            I2CBus_Retire(bus, status);
+        }
+    }
+    __enable_irq();
+
+    if (job->owner != NULL) {
+        while (!job->done) {
+            osThreadFlagsWait(I2C_BUS_THREAD_FLAG, osFlagsWaitAny, osWaitForever);
+        }
+    } else {
+        while (!job->done) {
+            // no scheduler to sleep on yet
+        }
+    }
+    return job->status;
+}
+
+HAL_StatusTypeDef I2CBus_MemWrite(I2C_HandleTypeDef *hi2c, uint16_t dev_address, uint16_t mem_address,
+                                  const uint8_t *data, uint16_t size) {
+    I2CBus_Job job = {
+            .dev_address = dev_address,
+            .mem_address = mem_address,
+            .data = (uint8_t *) data,
+            .size = size,
+            .read = false,
+    };
+    return I2CBus_Transfer(hi2c, &job);
+}
+
+HAL_StatusTypeDef I2CBus_MemRead(I2C_HandleTypeDef *hi2c, uint16_t dev_address, uint16_t mem_address,
+                                 uint8_t *data, uint16_t size) {
+    I2CBus_Job job = {
+            .dev_address = dev_address,
+            .mem_address = mem_address,
+            .data = data,
+            .size = size,
+            .read = true,
+    };
+    return I2CBus_Transfer(hi2c, &job);
+}
+
+I2CBus_Stats I2CBus_GetStats(I2C_HandleTypeDef *hi2c) {
+    const I2CBus *bus = I2CBus_Find(hi2c);
+    assert(bus != NULL);
+    return bus->stats;
+}
+
+// Override the weak HAL completion callbacks
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    I2CBus *bus = I2CBus_Find(hi2c);
+    if (bus != NULL) {
+        I2CBus_Retire(bus, HAL_OK);
+    }
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    I2CBus *bus = I2CBus_Find(hi2c);
+    if (bus != NULL) {
+        I2CBus_Retire(bus, HAL_OK);
+    }
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+    I2CBus *bus = I2CBus_Find(hi2c);
+    if (bus != NULL) {
+        I2CBus_Retire(bus, HAL_ERROR);
+    }
+}
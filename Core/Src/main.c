@@ -27,6 +27,9 @@
 #include "display.h"
 #include "hcsr04.h"
 #include "af_motor_shield.h"
+#include "wheel_control.h"
+#include "motion.h"
+#include "app.h"
 #include <assert.h>
 /* USER CODE END Includes */
 
@@ -47,7 +50,12 @@
 
 /* Private variables ---------------------------------------------------------*/
 I2C_HandleTypeDef hi2c1;
+DMA_HandleTypeDef hdma_i2c1_rx;
+DMA_HandleTypeDef hdma_i2c1_tx;
 
+TIM_HandleTypeDef htim2;
+TIM_HandleTypeDef htim4;
+TIM_HandleTypeDef htim6;
 TIM_HandleTypeDef htim8;
 TIM_HandleTypeDef htim15;
 TIM_HandleTypeDef htim16;
@@ -68,6 +76,13 @@ const osThreadAttr_t i2cBusUsersTask_attributes = {
         .stack_size = 512 * 4,
         .priority = (osPriority_t) osPriorityNormal,
 };
+/* Definitions for motionTask */
+osThreadId_t motionTaskHandle;
+const osThreadAttr_t motionTask_attributes = {
+        .name = "motionTask",
+        .stack_size = 256 * 4,
+        .priority = (osPriority_t) osPriorityHigh,
+};
 /* USER CODE BEGIN PV */
 
 /* USER CODE END PV */
@@ -77,6 +92,8 @@ void SystemClock_Config(void);
 
 static void MX_GPIO_Init(void);
 
+static void MX_DMA_Init(void);
+
 static void MX_USART2_UART_Init(void);
 
 static void MX_I2C1_Init(void);
@@ -87,10 +104,18 @@ static void MX_TIM8_Init(void);
 
 static void MX_TIM16_Init(void);
 
+static void MX_TIM2_Init(void);
+
+static void MX_TIM4_Init(void);
+
+static void MX_TIM6_Init(void);
+
 void StartBlinkLed(void *argument);
 
 void Starti2cUsersTask(void *argument);
 
+void StartMotionTask(void *argument);
+
 /* USER CODE BEGIN PFP */
 
 /* USER CODE END PFP */
@@ -127,29 +152,40 @@ int main(void) {
 
     /* Initialize all configured peripherals */
     MX_GPIO_Init();
+    MX_DMA_Init();
     MX_USART2_UART_Init();
     MX_I2C1_Init();
     MX_TIM15_Init();
     MX_TIM8_Init();
     MX_TIM16_Init();
+    MX_TIM2_Init();
+    MX_TIM4_Init();
+    MX_TIM6_Init();
     /* USER CODE BEGIN 2 */
-    HAL_TIM_IC_Start_IT(&htim15, TIM_CHANNEL_1);
-    HAL_TIM_PWM_Start(&htim8, TIM_CHANNEL_1);
-    HAL_TIM_PWM_Start(&htim8, TIM_CHANNEL_2);
+    // the motors are on the complementary outputs CH1N and CH2N
+    HAL_TIMEx_PWMN_Start(&htim8, TIM_CHANNEL_1);
+    HAL_TIMEx_PWMN_Start(&htim8, TIM_CHANNEL_2);
 
-    AFMotorShield *motor3 = AFMotorShield_InitDCMotor(MOTOR_3, 100, (AFMotorShieldPeripheral) {
+    AFMotorShield *motor3 = AFMotorShield_InitDCMotor(MOTOR_3, 4, (AFMotorShieldPeripheral) {
             .htim = &htim8,
             .channel = TIM_CHANNEL_1
     });
-    // Uncomment to run the motor
-    AFMotorShield_RunDCMotor(motor3, FORWARD);
-    AFMotorShield *motor4 = AFMotorShield_InitDCMotor(MOTOR_4, 100, (AFMotorShieldPeripheral) {
+    AFMotorShield *motor4 = AFMotorShield_InitDCMotor(MOTOR_4, 4, (AFMotorShieldPeripheral) {
             .htim = &htim8,
             .channel = TIM_CHANNEL_2
     });
-    // Uncomment to run the motor
-    AFMotorShield_RunDCMotor(motor4, FORWARD);
-    AFMotorShield_RunDCMotor(motor3, FORWARD);
+    // the loop measures the wheel speeds from now on, and drives a wheel once the motion task gives it a speed
+    WheelControl *const wheels[] = {
+            WheelControl_Init((WheelControlPeripheral) {
+                    .encoder_htim = &htim2,
+                    .motor = motor3
+            }, WHEEL_CONTROL_GEAR_MOTOR_GAINS),
+            WheelControl_Init((WheelControlPeripheral) {
+                    .encoder_htim = &htim4,
+                    .motor = motor4
+            }, WHEEL_CONTROL_GEAR_MOTOR_GAINS),
+    };
+    WheelControl_Start(&htim6);
     /* USER CODE END 2 */
 
     /* Init scheduler */
@@ -169,6 +205,7 @@ int main(void) {
 
     /* USER CODE BEGIN RTOS_QUEUES */
     /* add queues, ... */
+    Motion_Init(wheels, sizeof wheels / sizeof wheels[0]);
     /* USER CODE END RTOS_QUEUES */
 
     /* Create the thread(s) */
@@ -178,8 +215,13 @@ int main(void) {
     /* creation of i2cBusUsersTask */
     i2cBusUsersTaskHandle = osThreadNew(Starti2cUsersTask, NULL, &i2cBusUsersTask_attributes);
 
+    /* creation of motionTask */
+    motionTaskHandle = osThreadNew(StartMotionTask, NULL, &motionTask_attributes);
+
     /* USER CODE BEGIN RTOS_THREADS */
     /* add threads, ... */
+    // configTOTAL_HEAP_SIZE has to hold the stacks and control blocks of all of them
+    assert(blinkLedHandle != NULL && i2cBusUsersTaskHandle != NULL && motionTaskHandle != NULL);
     /* USER CODE END RTOS_THREADS */
 
     /* USER CODE BEGIN RTOS_EVENTS */
@@ -293,6 +335,133 @@ static void MX_I2C1_Init(void) {
 
 }
 
+/**
+  * @brief TIM2 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM2_Init(void) {
+
+    /* USER CODE BEGIN TIM2_Init 0 */
+
+    /* USER CODE END TIM2_Init 0 */
+
+    TIM_Encoder_InitTypeDef sConfig = {0};
+    TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+    /* USER CODE BEGIN TIM2_Init 1 */
+
+    /* USER CODE END TIM2_Init 1 */
+    htim2.Instance = TIM2;
+    htim2.Init.Prescaler = 0;
+    htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim2.Init.Period = 4294967295;
+    htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    sConfig.EncoderMode = TIM_ENCODERMODE_TI12;
+    sConfig.IC1Polarity = TIM_ICPOLARITY_RISING;
+    sConfig.IC1Selection = TIM_ICSELECTION_DIRECTTI;
+    sConfig.IC1Prescaler = TIM_ICPSC_DIV1;
+    sConfig.IC1Filter = 4;
+    sConfig.IC2Polarity = TIM_ICPOLARITY_RISING;
+    sConfig.IC2Selection = TIM_ICSELECTION_DIRECTTI;
+    sConfig.IC2Prescaler = TIM_ICPSC_DIV1;
+    sConfig.IC2Filter = 4;
+    if (HAL_TIM_Encoder_Init(&htim2, &sConfig) != HAL_OK) {
+        Error_Handler();
+    }
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if (HAL_TIMEx_MasterConfigSynchronization(&htim2, &sMasterConfig) != HAL_OK) {
+        Error_Handler();
+    }
+    /* USER CODE BEGIN TIM2_Init 2 */
+
+    /* USER CODE END TIM2_Init 2 */
+
+}
+
+/**
+  * @brief TIM4 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM4_Init(void) {
+
+    /* USER CODE BEGIN TIM4_Init 0 */
+
+    /* USER CODE END TIM4_Init 0 */
+
+    TIM_Encoder_InitTypeDef sConfig = {0};
+    TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+    /* USER CODE BEGIN TIM4_Init 1 */
+
+    /* USER CODE END TIM4_Init 1 */
+    htim4.Instance = TIM4;
+    htim4.Init.Prescaler = 0;
+    htim4.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim4.Init.Period = 65535;
+    htim4.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim4.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    sConfig.EncoderMode = TIM_ENCODERMODE_TI12;
+    sConfig.IC1Polarity = TIM_ICPOLARITY_RISING;
+    sConfig.IC1Selection = TIM_ICSELECTION_DIRECTTI;
+    sConfig.IC1Prescaler = TIM_ICPSC_DIV1;
+    sConfig.IC1Filter = 4;
+    sConfig.IC2Polarity = TIM_ICPOLARITY_RISING;
+    sConfig.IC2Selection = TIM_ICSELECTION_DIRECTTI;
+    sConfig.IC2Prescaler = TIM_ICPSC_DIV1;
+    sConfig.IC2Filter = 4;
+    if (HAL_TIM_Encoder_Init(&htim4, &sConfig) != HAL_OK) {
+        Error_Handler();
+    }
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if (HAL_TIMEx_MasterConfigSynchronization(&htim4, &sMasterConfig) != HAL_OK) {
+        Error_Handler();
+    }
+    /* USER CODE BEGIN TIM4_Init 2 */
+
+    /* USER CODE END TIM4_Init 2 */
+
+}
+
+/**
+  * @brief TIM6 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM6_Init(void) {
+
+    /* USER CODE BEGIN TIM6_Init 0 */
+
+    /* USER CODE END TIM6_Init 0 */
+
+    TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+    /* USER CODE BEGIN TIM6_Init 1 */
+
+    /* USER CODE END TIM6_Init 1 */
+    htim6.Instance = TIM6;
+    htim6.Init.Prescaler = 72 - 1;
+    htim6.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim6.Init.Period = 1000 - 1;
+    htim6.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_Base_Init(&htim6) != HAL_OK) {
+        Error_Handler();
+    }
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if (HAL_TIMEx_MasterConfigSynchronization(&htim6, &sMasterConfig) != HAL_OK) {
+        Error_Handler();
+    }
+    /* USER CODE BEGIN TIM6_Init 2 */
+
+    /* USER CODE END TIM6_Init 2 */
+
+}
+
 /**
   * @brief TIM8 Initialization Function
   * @param None
@@ -380,7 +549,7 @@ static void MX_TIM15_Init(void) {
 
     /* USER CODE END TIM15_Init 1 */
     htim15.Instance = TIM15;
-    htim15.Init.Prescaler = 72 - 1;
+    htim15.Init.Prescaler = 8 - 1;
     htim15.Init.CounterMode = TIM_COUNTERMODE_UP;
     htim15.Init.Period = 65535;
     htim15.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
@@ -425,9 +594,9 @@ static void MX_TIM16_Init(void) {
 
     /* USER CODE END TIM16_Init 1 */
     htim16.Instance = TIM16;
-    htim16.Init.Prescaler = 0;
+    htim16.Init.Prescaler = 72 - 1;
     htim16.Init.CounterMode = TIM_COUNTERMODE_UP;
-    htim16.Init.Period = 65535;
+    htim16.Init.Period = 11;
     htim16.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
     htim16.Init.RepetitionCounter = 0;
     htim16.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
@@ -437,8 +606,11 @@ static void MX_TIM16_Init(void) {
     if (HAL_TIM_PWM_Init(&htim16) != HAL_OK) {
         Error_Handler();
     }
-    sConfigOC.OCMode = TIM_OCMODE_PWM1;
-    sConfigOC.Pulse = 0;
+    if (HAL_TIM_OnePulse_Init(&htim16, TIM_OPMODE_SINGLE) != HAL_OK) {
+        Error_Handler();
+    }
+    sConfigOC.OCMode = TIM_OCMODE_PWM2;
+    sConfigOC.Pulse = 1;
     sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
     sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
     sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
@@ -498,6 +670,24 @@ static void MX_USART2_UART_Init(void) {
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void) {
+
+    /* DMA controller clock enable */
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    /* DMA interrupt init */
+    /* DMA1_Channel6_IRQn interrupt configuration */
+    HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+    /* DMA1_Channel7_IRQn interrupt configuration */
+    HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -518,7 +708,7 @@ static void MX_GPIO_Init(void) {
     HAL_GPIO_WritePin(GPIOA, LD2_Pin | MOTORLATCH_Pin | MOTORENABLE_Pin | MOTORDATA_Pin, GPIO_PIN_RESET);
 
     /*Configure GPIO pin Output Level */
-    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_15 | MOTORCLK_Pin, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(MOTORCLK_GPIO_Port, MOTORCLK_Pin, GPIO_PIN_RESET);
 
     /*Configure GPIO pin : B1_Pin */
     GPIO_InitStruct.Pin = B1_Pin;
@@ -526,19 +716,26 @@ static void MX_GPIO_Init(void) {
     GPIO_InitStruct.Pull = GPIO_NOPULL;
     HAL_GPIO_Init(B1_GPIO_Port, &GPIO_InitStruct);
 
-    /*Configure GPIO pins : LD2_Pin MOTORLATCH_Pin MOTORENABLE_Pin MOTORDATA_Pin */
-    GPIO_InitStruct.Pin = LD2_Pin | MOTORLATCH_Pin | MOTORENABLE_Pin | MOTORDATA_Pin;
+    /*Configure GPIO pins : LD2_Pin MOTORENABLE_Pin */
+    GPIO_InitStruct.Pin = LD2_Pin | MOTORENABLE_Pin;
     GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
     GPIO_InitStruct.Pull = GPIO_NOPULL;
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
-    /*Configure GPIO pins : PB15 MOTORCLK_Pin */
-    GPIO_InitStruct.Pin = GPIO_PIN_15 | MOTORCLK_Pin;
+    /*Configure GPIO pins : MOTORLATCH_Pin MOTORDATA_Pin */
+    GPIO_InitStruct.Pin = MOTORLATCH_Pin | MOTORDATA_Pin;
     GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
     GPIO_InitStruct.Pull = GPIO_NOPULL;
-    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+    /*Configure GPIO pin : MOTORCLK_Pin */
+    GPIO_InitStruct.Pin = MOTORCLK_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(MOTORCLK_GPIO_Port, &GPIO_InitStruct);
 
 /* USER CODE BEGIN MX_GPIO_Init_2 */
 /* USER CODE END MX_GPIO_Init_2 */
@@ -558,20 +755,11 @@ _Noreturn
 /* USER CODE END Header_StartBlinkLed */
 void StartBlinkLed(void *argument) {
     /* USER CODE BEGIN 5 */
-    /* Infinite loop */
-    while (1) {
-        HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin);
-        osDelay(500);
-    }
-    assert(false);
+    App_RunBlinkLed();
     /* USER CODE END 5 */
 }
 
 /* USER CODE BEGIN Header_Starti2cUsersTask */
-static float to_cm(float meters) {
-    return meters * 100.0f;
-}
-
 /**
 * @brief Function implementing the i2cBusUsersTask thread.
 * @param argument: Not used
@@ -581,31 +769,24 @@ _Noreturn
 /* USER CODE END Header_Starti2cUsersTask */
 void Starti2cUsersTask(void *argument) {
     /* USER CODE BEGIN Starti2cUsersTask */
-    Console_Init(&huart2);
-    BME280_Init(OSRS_16, OSRS_16, OSRS_16, MODE_NORMAL, T_SB_0p5, IIR_16);
-    if (BME280_IsInitialized()) {
-        BME280_Measure();
-    }
-    Display_Init(&hi2c1);
-    HCSR04_Init(GPIOB, GPIO_PIN_15, GPIO_PIN_14, &htim15, BME280_GetHumidity, BME280_GetTemperature);
-
-    float distance_m = HCSR04_MeasureDistanceInMeters();
-    static HCSR04_Execution_State_t state = HCSR04_BEGIN;
-    while (true) {
-        state = HCSR04_MeasureDistanceInMetersNonBlocking(&distance_m, state);
-        if (state == HCSR04_DONE) {
-            if (BME280_IsInitialized()) {
-                BME280_Measure();
-            }
-            if (Display_IsInitialized()) {
-                Display_Print("Temp:%.2f Dist:%.2fcm", BME280_GetTemperature(),
-                              HCSR04_IsValidDistance(distance_m) ? to_cm(distance_m) : 0.0f);
-            }
-        }
-    }
+    App_RunI2cUsers();
     /* USER CODE END Starti2cUsersTask */
 }
 
+/* USER CODE BEGIN Header_StartMotionTask */
+/**
+* @brief Function implementing the motionTask thread.
+* @param argument: Not used
+* @retval None
+*/
+_Noreturn
+/* USER CODE END Header_StartMotionTask */
+void StartMotionTask(void *argument) {
+    /* USER CODE BEGIN StartMotionTask */
+    App_RunMotion();
+    /* USER CODE END StartMotionTask */
+}
+
 /**
   * @brief  Period elapsed callback in non blocking mode
   * @note   This function is called  when TIM3 interrupt took place, inside
@@ -622,6 +803,9 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
         HAL_IncTick();
     }
     /* USER CODE BEGIN Callback 1 */
+    HCSR04_PeriodElapsedCallback(htim);
+    AFMotorShield_PeriodElapsedCallback(htim);
+    WheelControl_PeriodElapsedCallback(htim);
 
     /* USER CODE END Callback 1 */
 }
@@ -0,0 +1,122 @@
+#include "motion.h"
+#include "cmsis_os2.h"
+#include <assert.h>
+
+#define MOTION_RAMP_TICKS (MOTION_MAX_RAMP_MS / MOTION_TICK_MS)
+
+static osMessageQueueId_t queue;
+static WheelControl *wheels[MOTION_MAX_WHEELS];
+static size_t wheel_count;
+static Motion_Stats stats;
+
+// Setpoints of the ramp of the segment in progress, one row per tick; written and read by the motion task only
+static int32_t profile[MOTION_RAMP_TICKS][MOTION_MAX_WHEELS];
+static uint32_t profile_ticks;
+// where the segment in progress ends
+static int32_t speeds[MOTION_MAX_WHEELS];
+
+void Motion_Init(WheelControl *const motion_wheels[], size_t count) {
+    assert(queue == NULL);
+    assert(count > 0 && count <= MOTION_MAX_WHEELS);
+    static const osMessageQueueAttr_t attributes = {.name = "motionQueue"};
+    queue = osMessageQueueNew(MOTION_QUEUE_LENGTH, sizeof(MotionSegment), &attributes);
+    assert(queue != NULL);
+    for (size_t i = 0; i < count; i++) {
+        wheels[i] = motion_wheels[i];
+        speeds[i] = 0;
+    }
+    wheel_count = count;
+}
+
+bool Motion_Enqueue(const MotionSegment *segment) {
+    assert(queue != NULL);
+    assert(segment->ramp_ms <= MOTION_MAX_RAMP_MS);
+    assert(segment->duration_ms > 0 && segment->duration_ms >= segment->ramp_ms);
+    if (osMessageQueuePut(queue, segment, 0U, 0U) == osOK) {
+        return true;
+    }
+    __disable_irq();
+    stats.rejected++;
+    __enable_irq();
+    return false;
+}
+
+Motion_Stats Motion_GetStats(void) {
+    __disable_irq();
+    const Motion_Stats copy = stats;
+    __enable_irq();
+    return copy;
+}
+
+// Lays out the ramp from the speeds the last segment ended at; a ramp shorter than a tick is a step
+static void Motion_Plan(const MotionSegment *segment) {
+    profile_ticks = (segment->ramp_ms >= MOTION_TICK_MS) ? segment->ramp_ms / MOTION_TICK_MS : 1U;
+    for (size_t w = 0; w < wheel_count; w++) {
+        const int64_t delta = (int64_t) segment->speeds[w] - speeds[w];
+        for (uint32_t i = 0; i < profile_ticks; i++) {
+            profile[i][w] = speeds[w] + (int32_t) (delta * (int64_t) (i + 1U) / (int64_t) profile_ticks);
+        }
+        speeds[w] = segment->speeds[w];
+    }
+}
+
+// The wheels that change direction in the same tick share one transfer of the latch
+static void Motion_Apply(const int32_t setpoints[MOTION_MAX_WHEELS]) {
+    WheelControl_SetSpeeds(wheels, setpoints, wheel_count);
+}
+
+// Sleeps until the kernel tick count reaches `until` and keeps track of how late it woke up
+static void Motion_SleepUntil(uint32_t until) {
+    /* osDelayUntil() hands the ticks left straight to vTaskDelayUntil(), which asserts on 0 and sleeps for
+     * some 49 days on a deadline already passed; those return at once here
+     */
+    const int32_t remaining = (int32_t) (until - osKernelGetTickCount());
+    if (remaining > 0) {
+        osDelay((uint32_t) remaining);
+    }
+    const uint32_t late_ms = (osKernelGetTickCount() - until) * 1000U / osKernelGetTickFreq();
+    __disable_irq();
+    if (late_ms > stats.max_late_ms) {
+        stats.max_late_ms = late_ms;
+    }
+    __enable_irq();
+}
+
+static uint32_t Motion_MsToTicks(uint32_t ms) {
+    return ms * osKernelGetTickFreq() / 1000U;
+}
+
+_Noreturn void Motion_Run(void) {
+    assert(queue != NULL);
+    MotionSegment segment;
+    uint32_t start = 0;
+    bool moving = false;
+    while (true) {
+        // the next segment starts where the last one ended, unless the wheels had to stop in between
+        if (osMessageQueueGet(queue, &segment, NULL, 0U) != osOK) {
+            if (moving) {
+                static const int32_t stop[MOTION_MAX_WHEELS] = {0};
+                Motion_Apply(stop);
+                for (size_t w = 0; w < wheel_count; w++) {
+                    speeds[w] = 0;
+                }
+                moving = false;
+            }
+            const osStatus_t status = osMessageQueueGet(queue, &segment, NULL, osWaitForever);
+            assert(status == osOK);
+            start = osKernelGetTickCount();
+        }
+        Motion_Plan(&segment);
+        moving = true;
+
+        for (uint32_t i = 0; i < profile_ticks; i++) {
+            Motion_SleepUntil(start + Motion_MsToTicks(i * MOTION_TICK_MS));
+            Motion_Apply(profile[i]);
+        }
+        start += Motion_MsToTicks(segment.duration_ms);
+        Motion_SleepUntil(start);
+        __disable_irq();
+        stats.segments++;
+        __enable_irq();
+    }
+}
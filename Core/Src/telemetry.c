@@ -0,0 +1,224 @@
+#include "telemetry.h"
+#include "stm32f3xx_hal.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+typedef struct Telemetry {
+    Telemetry_Write_t write;
+    uint16_t seq;
+    bool initialized;
+} Telemetry;
+
+static Telemetry self = {.initialized = false};
+
+// CRC-16/CCITT-FALSE, a nibble at a time
+static const uint16_t crc16_table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t Telemetry_Crc16(const uint8_t *data, size_t size) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc = (uint16_t) (crc << 4) ^ crc16_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (uint16_t) (crc << 4) ^ crc16_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t) value;
+    p[1] = (uint8_t) (value >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t value) {
+    p = put_u16(p, (uint16_t) value);
+    return put_u16(p, (uint16_t) (value >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | ((uint32_t) get_u16(p + 2) << 16);
+}
+
+static uint8_t Telemetry_PayloadSize(uint8_t type) {
+    switch (type) {
+        case TELEMETRY_ENVIRONMENT:
+            return 8;
+        case TELEMETRY_DISTANCE:
+            return 2;
+        case TELEMETRY_MOTOR:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+size_t Telemetry_Encode(uint8_t frame[TELEMETRY_MAX_FRAME_SIZE], const Telemetry_Sample *sample) {
+    const uint8_t length = Telemetry_PayloadSize(sample->type);
+    if (length == 0) {
+        return 0;
+    }
+    uint8_t *p = frame;
+    *p++ = TELEMETRY_SYNC_0;
+    *p++ = TELEMETRY_SYNC_1;
+    *p++ = (uint8_t) sample->type;
+    *p++ = length;
+    p = put_u16(p, sample->seq);
+    p = put_u32(p, sample->timestamp_ms);
+    switch (sample->type) {
+        case TELEMETRY_ENVIRONMENT:
+            p = put_u16(p, (uint16_t) sample->environment.temperature_centi_c);
+            p = put_u16(p, sample->environment.humidity_centi_pct);
+            p = put_u32(p, sample->environment.pressure_deci_pa);
+            break;
+        case TELEMETRY_DISTANCE:
+            p = put_u16(p, sample->distance.distance_mm);
+            break;
+        case TELEMETRY_MOTOR:
+            *p++ = sample->motor.motor;
+            *p++ = sample->motor.command;
+            *p++ = sample->motor.speed;
+            break;
+    }
+    // the CRC covers everything after the sync bytes
+    p = put_u16(p, Telemetry_Crc16(&frame[2], (size_t) (p - &frame[2])));
+    return (size_t) (p - frame);
+}
+
+// Drops the first n received bytes and looks for the next sync pattern in the rest
+static void Telemetry_Resync(Telemetry_Parser *parser, size_t n) {
+    size_t start = n;
+    while (start < parser->received && parser->frame[start] != TELEMETRY_SYNC_0) {
+        start++;
+    }
+    memmove(parser->frame, &parser->frame[start], parser->received - start);
+    parser->received -= start;
+}
+
+static void Telemetry_DecodeFrame(const uint8_t *frame, Telemetry_Sample *sample) {
+    const uint8_t *p = &frame[TELEMETRY_HEADER_SIZE];
+    sample->type = (Telemetry_Type_t) frame[2];
+    sample->seq = get_u16(&frame[4]);
+    sample->timestamp_ms = get_u32(&frame[6]);
+    switch (sample->type) {
+        case TELEMETRY_ENVIRONMENT:
+            sample->environment.temperature_centi_c = (int16_t) get_u16(p);
+            sample->environment.humidity_centi_pct = get_u16(p + 2);
+            sample->environment.pressure_deci_pa = get_u32(p + 4);
+            break;
+        case TELEMETRY_DISTANCE:
+            sample->distance.distance_mm = get_u16(p);
+            break;
+        case TELEMETRY_MOTOR:
+            sample->motor.motor = p[0];
+            sample->motor.command = p[1];
+            sample->motor.speed = p[2];
+            break;
+    }
+}
+
+bool Telemetry_Parse(Telemetry_Parser *parser, uint8_t byte, Telemetry_Sample *sample) {
+    parser->frame[parser->received++] = byte;
+    while (parser->received > 0) {
+        if (parser->frame[0] != TELEMETRY_SYNC_0 ||
+            (parser->received >= 2 && parser->frame[1] != TELEMETRY_SYNC_1)) {
+            Telemetry_Resync(parser, 1);
+            continue;
+        }
+        if (parser->received < 4) {
+            return false;
+        }
+        const uint8_t length = Telemetry_PayloadSize(parser->frame[2]);
+        if (length == 0 || length != parser->frame[3]) {
+            Telemetry_Resync(parser, 1);
+            continue;
+        }
+        const size_t size = TELEMETRY_HEADER_SIZE + length + TELEMETRY_CRC_SIZE;
+        if (parser->received < size) {
+            return false;
+        }
+        if (Telemetry_Crc16(&parser->frame[2], size - 2 - TELEMETRY_CRC_SIZE) != get_u16(&parser->frame[size - 2])) {
+            parser->crc_errors++;
+            Telemetry_Resync(parser, 1);
+            continue;
+        }
+
+        Telemetry_DecodeFrame(parser->frame, sample);
+        if (parser->synchronized) {
+            parser->lost_frames += (uint16_t) (sample->seq - parser->next_seq);
+        }
+        parser->next_seq = sample->seq + 1;
+        parser->synchronized = true;
+        parser->frames++;
+        Telemetry_Resync(parser, size);
+        return true;
+    }
+    return false;
+}
+
+void Telemetry_Init(Telemetry_Write_t write) {
+    assert(!self.initialized);
+    assert(write != NULL);
+    self.write = write;
+    self.seq = 0;
+    self.initialized = true;
+}
+
+static void Telemetry_SendAt(uint32_t timestamp_ms, Telemetry_Sample *sample) {
+    assert(self.initialized);
+    sample->seq = __atomic_fetch_add(&self.seq, 1, __ATOMIC_RELAXED);
+    sample->timestamp_ms = timestamp_ms;
+    uint8_t frame[TELEMETRY_MAX_FRAME_SIZE];
+    const size_t size = Telemetry_Encode(frame, sample);
+    self.write(frame, size);
+}
+
+// Rounds to the nearest step and saturates to the range of the field
+static int32_t to_fixed(float value, float steps_per_unit, int32_t min, int32_t max) {
+    const float scaled = roundf(value * steps_per_unit);
+    if (scaled <= (float) min) {
+        return min;
+    }
+    if (scaled >= (float) max) {
+        return max;
+    }
+    return (int32_t) scaled;
+}
+
+void Telemetry_SendEnvironment(float temperature_c, float pressure_pa, float humidity_pct) {
+    Telemetry_Sample sample = {.type = TELEMETRY_ENVIRONMENT};
+    sample.environment.temperature_centi_c = (int16_t) to_fixed(temperature_c, 100.0f, INT16_MIN, INT16_MAX);
+    sample.environment.humidity_centi_pct = (uint16_t) to_fixed(humidity_pct, 100.0f, 0, 10000);
+    sample.environment.pressure_deci_pa = (uint32_t) to_fixed(pressure_pa, 10.0f, 0, INT32_MAX);
+    Telemetry_SendAt(HAL_GetTick(), &sample);
+}
+
+void Telemetry_SendDistance(float distance_m, bool valid) {
+    Telemetry_SendDistanceAt(HAL_GetTick(), (uint16_t) to_fixed(distance_m, 1000.0f, 0, TELEMETRY_DISTANCE_INVALID - 1),
+                             valid);
+}
+
+void Telemetry_SendDistanceAt(uint32_t timestamp_ms, uint16_t distance_mm, bool valid) {
+    Telemetry_Sample sample = {.type = TELEMETRY_DISTANCE};
+    if (!valid) {
+        sample.distance.distance_mm = TELEMETRY_DISTANCE_INVALID;
+    } else {
+        sample.distance.distance_mm = (distance_mm < TELEMETRY_DISTANCE_INVALID) ? distance_mm
+                                                                                : TELEMETRY_DISTANCE_INVALID - 1;
+    }
+    Telemetry_SendAt(timestamp_ms, &sample);
+}
+
+void Telemetry_SendMotor(uint8_t motor, uint8_t command, uint8_t speed) {
+    Telemetry_Sample sample = {.type = TELEMETRY_MOTOR};
+    sample.motor.motor = motor;
+    sample.motor.command = command;
+    sample.motor.speed = speed;
+    Telemetry_SendAt(HAL_GetTick(), &sample);
+}
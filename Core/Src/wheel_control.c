@@ -0,0 +1,161 @@
+#include "wheel_control.h"
+#include <assert.h>
+#include <stddef.h>
+
+_Static_assert((WHEEL_CONTROL_SPEED_PERIODS & (WHEEL_CONTROL_SPEED_PERIODS - 1)) == 0,
+               "WHEEL_CONTROL_SPEED_PERIODS must be a power of two");
+
+struct WheelControl {
+    WheelControlPeripheral peripheral;
+    WheelControlGains gains;
+    uint32_t count;         // encoder counter at the last control period
+    // encoder counts of the last control periods and their sum
+    int32_t deltas[WHEEL_CONTROL_SPEED_PERIODS];
+    int32_t counts;
+    uint32_t delta_index;
+    volatile int32_t speed;
+    // written in task context, read by the loop
+    volatile int32_t setpoint;
+    volatile bool driving;
+    int64_t integral_q16;
+    int32_t last_measured;
+    bool initialized;
+};
+
+static WheelControl wheels[WHEEL_CONTROL_MAX_WHEELS];
+
+static TIM_HandleTypeDef *loop_htim;
+
+WheelControl *WheelControl_Init(WheelControlPeripheral peripheral, WheelControlGains gains) {
+    WheelControl *self = NULL;
+    for (size_t i = 0; i < WHEEL_CONTROL_MAX_WHEELS && self == NULL; i++) {
+        assert(!wheels[i].initialized || (wheels[i].peripheral.encoder_htim != peripheral.encoder_htim &&
+                                          wheels[i].peripheral.motor != peripheral.motor));
+        if (!wheels[i].initialized) {
+            self = &wheels[i];
+        }
+    }
+    assert(self != NULL);
+    assert(gains.kp_q16 >= 0 && gains.ki_q16 >= 0 && gains.kd_q16 >= 0);
+
+    const HAL_StatusTypeDef status = HAL_TIM_Encoder_Start(peripheral.encoder_htim, TIM_CHANNEL_ALL);
+    assert(status == HAL_OK);
+    __disable_irq();
+    *self = (WheelControl) {
+            .peripheral = peripheral,
+            .gains = gains,
+            .count = __HAL_TIM_GET_COUNTER(peripheral.encoder_htim),
+            .initialized = true,
+    };
+    __enable_irq();
+    return self;
+}
+
+void WheelControl_Start(TIM_HandleTypeDef *htim) {
+    assert(loop_htim == NULL);
+    loop_htim = htim;
+    const HAL_StatusTypeDef status = HAL_TIM_Base_Start_IT(htim);
+    assert(status == HAL_OK);
+}
+
+void WheelControl_Stop(void) {
+    assert(loop_htim != NULL);
+    const HAL_StatusTypeDef status = HAL_TIM_Base_Stop_IT(loop_htim);
+    assert(status == HAL_OK);
+    loop_htim = NULL;
+}
+
+void WheelControl_SetSpeed(WheelControl *self, int32_t counts_per_s) {
+    WheelControl_SetSpeeds(&self, &counts_per_s, 1);
+}
+
+void WheelControl_SetSpeeds(WheelControl *const wheels[], const int32_t counts_per_s[], size_t count) {
+    AFMotorShieldCommand commands[AF_MOTOR_SHIELD_MOTORS] = {0};
+    bool turning = false;
+    for (size_t i = 0; i < count; i++) {
+        WheelControl *self = wheels[i];
+        assert(self->initialized);
+        if (self->driving && counts_per_s[i] != 0 && (counts_per_s[i] < 0) == (self->setpoint < 0)) {
+            self->setpoint = counts_per_s[i];
+            continue;
+        }
+        // the loop lets go of the motor while the latch changes the direction, and starts over from standstill
+        self->driving = false;
+        AFMotorShieldCommand *command = &commands[AFMotorShield_GetMotor(self->peripheral.motor) - 1];
+        assert(command->command == KEEP);
+        command->command = (counts_per_s[i] == 0) ? RELEASE : (counts_per_s[i] > 0) ? FORWARD : BACKWARD;
+        turning = true;
+    }
+    if (!turning) {
+        return;
+    }
+    // every motor that turns stops driving at once, at a duty cycle of 0
+    AFMotorShield_RunDCMotors(commands);
+
+    for (size_t i = 0; i < count; i++) {
+        WheelControl *self = wheels[i];
+        const DCMotorCommand command = commands[AFMotorShield_GetMotor(self->peripheral.motor) - 1].command;
+        if (command == FORWARD || command == BACKWARD) {
+            __disable_irq();
+            self->setpoint = counts_per_s[i];
+            self->integral_q16 = 0;
+            self->last_measured = (counts_per_s[i] < 0) ? -self->speed : self->speed;
+            self->driving = true;
+            __enable_irq();
+        }
+    }
+}
+
+int32_t WheelControl_GetSpeed(const WheelControl *self) {
+    return self->speed;
+}
+
+// Counts since the last period; wraps like the counter, a 32 bit one included
+static int32_t WheelControl_Delta(const WheelControl *self, uint32_t count) {
+    const uint32_t period = self->peripheral.encoder_htim->Init.Period;
+    if (period == UINT32_MAX) {
+        return (int32_t) (count - self->count);
+    }
+    const uint32_t span = period + 1U;
+    const uint32_t delta = (count + span - self->count) % span;
+    return (delta >= span / 2U) ? (int32_t) delta - (int32_t) span : (int32_t) delta;
+}
+
+static int64_t WheelControl_Clamp(int64_t value, int64_t max) {
+    return (value < 0) ? 0 : (value > max) ? max : value;
+}
+
+static void WheelControl_Update(WheelControl *self) {
+    const uint32_t count = __HAL_TIM_GET_COUNTER(self->peripheral.encoder_htim);
+    const int32_t delta = WheelControl_Delta(self, count);
+    self->count = count;
+    self->counts += delta - self->deltas[self->delta_index];
+    self->deltas[self->delta_index] = delta;
+    self->delta_index = (self->delta_index + 1U) % WHEEL_CONTROL_SPEED_PERIODS;
+    const int32_t speed = self->counts * (int32_t) (WHEEL_CONTROL_RATE_HZ / WHEEL_CONTROL_SPEED_PERIODS);
+    self->speed = speed;
+    if (!self->driving) {
+        return;
+    }
+
+    // everything in the direction of the setpoint, where the output is positive
+    const int32_t setpoint = self->setpoint;
+    const int32_t measured = (setpoint < 0) ? -speed : speed;
+    const int32_t error = ((setpoint < 0) ? -setpoint : setpoint) - measured;
+    const int64_t max_q16 = (int64_t) AFMotorShield_GetPeriodTicks(self->peripheral.motor) << 16;
+    // clamping the integral to the output range keeps it from winding up while the output saturates
+    self->integral_q16 = WheelControl_Clamp(self->integral_q16 + (int64_t) self->gains.ki_q16 * error, max_q16);
+    const int64_t output_q16 = (int64_t) self->gains.kp_q16 * error + self->integral_q16 -
+                               (int64_t) self->gains.kd_q16 * (measured - self->last_measured);
+    self->last_measured = measured;
+    AFMotorShield_SetCompare(self->peripheral.motor, (uint32_t) (WheelControl_Clamp(output_q16, max_q16) >> 16));
+}
+
+void WheelControl_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
+    if (htim != loop_htim) {
+        return;
+    }
+    for (size_t i = 0; i < WHEEL_CONTROL_MAX_WHEELS && wheels[i].initialized; i++) {
+        WheelControl_Update(&wheels[i]);
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef MY_SENSORS_HOST_BENCH_H
+#define MY_SENSORS_HOST_BENCH_H
+
+#include <stdint.h>
+
+typedef void (*HostBench_Fn_t)(void *ctx);
+
+/*
+ * Runs fn iterations times and prints one line with the host time per call, the simulation time per call
+ * (which includes the time skipped while the caller waited on a peripheral) and the bus, line and
+ * GPIO work the call caused in the peripheral models, all per call.
+ * Benchmarks whose name does not contain the filter set with HostBench_SetFilter() are skipped.
+ * Returns the host time per call in ns, 0 when skipped.
+ */
+double HostBench_Run(const char *name, HostBench_Fn_t fn, void *ctx, uint32_t iterations);
+void HostBench_SetFilter(const char *filter);
+void HostBench_PrintHeader(void);
+
+#endif //MY_SENSORS_HOST_BENCH_H
@@ -0,0 +1,36 @@
+#ifndef MY_SENSORS_HOST_BOARD_H
+#define MY_SENSORS_HOST_BOARD_H
+
+#include "host_sim.h"
+
+/*
+ * The Nucleo board as wired in main.c: BME280 and SSD1306 on hi2c1, console on huart2, HC-SR04 triggered by
+ * the one-pulse htim16 with the echo captured by htim15 channel 1, and the motor shield latch on the
+ * MOTORLATCH/MOTORCLK/MOTORDATA pins with the PWM of motors 3 and 4 on htim8. The motors turn the encoders on
+ * htim2 (motor 3) and htim4 (motor 4), and htim6 is the 1 kHz timer of the wheel control loop.
+ * The peripheral handles are defined here with the names main.c gives them.
+ */
+typedef struct HostBoard {
+    HostBME280 bme280;
+    HostSSD1306 ssd1306;
+    HostHCSR04 hcsr04;
+    HostShiftRegister latch;
+    HostDCMotor motor3;
+    HostDCMotor motor4;
+} HostBoard;
+
+extern HostBoard host_board;
+
+extern I2C_HandleTypeDef hi2c1;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim4;
+extern TIM_HandleTypeDef htim6;
+extern TIM_HandleTypeDef htim8;
+extern TIM_HandleTypeDef htim15;
+extern TIM_HandleTypeDef htim16;
+extern UART_HandleTypeDef huart2;
+
+// Configures the peripheral handles like the MX_*_Init functions in main.c and attaches the device models
+void HostBoard_Init(void);
+
+#endif //MY_SENSORS_HOST_BOARD_H
@@ -0,0 +1,23 @@
+#ifndef MY_SENSORS_HOST_RTOS_H
+#define MY_SENSORS_HOST_RTOS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Same as configTICK_RATE_HZ in Core/Inc/FreeRTOSConfig.h
+#define HOST_RTOS_TICK_RATE_HZ 1000U
+
+typedef struct HostRTOS_Config {
+    bool single_core;   // pin all threads to one CPU and map osPriority_t onto SCHED_FIFO
+} HostRTOS_Config;
+
+// Must be called before osKernelInitialize()
+void HostRTOS_Configure(const HostRTOS_Config *config);
+
+// Starts the kernel, lets the threads run for run_ms milliseconds and prints the report
+void HostRTOS_Run(uint32_t run_ms);
+
+// Prints wake-up latency and CPU share per thread and the high-water mark of every message queue
+void HostRTOS_PrintReport(void);
+
+#endif //MY_SENSORS_HOST_RTOS_H
@@ -0,0 +1,185 @@
+#ifndef MY_SENSORS_HOST_SIM_H
+#define MY_SENSORS_HOST_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "stm32f3xx_hal.h"
+
+/*
+ * Simulation clock. It follows the host monotonic clock, except that HAL_Delay()
+ * does not sleep but moves the clock forward, so initialization sequences run at native speed.
+ */
+uint64_t HostSim_Nanos(void);
+uint64_t HostSim_Micros(void);
+void HostSim_Advance(uint64_t ns);
+// Makes HAL_Delay() poll the clock like on the target instead of skipping ahead; used when RTOS threads run
+void HostSim_SetRealTimeDelays(bool real_time);
+
+/*
+ * Simulated interrupts. The handler runs on the interrupt thread once the simulation clock reaches at_ns,
+ * with interrupts masked (__disable_irq() blocks while it runs). Without real-time delays the clock
+ * jumps forward to at_ns instead of waiting.
+ */
+typedef void (*HostIRQ_Handler_t)(void *ctx);
+
+void HostIRQ_Schedule(uint64_t at_ns, HostIRQ_Handler_t handler, void *ctx);
+
+/* I2C ------------------------------------------------------------------------*/
+struct HostI2C_Device;
+typedef struct HostI2C_Device HostI2C_Device;
+
+struct HostI2C_Device {
+    void (*write)(HostI2C_Device *dev, uint16_t mem_addr, const uint8_t *data, uint16_t size);
+    void (*read)(HostI2C_Device *dev, uint16_t mem_addr, uint8_t *data, uint16_t size);
+};
+
+typedef struct HostI2C_Stats {
+    uint32_t transactions;
+    uint32_t bytes;     // bytes on the wire, including the address and register bytes
+    uint64_t bus_ns;    // time the bus would have been busy at the configured SCL frequency
+} HostI2C_Stats;
+
+void HostI2C_Attach(I2C_HandleTypeDef *hi2c, uint16_t dev_address, HostI2C_Device *dev);
+// The device no longer acknowledges its address, like a sensor that came loose
+void HostI2C_Detach(I2C_HandleTypeDef *hi2c, uint16_t dev_address);
+void HostI2C_SetClockHz(uint32_t scl_hz);
+HostI2C_Stats HostI2C_GetStats(void);
+void HostI2C_ResetStats(void);
+
+/* UART -----------------------------------------------------------------------*/
+typedef struct HostUART_Stats {
+    uint32_t transmits;
+    uint32_t bytes;
+    uint64_t line_ns;   // time the line would have been busy at the configured baud rate
+} HostUART_Stats;
+
+void HostUART_SetEcho(bool echo);
+// Appends every byte that leaves the UART to the file as well; NULL stops the capture
+void HostUART_SetCapture(FILE *capture);
+HostUART_Stats HostUART_GetStats(void);
+void HostUART_ResetStats(void);
+
+/* GPIO -----------------------------------------------------------------------*/
+typedef void (*HostGPIO_Listener_t)(void *ctx, GPIO_TypeDef *GPIOx, uint16_t pins, uint32_t old_odr, uint32_t new_odr);
+
+void HostGPIO_AddListener(HostGPIO_Listener_t listener, void *ctx);
+uint32_t HostGPIO_GetWriteCount(void);
+void HostGPIO_ResetWriteCount(void);
+
+/* TIM ------------------------------------------------------------------------*/
+/* PWM2 output compare on channel 1: every period of ARR + 1 ticks (of PSC + 1 core clocks) drives the output
+ * high at CCR1 and low again at the update event. In one-pulse mode __HAL_TIM_ENABLE() produces one period,
+ * otherwise the periods repeat until TIM_CR1_CEN is cleared. Listeners get both edges as simulation times
+ * when a period starts.
+ */
+typedef void (*HostTIM_PulseListener_t)(void *ctx, TIM_HandleTypeDef *htim, uint64_t rising_ns, uint64_t falling_ns);
+
+void HostTIM_AddPulseListener(HostTIM_PulseListener_t listener, void *ctx);
+/* Calls HAL_TIM_PeriodElapsedCallback for every overflow of the counter since the last call while TIM_IT_UPDATE
+ * is enabled. Overflows are served late, before the next capture of the timer, which is all the drivers can tell;
+ * as scheduled interrupts they would keep the simulation clock skipping ahead.
+ */
+void HostTIM_ServeOverflows(TIM_HandleTypeDef *htim);
+/* Same for the overflows up to at_ns; a capture interrupt is served before the update interrupt of an overflow
+ * that came after its edge, however late the interrupt thread gets to it
+ */
+void HostTIM_ServeOverflowsUntil(TIM_HandleTypeDef *htim, uint64_t at_ns);
+
+/* Device models --------------------------------------------------------------*/
+
+/* BME280 register file with the calibration example from the datasheet. A soft reset clears the configuration
+ * and copies the NVM for 1 ms, a forced measurement takes the typical time of the datasheet; STATUS shows both.
+ */
+typedef struct HostBME280 {
+    HostI2C_Device dev;
+    uint8_t regs[256];
+    uint32_t reads;
+    uint64_t nvm_copy_until_ns;
+    uint64_t measuring_until_ns;
+} HostBME280;
+
+void HostBME280_Init(HostBME280 *self);
+void HostBME280_SetRaw(HostBME280 *self, int32_t t_raw, int32_t p_raw, int32_t h_raw);
+
+// SSD1306 command decoder and graphics RAM
+#define HOST_SSD1306_PAGES   8
+#define HOST_SSD1306_COLUMNS 128
+
+typedef struct HostSSD1306 {
+    HostI2C_Device dev;
+    uint8_t gddram[HOST_SSD1306_PAGES * HOST_SSD1306_COLUMNS];
+    uint8_t addressing_mode;
+    uint8_t page, column;
+    uint8_t page_start, page_end;
+    uint8_t column_start, column_end;
+    uint8_t pending_cmd;
+    uint8_t pending_args;
+    uint8_t args[2];
+    bool on;
+    uint32_t data_bytes;
+    uint32_t commands;
+} HostSSD1306;
+
+void HostSSD1306_Init(HostSSD1306 *self);
+
+// HC-SR04 that answers every trigger pulse of the one-pulse timer with an echo pulse on the capture timer,
+// both edges delivered as capture interrupts; 38 ms pulse beyond 4 m like the real module.
+// Bursts sent while another module still waits for its echo are counted as crosstalk.
+typedef struct HostHCSR04 {
+    TIM_HandleTypeDef *trigger_htim;
+    TIM_HandleTypeDef *htim;
+    uint32_t channel;
+    float distance_m;
+    float speed_of_sound_ms;
+    uint64_t echo_ns;           // rising edge of the echo in progress
+    uint64_t busy_until_ns;     // and its falling edge
+    uint32_t echoes;
+    uint32_t crosstalk;
+} HostHCSR04;
+
+void HostHCSR04_Init(HostHCSR04 *self, TIM_HandleTypeDef *trigger_htim, TIM_HandleTypeDef *htim, uint32_t channel);
+
+// 74HCT595 shift register of the Adafruit motor shield
+typedef struct HostShiftRegister {
+    GPIO_TypeDef *latch_port, *clk_port, *data_port;
+    uint16_t latch_pin, clk_pin, data_pin;
+    uint8_t shift;
+    uint8_t output;
+    uint32_t latches;
+} HostShiftRegister;
+
+void HostShiftRegister_Init(HostShiftRegister *self, GPIO_TypeDef *latch_port, uint16_t latch_pin,
+                            GPIO_TypeDef *clk_port, uint16_t clk_pin, GPIO_TypeDef *data_port, uint16_t data_pin);
+
+/* Brushed gear motor on an L293D channel of the shield, with a quadrature encoder on the motor shaft. The PWM
+ * switches the enable input, so the motor sees the supply for the duty cycle and coasts for the rest of the
+ * period; the two latch bits give the direction, both low or both high let it coast or brake. The defaults are
+ * a 6 V motor of about 10000 rpm with 48 encoder counts per revolution (12 pulses of a hall sensor, both edges
+ * of both channels) and the friction of its gearbox.
+ */
+typedef struct HostDCMotor {
+    const HostShiftRegister *latch;
+    uint8_t bit_a, bit_b;
+    TIM_HandleTypeDef *pwm_htim;
+    uint32_t pwm_channel;
+    TIM_HandleTypeDef *encoder_htim;
+    double supply_v;
+    double resistance_ohm;
+    double k_v_s;               // back EMF in V s/rad, the same as the torque constant in N m/A
+    double inertia_kg_m2;
+    double viscous_n_m_s;
+    double friction_n_m;        // Coulomb friction of the gearbox
+    double load_n_m;            // external torque against the motion, e.g. a slope
+    double counts_per_rad;
+    double speed_rad_s;
+    double angle_rad;
+    uint64_t time_ns;
+} HostDCMotor;
+
+void HostDCMotor_Init(HostDCMotor *self, const HostShiftRegister *latch, uint8_t bit_a, uint8_t bit_b,
+                      TIM_HandleTypeDef *pwm_htim, uint32_t pwm_channel, TIM_HandleTypeDef *encoder_htim);
+// Integrates the motor up to the simulation clock with the current PWM and latch, and moves the encoder counter
+void HostDCMotor_Advance(HostDCMotor *self);
+
+#endif //MY_SENSORS_HOST_SIM_H
@@ -0,0 +1,266 @@
+/*
+ * Host stand-in for the STM32F3xx HAL.
+ *
+ * Only the subset of the HAL that the Core drivers use is declared here. The
+ * peripheral handles keep the field names of the real HAL so that driver code
+ * compiles unchanged; the behaviour behind them is implemented by the models in
+ * Host/Src (see host_sim.h).
+ */
+#ifndef HOST_STM32F3XX_HAL_H
+#define HOST_STM32F3XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __IO volatile
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY      0xFFFFFFFFU
+
+extern uint32_t SystemCoreClock;
+
+/* GPIO ----------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t BRR;
+} GPIO_TypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0U,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+extern GPIO_TypeDef HostGPIOA, HostGPIOB, HostGPIOC, HostGPIOF;
+#define GPIOA (&HostGPIOA)
+#define GPIOB (&HostGPIOB)
+#define GPIOC (&HostGPIOC)
+#define GPIOF (&HostGPIOF)
+
+#define GPIO_PIN_0                 ((uint16_t)0x0001U)
+#define GPIO_PIN_1                 ((uint16_t)0x0002U)
+#define GPIO_PIN_2                 ((uint16_t)0x0004U)
+#define GPIO_PIN_3                 ((uint16_t)0x0008U)
+#define GPIO_PIN_4                 ((uint16_t)0x0010U)
+#define GPIO_PIN_5                 ((uint16_t)0x0020U)
+#define GPIO_PIN_6                 ((uint16_t)0x0040U)
+#define GPIO_PIN_7                 ((uint16_t)0x0080U)
+#define GPIO_PIN_8                 ((uint16_t)0x0100U)
+#define GPIO_PIN_9                 ((uint16_t)0x0200U)
+#define GPIO_PIN_10                ((uint16_t)0x0400U)
+#define GPIO_PIN_11                ((uint16_t)0x0800U)
+#define GPIO_PIN_12                ((uint16_t)0x1000U)
+#define GPIO_PIN_13                ((uint16_t)0x2000U)
+#define GPIO_PIN_14                ((uint16_t)0x4000U)
+#define GPIO_PIN_15                ((uint16_t)0x8000U)
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+/* I2C -----------------------------------------------------------------------*/
+typedef struct {
+    uint32_t Timing;
+} I2C_InitTypeDef;
+
+typedef enum {
+    HAL_I2C_STATE_RESET = 0x00U,
+    HAL_I2C_STATE_READY = 0x20U,
+    HAL_I2C_STATE_BUSY_TX = 0x21U,
+    HAL_I2C_STATE_BUSY_RX = 0x22U,
+} HAL_I2C_StateTypeDef;
+
+#define HAL_I2C_ERROR_NONE  0x00000000U
+#define HAL_I2C_ERROR_AF    0x00000004U
+
+#define I2C_MEMADD_SIZE_8BIT  0x00000001U
+#define I2C_MEMADD_SIZE_16BIT 0x00000002U
+
+typedef struct __I2C_HandleTypeDef {
+    void *Instance;
+    I2C_InitTypeDef Init;
+    __IO HAL_I2C_StateTypeDef State;
+    __IO uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+
+extern int HostI2C1, HostI2C2;
+#define I2C1 ((void *) &HostI2C1)
+#define I2C2 ((void *) &HostI2C2)
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                    uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                   uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                        uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(const I2C_HandleTypeDef *hi2c);
+uint32_t HAL_I2C_GetError(const I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+
+/* UART ----------------------------------------------------------------------*/
+typedef struct {
+    uint32_t BaudRate;
+} UART_InitTypeDef;
+
+typedef enum {
+    HAL_UART_STATE_RESET = 0x00U,
+    HAL_UART_STATE_READY = 0x20U,
+    HAL_UART_STATE_BUSY_TX = 0x21U,
+} HAL_UART_StateTypeDef;
+
+typedef struct __UART_HandleTypeDef {
+    void *Instance;
+    UART_InitTypeDef Init;
+    __IO HAL_UART_StateTypeDef gState;
+} UART_HandleTypeDef;
+
+extern int HostUSART2;
+#define USART2 ((void *) &HostUSART2)
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_UART_StateTypeDef HAL_UART_GetState(const UART_HandleTypeDef *huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+
+/* TIM -----------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t EGR;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+    __IO uint32_t ARR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+    int64_t HOST_OFFSET;   // host only: counter value subtracted from the free-running tick count
+    bool HOST_RUNNING;     // host only: a period of the free-running output is in progress
+    uint64_t HOST_UPDATE_NS;   // host only: end of that period
+    uint64_t HOST_OVERFLOWS;   // host only: counter overflows served as update interrupts so far
+    bool HOST_ENCODER;     // host only: encoder mode, CNT is moved by a device model instead of the clock
+} TIM_TypeDef;
+
+#define TIM_CR1_CEN  0x00000001U
+#define TIM_CR1_UDIS 0x00000002U
+#define TIM_CR1_OPM  0x00000008U
+#define TIM_EGR_UG   0x00000001U
+#define TIM_IT_UPDATE   0x00000001U
+#define TIM_FLAG_UPDATE 0x00000001U
+
+#define SET_BIT(REG, BIT)     ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)   ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT)    ((REG) & (BIT))
+#define READ_REG(REG)         ((REG))
+// Stores to GPIO BSRR and BRR go through the GPIO model, any other register is plain memory
+void HostReg_Write(volatile uint32_t *reg, uint32_t value);
+#define WRITE_REG(REG, VAL)   HostReg_Write(&(REG), (VAL))
+
+extern TIM_TypeDef HostTIM1, HostTIM2, HostTIM3, HostTIM4, HostTIM6, HostTIM8, HostTIM15, HostTIM16, HostTIM17;
+#define TIM1  (&HostTIM1)
+#define TIM2  (&HostTIM2)
+#define TIM3  (&HostTIM3)
+#define TIM4  (&HostTIM4)
+#define TIM6  (&HostTIM6)
+#define TIM8  (&HostTIM8)
+#define TIM15 (&HostTIM15)
+#define TIM16 (&HostTIM16)
+#define TIM17 (&HostTIM17)
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t Period;
+} TIM_Base_InitTypeDef;
+
+typedef enum {
+    HAL_TIM_ACTIVE_CHANNEL_1 = 0x01U,
+    HAL_TIM_ACTIVE_CHANNEL_2 = 0x02U,
+    HAL_TIM_ACTIVE_CHANNEL_3 = 0x04U,
+    HAL_TIM_ACTIVE_CHANNEL_4 = 0x08U,
+    HAL_TIM_ACTIVE_CHANNEL_CLEARED = 0x00U
+} HAL_TIM_ActiveChannel;
+
+typedef struct __TIM_HandleTypeDef {
+    TIM_TypeDef *Instance;
+    TIM_Base_InitTypeDef Init;
+    HAL_TIM_ActiveChannel Channel;
+} TIM_HandleTypeDef;
+
+#define TIM_CHANNEL_1                      0x00000000U
+#define TIM_CHANNEL_2                      0x00000004U
+#define TIM_CHANNEL_3                      0x00000008U
+#define TIM_CHANNEL_4                      0x0000000CU
+#define TIM_CHANNEL_ALL                    0x0000003CU
+
+/* The counter of a host timer is derived from the host monotonic clock, so reading it has to go through a function */
+uint32_t HostTim_GetCounter(TIM_HandleTypeDef *htim);
+// What the counter showed at a simulation time, e.g. when a capture unit latched it
+uint32_t HostTim_GetCounterAt(TIM_HandleTypeDef *htim, uint64_t at_ns);
+void HostTim_SetCounter(TIM_HandleTypeDef *htim, uint32_t counter);
+
+// Starts the counter; in one-pulse mode (TIM_CR1_OPM) the timer produces one pulse and stops, otherwise a pulse
+// every period until TIM_CR1_CEN is cleared (see HostTIM_AddPulseListener())
+void HostTim_Enable(TIM_HandleTypeDef *htim);
+// Enables interrupts of the timer; the update interrupt of the counter overflows is served by
+// HostTIM_ServeOverflows() (see host_sim.h)
+void HostTim_EnableIT(TIM_HandleTypeDef *htim, uint32_t interrupt);
+
+#define __HAL_TIM_ENABLE(__HANDLE__)  HostTim_Enable(__HANDLE__)
+#define __HAL_TIM_ENABLE_IT(__HANDLE__, __INTERRUPT__)  HostTim_EnableIT((__HANDLE__), (__INTERRUPT__))
+#define __HAL_TIM_DISABLE_IT(__HANDLE__, __INTERRUPT__)  CLEAR_BIT((__HANDLE__)->Instance->DIER, (__INTERRUPT__))
+#define __HAL_TIM_GET_FLAG(__HANDLE__, __FLAG__)  (((__HANDLE__)->Instance->SR & (__FLAG__)) == (__FLAG__))
+#define __HAL_TIM_CLEAR_FLAG(__HANDLE__, __FLAG__)  ((__HANDLE__)->Instance->SR = ~(__FLAG__))
+#define __HAL_TIM_GET_COUNTER(__HANDLE__)  HostTim_GetCounter(__HANDLE__)
+#define __HAL_TIM_SET_COUNTER(__HANDLE__, __COUNTER__)  HostTim_SetCounter((__HANDLE__), (__COUNTER__))
+#define __HAL_TIM_GET_AUTORELOAD(__HANDLE__)  ((__HANDLE__)->Instance->ARR)
+#define __HAL_TIM_SET_AUTORELOAD(__HANDLE__, __AUTORELOAD__) \
+    do { (__HANDLE__)->Instance->ARR = (__AUTORELOAD__); (__HANDLE__)->Init.Period = (__AUTORELOAD__); } while (0)
+#define __HAL_TIM_SET_PRESCALER(__HANDLE__, __PRESC__)  ((__HANDLE__)->Instance->PSC = (__PRESC__))
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__) \
+    (*(&((__HANDLE__)->Instance->CCR1) + ((__CHANNEL__) >> 2U)) = (__COMPARE__))
+#define __HAL_TIM_GET_COMPARE(__HANDLE__, __CHANNEL__) \
+    (*(&((__HANDLE__)->Instance->CCR1) + ((__CHANNEL__) >> 2U)))
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_OnePulse_Start(TIM_HandleTypeDef *htim, uint32_t OutputChannel);
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim);
+uint32_t HAL_TIM_ReadCapturedValue(const TIM_HandleTypeDef *htim, uint32_t Channel);
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+
+/* Core ----------------------------------------------------------------------*/
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_GetTick(void);
+
+// Interrupt masking. Simulated interrupts (see host_sim.h) are delivered with the same lock held
+void HostIRQ_Disable(void);
+void HostIRQ_Enable(void);
+#define __disable_irq() HostIRQ_Disable()
+#define __enable_irq()  HostIRQ_Enable()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_STM32F3XX_HAL_H */
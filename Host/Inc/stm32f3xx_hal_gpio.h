@@ -0,0 +1,9 @@
+/*
+ * Host stand-in for stm32f3xx_hal_gpio.h. The GPIO API is declared in the host stm32f3xx_hal.h.
+ */
+#ifndef HOST_STM32F3XX_HAL_GPIO_H
+#define HOST_STM32F3XX_HAL_GPIO_H
+
+#include "stm32f3xx_hal.h"
+
+#endif /* HOST_STM32F3XX_HAL_GPIO_H */
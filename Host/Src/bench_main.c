@@ -0,0 +1,1294 @@
+/*
+ * Host benchmark of the driver hot paths, on the board wiring of host_board.h.
+ *
+ * Usage: my_sensors_bench [filter] [--trace capture]
+ * --trace replays the distance frames of a telemetry capture (see my_sensors_rtos --capture) through the HC-SR04
+ * filter instead of the generated trace.
+ *
+ * Before the benchmarks, whatever the filter, the results of the drivers are checked against references: the
+ * generated font columns, the telemetry frames, the integer BME280 compensation and the HC-SR04 distance. The
+ * exit status is 1 when a check fails, so the bench can gate a change.
+ */
+#include "main.h"
+#include "bme280.h"
+#include "console.h"
+#include "display.h"
+#include "hcsr04.h"
+#include "hcsr04_filter.h"
+#include "i2c_bus.h"
+#include "telemetry.h"
+#include "af_motor_shield.h"
+#include "wheel_control.h"
+#include "host_board.h"
+#include "host_bench.h"
+#include <assert.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static uint32_t bench_failures;
+
+// Reports a failed check and counts it for the exit status
+static void Bench_Expect(bool ok, const char *format, ...) {
+    if (ok) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "check failed: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    bench_failures++;
+}
+
+static void Bench_DisplayUpdateScreen(void *ctx) {
+    uint32_t *i = ctx;
+    // every pixel changes, so this is the cost of a full frame
+    Display_Fill((*i)++ % 2 ? White : Black);
+    Display_UpdateScreen();
+}
+
+static void Bench_DisplayPrint(void *ctx) {
+    uint32_t *i = ctx;
+    Display_Print("Temp:%.2f Dist:%.2fcm", 21.0f + (float) (*i % 10), 100.0f + (float) (*i % 7));
+    (*i)++;
+}
+
+typedef struct Bench_Glyphs {
+    DISPLAY_FONT font;
+    uint32_t i;
+} Bench_Glyphs;
+
+// Renders into the back buffer only, at every row offset within a page
+static void Bench_DisplayWriteChar(void *ctx) {
+    Bench_Glyphs *glyphs = ctx;
+    const uint32_t i = glyphs->i++;
+    Display_SetCursor((i % 11) * 11, i % (64 - 18 + 1));
+    Display_WriteChar((char) (33 + i % 94), glyphs->font, i % 3 ? White : Black);
+}
+
+// A frame the panel did not acknowledge is sent again by the next flush, even when nothing was drawn since
+static void Bench_CheckDisplayRetry(void) {
+    Display_Fill(White);
+    Display_UpdateScreen();
+    HostI2C_Detach(&hi2c1, 0x3C << 1);
+    Display_Fill(Black);
+    Display_UpdateScreen();
+    HostI2C_Attach(&hi2c1, 0x3C << 1, &host_board.ssd1306.dev);
+    Display_UpdateScreen();
+    size_t stale = 0;
+    for (size_t i = 0; i < sizeof host_board.ssd1306.gddram; i++) {
+        stale += host_board.ssd1306.gddram[i] != 0x00;
+    }
+    Bench_Expect(stale == 0, "display: %zu bytes still show the frame before a failed flush", stale);
+}
+
+// The transposed font table is generated by tools/gen_font_columns.py; check it against the row table
+static void Bench_CheckFontColumns(const char *name, DISPLAY_FONT font) {
+    Bench_Expect(font.columns != NULL, "%s has no column table", name);
+    if (font.columns == NULL) {
+        return;
+    }
+    uint32_t mismatches = 0;
+    for (uint32_t ch = 0; ch < 95; ch++) {
+        for (uint32_t j = 0; j < font.FontWidth; j++) {
+            uint32_t column = 0;
+            for (uint32_t i = 0; i < font.FontHeight; i++) {
+                if ((font.data[ch * font.FontHeight + i] << j) & 0x8000) {
+                    column |= 1U << i;
+                }
+            }
+            mismatches += font.columns[ch * font.FontWidth + j] != column;
+        }
+    }
+    Bench_Expect(mismatches == 0, "%s: %u columns differ from the rows, rerun tools/gen_font_columns.py", name,
+                 mismatches);
+}
+
+// Draws into the back buffer only; a full-screen clear, a progress bar at an unaligned row and its frame
+static void Bench_DisplayFillScreen(void *ctx) {
+    uint32_t *i = ctx;
+    Display_FillRectangle(0, 0, 127, 63, (*i)++ % 2 ? White : Black);
+}
+
+static void Bench_DisplayFillBar(void *ctx) {
+    uint32_t *i = ctx;
+    Display_FillRectangle(3, 37, 3 + (*i)++ % 122, 45, White);
+    Display_FillRectangle(3 + *i % 122, 37, 124, 45, Black);
+}
+
+static void Bench_DisplayDrawRectangle(void *ctx) {
+    uint32_t *i = ctx;
+    Display_DrawRectangle(2, 36, 125, 46, (*i)++ % 2 ? White : Black);
+}
+
+// The sensor of the board, which the HC-SR04 take the speed of sound from
+static BME280 *bench_environment;
+
+static float Bench_GetHumidity(void) {
+    return BME280_GetHumidity(bench_environment);
+}
+
+static float Bench_GetTemperature(void) {
+    return BME280_GetTemperature(bench_environment);
+}
+
+static void Bench_BME280Measure(void *ctx) {
+    const BME280_Status_t status = BME280_Measure(ctx);
+    assert(status == BME280_OK);
+}
+
+// One forced measurement: trigger, sleep for the computed measurement time, poll STATUS, read the data
+static void Bench_BME280Forced(void *ctx) {
+    BME280_Status_t status = BME280_WakeUP(ctx);
+    assert(status == BME280_OK);
+    status = BME280_Measure(ctx);
+    assert(status == BME280_OK);
+}
+
+typedef struct Bench_Detach {
+    BME280_Status_t detached;
+    BME280_Status_t reattached;
+    uint32_t transactions;      // of the sample after the recovery
+    float temperature;
+} Bench_Detach;
+
+// The sensor comes loose and is plugged back in, powered up again with its default configuration
+static void Bench_BME280Detach(BME280 *sensor, Bench_Detach *detach) {
+    HostI2C_Detach(&hi2c1, 0xEC);
+    detach->detached = BME280_Measure(sensor);
+    HostBME280_Init(&host_board.bme280);
+    HostI2C_Attach(&hi2c1, 0xEC, &host_board.bme280.dev);
+    detach->reattached = BME280_Measure(sensor);
+    // configured again, out of sleep mode
+    assert(detach->reattached != BME280_OK || host_board.bme280.regs[CTRL_MEAS_REG] != 0);
+    const uint32_t transactions = I2CBus_GetStats(&hi2c1).transactions;
+    BME280_Measure(sensor);
+    detach->transactions = I2CBus_GetStats(&hi2c1).transactions - transactions;
+    detach->temperature = BME280_GetTemperature(sensor);
+}
+
+/* Environmental zones: the sensor of the board and three more at the other address and on a second bus, all in
+ * forced mode at OSRS_1, each a degree or so colder than the previous one
+ */
+#define BENCH_ZONES 4
+
+typedef struct Bench_Zones {
+    BME280 *sensors[BENCH_ZONES];
+    BME280_Status_t statuses[BENCH_ZONES];
+    uint32_t rounds;
+    uint32_t sampled;
+    uint64_t sim_ns;
+} Bench_Zones;
+
+static I2C_HandleTypeDef bench_hi2c2;
+static HostBME280 bench_zone_models[BENCH_ZONES - 1];
+
+static void Bench_Zones_Init(Bench_Zones *zones, BME280 *board_sensor) {
+    bench_hi2c2.Instance = I2C2;
+    bench_hi2c2.Init.Timing = hi2c1.Init.Timing;
+    I2CBus_Init(&bench_hi2c2);
+    const BME280Peripheral peripherals[BENCH_ZONES - 1] = {
+            {.hi2c = &hi2c1, .address = BME280_ADDRESS_SDO_HIGH},
+            {.hi2c = &bench_hi2c2, .address = BME280_ADDRESS_SDO_LOW},
+            {.hi2c = &bench_hi2c2, .address = BME280_ADDRESS_SDO_HIGH},
+    };
+    zones->sensors[0] = board_sensor;
+    for (size_t i = 1; i < BENCH_ZONES; i++) {
+        const BME280Peripheral *peripheral = &peripherals[i - 1];
+        HostBME280 *model = &bench_zone_models[i - 1];
+        HostBME280_Init(model);
+        HostBME280_SetRaw(model, 519888 - 6000 * (int32_t) i, 415148, 30000);
+        HostI2C_Attach(peripheral->hi2c, peripheral->address << 1U, &model->dev);
+        zones->sensors[i] = BME280_Init(*peripheral, OSRS_1, OSRS_1, OSRS_1, MODE_FORCED, T_SB_0p5, IIR_OFF);
+        assert(zones->sensors[i] != NULL);
+    }
+}
+
+// Every zone in turn, each with its own measurement time
+static void Bench_BME280ZonesInTurn(void *ctx) {
+    Bench_Zones *zones = ctx;
+    const uint64_t start_ns = HostSim_Nanos();
+    for (size_t i = 0; i < BENCH_ZONES; i++) {
+        zones->statuses[i] = BME280_WakeUP(zones->sensors[i]);
+        if (zones->statuses[i] == BME280_OK) {
+            zones->statuses[i] = BME280_Measure(zones->sensors[i]);
+        }
+        zones->sampled += zones->statuses[i] == BME280_OK;
+    }
+    zones->sim_ns += HostSim_Nanos() - start_ns;
+    zones->rounds++;
+}
+
+static void Bench_BME280ZonesAll(void *ctx) {
+    Bench_Zones *zones = ctx;
+    const uint64_t start_ns = HostSim_Nanos();
+    zones->sampled += BME280_MeasureAll(zones->sensors, BENCH_ZONES, zones->statuses);
+    zones->sim_ns += HostSim_Nanos() - start_ns;
+    zones->rounds++;
+}
+
+typedef struct Bench_Distance {
+    HCSR04 *sensor;
+    float distance_m;
+} Bench_Distance;
+
+static void Bench_HCSR04Measure(void *ctx) {
+    Bench_Distance *distance = ctx;
+    distance->distance_m = HCSR04_MeasureDistanceInMeters(distance->sensor);
+}
+
+typedef struct Bench_Ranging {
+    HCSR04 *sensor;
+    uint32_t ticks_per_us;  // of the echo timer
+    HCSR04_Sample samples[HCSR04_SAMPLE_BUFFER_SIZE];
+    uint32_t count;
+    float distance_m;
+    uint32_t distance_mm;
+} Bench_Ranging;
+
+// One display period of the continuous mode: the echoes arrive meanwhile, the batch is drained afterwards
+static void Bench_HCSR04Continuous(void *ctx) {
+    Bench_Ranging *ranging = ctx;
+    HAL_Delay(100);
+    ranging->count += HCSR04_ReadSamples(ranging->sensor, ranging->samples, HCSR04_SAMPLE_BUFFER_SIZE);
+}
+
+/* Four sensors around a rover: the board sensor plus three more, each with a one-pulse trigger timer of its own
+ * and the echoes captured in pairs by htim15 and htim2.
+ */
+#define BENCH_ROVER_SENSORS 4U
+#define BENCH_ROVER_RATE_HZ 10U
+#define BENCH_ROVER_GUARD_US 2000U
+#define BENCH_ROVER_BATCHES 20U
+
+typedef struct Bench_Rover {
+    HCSR04 *sensors[BENCH_ROVER_SENSORS];
+    HostHCSR04 *models[BENCH_ROVER_SENSORS];
+    uint32_t samples[BENCH_ROVER_SENSORS];
+    uint32_t crosstalk;
+} Bench_Rover;
+
+static TIM_HandleTypeDef bench_htim1, bench_htim2, bench_htim4, bench_htim17;
+static HostHCSR04 bench_rover_models[BENCH_ROVER_SENSORS - 1];
+
+static void Bench_Rover_InitTrigger(TIM_HandleTypeDef *htim, TIM_TypeDef *instance) {
+    htim->Instance = instance;
+    htim->Init.Prescaler = 72 - 1;
+    htim->Init.Period = 11;
+    instance->CR1 = TIM_CR1_OPM;
+    instance->PSC = 72 - 1;
+    instance->ARR = 11;
+    instance->CCR1 = 1;
+}
+
+static void Bench_Rover_Init(Bench_Rover *rover, HCSR04 *board_sensor) {
+    Bench_Rover_InitTrigger(&bench_htim17, TIM17);
+    Bench_Rover_InitTrigger(&bench_htim1, TIM1);
+    Bench_Rover_InitTrigger(&bench_htim4, TIM4);
+    bench_htim2.Instance = TIM2;
+    // the 32 bit counter of TIM2 at the core clock
+    bench_htim2.Init.Prescaler = 0;
+    bench_htim2.Init.Period = 0xFFFFFFFFU;
+
+    const HCSR04Peripheral peripherals[BENCH_ROVER_SENSORS - 1] = {
+            {.trigger_htim = &bench_htim17, .trigger_channel = TIM_CHANNEL_1,
+             .echo_htim = &htim15, .echo_channel = TIM_CHANNEL_2},
+            {.trigger_htim = &bench_htim1, .trigger_channel = TIM_CHANNEL_1,
+             .echo_htim = &bench_htim2, .echo_channel = TIM_CHANNEL_1},
+            {.trigger_htim = &bench_htim4, .trigger_channel = TIM_CHANNEL_1,
+             .echo_htim = &bench_htim2, .echo_channel = TIM_CHANNEL_2},
+    };
+    const float distances_m[BENCH_ROVER_SENSORS - 1] = {0.4f, 2.5f, 1.5f};
+    rover->sensors[0] = board_sensor;
+    rover->models[0] = &host_board.hcsr04;
+    for (size_t i = 1; i < BENCH_ROVER_SENSORS; i++) {
+        const HCSR04Peripheral *peripheral = &peripherals[i - 1];
+        HostHCSR04_Init(&bench_rover_models[i - 1], peripheral->trigger_htim, peripheral->echo_htim,
+                        peripheral->echo_channel);
+        bench_rover_models[i - 1].distance_m = distances_m[i - 1];
+        bench_rover_models[i - 1].speed_of_sound_ms = host_board.hcsr04.speed_of_sound_ms;
+        rover->models[i] = &bench_rover_models[i - 1];
+        rover->sensors[i] = HCSR04_Init(*peripheral, Bench_GetHumidity, Bench_GetTemperature);
+    }
+}
+
+static void Bench_Rover_Reset(Bench_Rover *rover) {
+    for (size_t i = 0; i < BENCH_ROVER_SENSORS; i++) {
+        HCSR04_Sample samples[HCSR04_SAMPLE_BUFFER_SIZE];
+        while (HCSR04_ReadSamples(rover->sensors[i], samples, HCSR04_SAMPLE_BUFFER_SIZE) > 0) {
+        }
+        rover->samples[i] = 0;
+        rover->models[i]->crosstalk = 0;
+    }
+}
+
+// Bursts of all the sensors that went out while another sensor was still listening for its echo
+static void Bench_Rover_Finish(Bench_Rover *rover) {
+    rover->crosstalk = 0;
+    for (size_t i = 0; i < BENCH_ROVER_SENSORS; i++) {
+        rover->crosstalk += rover->models[i]->crosstalk;
+    }
+}
+
+static void Bench_HCSR04RoverBatch(void *ctx) {
+    Bench_Rover *rover = ctx;
+    HAL_Delay(100);
+    HCSR04_CheckRoundRobin();
+    for (size_t i = 0; i < BENCH_ROVER_SENSORS; i++) {
+        HCSR04_Sample samples[HCSR04_SAMPLE_BUFFER_SIZE];
+        rover->samples[i] += HCSR04_ReadSamples(rover->sensors[i], samples, HCSR04_SAMPLE_BUFFER_SIZE);
+    }
+}
+
+/* A sensor alone in the round robin is triggered again from its own falling edge; every sample must still be the
+ * width of an echo, not the time from one trigger to the next
+ */
+static void Bench_CheckRoundRobinAlone(const Bench_Rover *rover) {
+    HCSR04 *sensor = rover->sensors[1];
+    const float model_mm = rover->models[1]->distance_m * 1000.0f;
+    const float tolerance_mm = 1.0f + 0.002f * model_mm;
+    HostSim_SetRealTimeDelays(true);
+    const bool started = HCSR04_StartRoundRobin(&sensor, 1, BENCH_ROVER_GUARD_US);
+    assert(started);
+    uint32_t count = 0;
+    uint32_t wrong = 0;
+    uint16_t wrong_mm = 0;
+    for (uint32_t batch = 0; batch < 4U; batch++) {
+        HAL_Delay(50);
+        HCSR04_Sample samples[HCSR04_SAMPLE_BUFFER_SIZE];
+        const size_t read = HCSR04_ReadSamples(sensor, samples, HCSR04_SAMPLE_BUFFER_SIZE);
+        for (size_t i = 0; i < read; i++) {
+            const uint16_t mm = HCSR04_SampleToMm(sensor, &samples[i]);
+            if (fabsf((float) mm - model_mm) > tolerance_mm) {
+                wrong++;
+                wrong_mm = mm;
+            }
+        }
+        count += read;
+    }
+    HCSR04_StopRoundRobin();
+    HostSim_SetRealTimeDelays(false);
+    // the trigger already armed still sends its burst
+    HAL_Delay(HCSR04_ECHO_TIMEOUT_MS);
+    Bench_Expect(count > 0 && wrong == 0, "HC-SR04 alone in the round robin at %.0f mm: %u of %u samples off, "
+                                          "last %u mm", model_mm, wrong, count, wrong_mm);
+}
+
+static void Bench_Rover_Print(const Bench_Rover *rover) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < BENCH_ROVER_SENSORS; i++) {
+        printf(" %u", rover->samples[i]);
+        total += rover->samples[i];
+    }
+    printf(" samples, %.1f samples/s, %u bursts heard by another sensor\n",
+           (double) total * 1000.0 / (BENCH_ROVER_BATCHES * 100.0), rover->crosstalk);
+}
+
+// Echo widths across the whole range, converted the way the consumer of the continuous mode does
+static void Bench_HCSR04SampleToMeters(void *ctx) {
+    Bench_Ranging *ranging = ctx;
+    const HCSR04_Sample sample = {.echo_ticks = (116U + ranging->count++ % 23000U) * ranging->ticks_per_us};
+    ranging->distance_m += HCSR04_SampleToMeters(ranging->sensor, &sample);
+}
+
+static void Bench_HCSR04SampleToMm(void *ctx) {
+    Bench_Ranging *ranging = ctx;
+    const HCSR04_Sample sample = {.echo_ticks = (116U + ranging->count++ % 23000U) * ranging->ticks_per_us};
+    ranging->distance_mm += HCSR04_SampleToMm(ranging->sensor, &sample);
+}
+
+/* Distances across the range, the farther ones with echoes over several overflows of the 16 bit echo timer;
+ * the model takes the speed of sound at 20 C, the driver that of the simulated BME280
+ */
+#define BENCH_RANGE_POINTS 4U
+
+typedef struct Bench_Range {
+    float model_m[BENCH_RANGE_POINTS];
+    uint16_t measured_mm[BENCH_RANGE_POINTS];
+    bool echoed[BENCH_RANGE_POINTS];
+} Bench_Range;
+
+static void Bench_HCSR04MeasureRange(HCSR04 *sensor, Bench_Range *range) {
+    const float model_m = host_board.hcsr04.distance_m;
+    *range = (Bench_Range) {.model_m = {0.05f, 1.0f, 2.5f, 3.9f}};
+    for (size_t i = 0; i < BENCH_RANGE_POINTS; i++) {
+        host_board.hcsr04.distance_m = range->model_m[i];
+        range->echoed[i] = HCSR04_MeasureDistanceMm(sensor, &range->measured_mm[i], HCSR04_ECHO_TIMEOUT_MS);
+    }
+    host_board.hcsr04.distance_m = model_m;
+}
+
+// Within the resolution of the millimetre result and 0.2 % of the distance, what the floored speed of sound costs
+static void Bench_CheckRange(const Bench_Range *range) {
+    for (size_t i = 0; i < BENCH_RANGE_POINTS; i++) {
+        const float model_mm = range->model_m[i] * 1000.0f;
+        const float tolerance_mm = 1.0f + 0.002f * model_mm;
+        Bench_Expect(range->echoed[i] && fabsf((float) range->measured_mm[i] - model_mm) <= tolerance_mm,
+                     "HC-SR04 at %.0f mm measured %u mm%s, tolerance %.1f mm", model_mm, range->measured_mm[i],
+                     range->echoed[i] ? "" : " without echo", tolerance_mm);
+    }
+}
+
+static void Bench_HCSR04PrintRange(const Bench_Range *range) {
+    printf("HC-SR04 echo timer at %.0f MHz, overflow every %.2f ms:",
+           (double) SystemCoreClock / (htim15.Init.Prescaler + 1U) / 1e6,
+           (htim15.Init.Period + 1.0) * (htim15.Init.Prescaler + 1U) * 1e3 / SystemCoreClock);
+    for (size_t i = 0; i < BENCH_RANGE_POINTS; i++) {
+        printf(" %.0f mm -> %u mm%s", range->model_m[i] * 1000.0f, range->measured_mm[i],
+               range->echoed[i] ? "" : " (no echo)");
+    }
+    printf("\n");
+}
+
+#define BENCH_TRACE_MAX 20000U
+
+typedef struct Bench_Trace {
+    const char *name;
+    uint16_t raw_mm[BENCH_TRACE_MAX];
+    uint16_t truth_mm[BENCH_TRACE_MAX];     // 0 when unknown, as in a capture
+    uint32_t size;
+} Bench_Trace;
+
+static Bench_Trace trace;
+
+static uint32_t bench_random_state = 2463534242U;
+
+static uint32_t Bench_Random(void) {
+    bench_random_state ^= bench_random_state << 13;
+    bench_random_state ^= bench_random_state >> 17;
+    bench_random_state ^= bench_random_state << 5;
+    return bench_random_state;
+}
+
+static float Bench_RandomUniform(void) {
+    return (float) (Bench_Random() >> 8) / 16777216.0f;
+}
+
+/* 500 s at 40 Hz of a target swinging between 0.4 and 2 m, 0.4 m farther every other 75 s: 3 mm of Gaussian jitter,
+ * 3 % of late echoes off a farther surface and 1 % of early ones from the crosstalk of a second sensor
+ */
+static void Bench_GenerateTrace(Bench_Trace *t) {
+    t->name = "generated";
+    t->size = BENCH_TRACE_MAX;
+    for (uint32_t n = 0; n < t->size; n++) {
+        float truth = 1200.0f + 800.0f * sinf(2.0f * 3.14159265f * (float) n / 800.0f);
+        if ((n / 3000U) % 2U) {
+            truth += 400.0f;
+        }
+        const float u1 = Bench_RandomUniform() + 1e-7f;
+        const float u2 = Bench_RandomUniform();
+        float raw = truth + 3.0f * sqrtf(-2.0f * logf(u1)) * cosf(2.0f * 3.14159265f * u2);
+        const uint32_t glitch = Bench_Random() % 100U;
+        if (glitch < 3U) {
+            raw = truth + 300.0f + 1700.0f * Bench_RandomUniform();
+        } else if (glitch < 4U) {
+            raw = truth * 0.5f;
+        }
+        t->truth_mm[n] = (uint16_t) lroundf(truth);
+        t->raw_mm[n] = (uint16_t) lroundf(raw);
+    }
+}
+
+// Distance frames with an echo from a telemetry capture; the truth is not known
+static bool Bench_LoadTrace(Bench_Trace *t, const char *path) {
+    FILE *input = fopen(path, "rb");
+    if (input == NULL) {
+        perror(path);
+        return false;
+    }
+    t->name = path;
+    t->size = 0;
+    Telemetry_Parser parser = {0};
+    Telemetry_Sample sample;
+    int c;
+    while ((c = fgetc(input)) != EOF && t->size < BENCH_TRACE_MAX) {
+        if (Telemetry_Parse(&parser, (uint8_t) c, &sample) && sample.type == TELEMETRY_DISTANCE &&
+            sample.distance.distance_mm != TELEMETRY_DISTANCE_INVALID) {
+            t->raw_mm[t->size] = sample.distance.distance_mm;
+            t->truth_mm[t->size] = 0;
+            t->size++;
+        }
+    }
+    fclose(input);
+    return t->size > 0;
+}
+
+#define BENCH_GROSS_ERROR_MM 100
+
+typedef struct Bench_Filter {
+    HCSR04Filter filter;
+    uint32_t i;
+    uint32_t raw_gross, gross;  // errors beyond BENCH_GROSS_ERROR_MM
+    double raw_error, error;    // sums of absolute errors
+    uint32_t compared;
+} Bench_Filter;
+
+static void Bench_Filter_Init(Bench_Filter *bench, uint8_t window, uint8_t hampel_k_q4, uint8_t smoothing_shift) {
+    memset(bench, 0, sizeof *bench);
+    const HCSR04Filter_Config config = {
+            .window = window,
+            .hampel_k_q4 = hampel_k_q4,
+            .smoothing_shift = smoothing_shift,
+            .min_scale_mm = 3,
+    };
+    HCSR04Filter_Init(&bench->filter, &config);
+}
+
+static void Bench_Filter_Print(const char *name, const Bench_Filter *bench, bool raw) {
+    printf(", %s %.1f mm %.2f %%", name, (raw ? bench->raw_error : bench->error) / bench->compared,
+           100.0 * (raw ? bench->raw_gross : bench->gross) / bench->compared);
+}
+
+static void Bench_HCSR04Filter(void *ctx) {
+    Bench_Filter *bench = ctx;
+    const uint32_t n = bench->i++ % trace.size;
+    const uint16_t filtered = HCSR04Filter_Update(&bench->filter, trace.raw_mm[n]);
+    if (trace.truth_mm[n] != 0) {
+        const double raw_error = fabs((double) trace.raw_mm[n] - trace.truth_mm[n]);
+        const double error = fabs((double) filtered - trace.truth_mm[n]);
+        bench->raw_error += raw_error;
+        bench->error += error;
+        bench->raw_gross += raw_error > BENCH_GROSS_ERROR_MM;
+        bench->gross += error > BENCH_GROSS_ERROR_MM;
+        bench->compared++;
+    }
+}
+
+// The same median by sorting a copy of the window for every sample, for comparison
+typedef struct Bench_SortedMedian {
+    uint16_t window[HCSR04_FILTER_MAX_WINDOW];
+    uint32_t i;
+    uint32_t sum;
+} Bench_SortedMedian;
+
+// The upper middle one of an even count, like the filter while its window fills up
+static uint16_t Bench_SortedWindowMedian(const uint16_t *window, uint32_t count) {
+    uint16_t sorted[HCSR04_FILTER_MAX_WINDOW];
+    for (uint32_t j = 0; j < count; j++) {
+        uint32_t k = j;
+        for (; k > 0 && sorted[k - 1] > window[j]; k--) {
+            sorted[k] = sorted[k - 1];
+        }
+        sorted[k] = window[j];
+    }
+    return sorted[count / 2];
+}
+
+static void Bench_HCSR04SortedMedian(void *ctx) {
+    Bench_SortedMedian *bench = ctx;
+    const uint32_t size = 7;
+    bench->window[bench->i % size] = trace.raw_mm[bench->i % trace.size];
+    bench->i++;
+    bench->sum += Bench_SortedWindowMedian(bench->window, (bench->i < size) ? bench->i : size);
+}
+
+#define BENCH_MEDIAN_CHECK_SAMPLES 2000U
+
+// The heaps of the filter against a sorted copy of the window, on the trace and on a few values repeated often
+static void Bench_CheckMedian(void) {
+    static const uint8_t windows[] = {1, 3, 5, 7, 31};
+    for (size_t w = 0; w < sizeof windows; w++) {
+        for (uint32_t source = 0; source < 2U; source++) {
+            static HCSR04Filter filter;
+            HCSR04Filter_Init(&filter, &(HCSR04Filter_Config) {.window = windows[w], .min_scale_mm = 3});
+            uint16_t window[HCSR04_FILTER_MAX_WINDOW];
+            uint32_t mismatches = 0;
+            for (uint32_t n = 0; n < BENCH_MEDIAN_CHECK_SAMPLES; n++) {
+                const uint16_t value = (source == 0) ? trace.raw_mm[n % trace.size] :
+                                       (uint16_t) (1000U + Bench_Random() % 8U);
+                window[n % windows[w]] = value;
+                HCSR04Filter_Update(&filter, value);
+                const uint32_t count = (n < windows[w]) ? n + 1U : windows[w];
+                mismatches += HCSR04Filter_GetMedian(&filter) != Bench_SortedWindowMedian(window, count);
+            }
+            Bench_Expect(mismatches == 0, "HC-SR04 median of %u on %s samples differs from the sorted window %u "
+                                          "times", windows[w], (source == 0) ? trace.name : "repeated", mismatches);
+        }
+    }
+}
+
+static void Bench_ConsolePrint(void *ctx) {
+    (void) ctx;
+    Console_Print("Temp:%.2f Dist:%.2fcm\r\n", 21.5f, 123.25f);
+}
+
+/* BME280 compensation of a batch of raw samples spread over -8..47 C, 70..130 kPa and the whole humidity range,
+ * with the floating-point formulas of the datasheet (section 4.2.3) as reference for the error of the integer
+ * paths. The time stamp counter of the host stands in for the cycle counter of the target.
+ */
+#define BENCH_COMPENSATION_BATCH 256U
+
+typedef struct Bench_Compensation {
+    BME280_Calibration calib;
+    BME280_RawSample raw[BENCH_COMPENSATION_BATCH];
+    BME280_Sample samples[BENCH_COMPENSATION_BATCH];
+    double reference[BENCH_COMPENSATION_BATCH][3];  // C, Pa, %RH
+    uint64_t cycles;
+    uint32_t batches;
+} Bench_Compensation;
+
+static uint64_t Bench_Cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void Bench_Compensation_Init(Bench_Compensation *compensation, const BME280_Calibration *calib,
+                                    bool pressure_32bit) {
+    compensation->calib = *calib;
+    compensation->calib.pressure_32bit = pressure_32bit;
+    for (uint32_t i = 0; i < BENCH_COMPENSATION_BATCH; i++) {
+        compensation->raw[i] = (BME280_RawSample) {
+                .t = 400000 + (int32_t) (Bench_Random() % 200000U),
+                .p = 300000 + (int32_t) (Bench_Random() % 250000U),
+                .h = 15000 + (int32_t) (Bench_Random() % 35000U),
+        };
+    }
+    compensation->cycles = 0;
+    compensation->batches = 0;
+}
+
+static void Bench_CompensateDouble(const BME280_Calibration *c, const BME280_RawSample *raw, double out[3]) {
+    double var1 = ((double) raw->t / 16384.0 - (double) c->dig_T1 / 1024.0) * (double) c->dig_T2;
+    double var2 = ((double) raw->t / 131072.0 - (double) c->dig_T1 / 8192.0) *
+                  ((double) raw->t / 131072.0 - (double) c->dig_T1 / 8192.0) * (double) c->dig_T3;
+    const double t_fine = var1 + var2;
+    out[0] = t_fine / 5120.0;
+
+    var1 = t_fine / 2.0 - 64000.0;
+    var2 = var1 * var1 * (double) c->dig_P6 / 32768.0;
+    var2 = var2 + var1 * (double) c->dig_P5 * 2.0;
+    var2 = var2 / 4.0 + (double) c->dig_P4 * 65536.0;
+    var1 = ((double) c->dig_P3 * var1 * var1 / 524288.0 + (double) c->dig_P2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * (double) c->dig_P1;
+    double p = 1048576.0 - (double) raw->p;
+    p = (p - var2 / 4096.0) * 6250.0 / var1;
+    var1 = (double) c->dig_P9 * p * p / 2147483648.0;
+    var2 = p * (double) c->dig_P8 / 32768.0;
+    out[1] = p + (var1 + var2 + (double) c->dig_P7) / 16.0;
+
+    double h = t_fine - 76800.0;
+    h = ((double) raw->h - ((double) c->dig_H4 * 64.0 + (double) c->dig_H5 / 16384.0 * h)) *
+        ((double) c->dig_H2 / 65536.0 * (1.0 + (double) c->dig_H6 / 67108864.0 * h *
+                                               (1.0 + (double) c->dig_H3 / 67108864.0 * h)));
+    h = h * (1.0 - (double) c->dig_H1 * h / 524288.0);
+    out[2] = (h > 100.0) ? 100.0 : (h < 0.0) ? 0.0 : h;
+}
+
+static void Bench_BME280CompensateDouble(void *ctx) {
+    Bench_Compensation *compensation = ctx;
+    const uint64_t start = Bench_Cycles();
+    for (uint32_t i = 0; i < BENCH_COMPENSATION_BATCH; i++) {
+        Bench_CompensateDouble(&compensation->calib, &compensation->raw[i], compensation->reference[i]);
+    }
+    compensation->cycles += Bench_Cycles() - start;
+    compensation->batches++;
+}
+
+static void Bench_BME280CompensateBatch(void *ctx) {
+    Bench_Compensation *compensation = ctx;
+    const uint64_t start = Bench_Cycles();
+    BME280_Compensate(&compensation->calib, compensation->raw, compensation->samples, BENCH_COMPENSATION_BATCH);
+    compensation->cycles += Bench_Cycles() - start;
+    compensation->batches++;
+}
+
+static double Bench_Compensation_CyclesPerSample(const Bench_Compensation *compensation) {
+    return (double) compensation->cycles / compensation->batches / BENCH_COMPENSATION_BATCH;
+}
+
+// Largest difference of the integer results from the reference, in C, Pa and %RH
+static void Bench_Compensation_MaxError(const Bench_Compensation *compensation,
+                                        const Bench_Compensation *reference, double error[3]) {
+    error[0] = error[1] = error[2] = 0.0;
+    for (uint32_t i = 0; i < BENCH_COMPENSATION_BATCH; i++) {
+        const BME280_Sample *sample = &compensation->samples[i];
+        const double values[3] = {
+                sample->temperature_centi_c / 100.0,
+                sample->pressure_q8_pa / 256.0,
+                sample->humidity_q10_pct / 1024.0,
+        };
+        for (size_t j = 0; j < 3; j++) {
+            error[j] = fmax(error[j], fabs(values[j] - reference->reference[i][j]));
+        }
+    }
+}
+
+/* The integer paths against the double formulas, within the resolution of their results: 0.01 C, 1/256 Pa and
+ * 1/1024 %RH, plus what the datasheet's integer arithmetic rounds away, 1 Pa with 64 bit and 10 Pa with 32 bit.
+ */
+static void Bench_CheckCompensation(const BME280_Calibration *calib) {
+    static Bench_Compensation reference, compensation_64bit, compensation_32bit;
+    Bench_Compensation_Init(&reference, calib, false);
+    compensation_64bit = reference;
+    compensation_32bit = reference;
+    compensation_32bit.calib.pressure_32bit = true;
+    Bench_BME280CompensateDouble(&reference);
+    Bench_BME280CompensateBatch(&compensation_64bit);
+    Bench_BME280CompensateBatch(&compensation_32bit);
+    double error_64bit[3], error_32bit[3];
+    Bench_Compensation_MaxError(&compensation_64bit, &reference, error_64bit);
+    Bench_Compensation_MaxError(&compensation_32bit, &reference, error_32bit);
+    Bench_Expect(error_64bit[0] <= 0.01 && error_32bit[0] <= 0.01, "BME280 temperature off by %.4f C",
+                 fmax(error_64bit[0], error_32bit[0]));
+    Bench_Expect(error_64bit[1] <= 1.0, "BME280 pressure with 64 bit off by %.3f Pa", error_64bit[1]);
+    Bench_Expect(error_32bit[1] <= 10.0, "BME280 pressure with 32 bit off by %.3f Pa", error_32bit[1]);
+    Bench_Expect(error_64bit[2] <= 0.01 && error_32bit[2] <= 0.01, "BME280 humidity off by %.4f %%RH",
+                 fmax(error_64bit[2], error_32bit[2]));
+}
+
+typedef struct Bench_Frame {
+    uint8_t bytes[100];
+    size_t size;
+    uint32_t i;
+} Bench_Frame;
+
+// The same BME280 and HC-SR04 sample as a telemetry frame and as the text line the ground tooling used to scrape
+static void Bench_TelemetryEncode(void *ctx) {
+    Bench_Frame *frame = ctx;
+    const Telemetry_Sample sample = {
+            .type = TELEMETRY_ENVIRONMENT,
+            .seq = (uint16_t) frame->i,
+            .timestamp_ms = frame->i++,
+            .environment = {.temperature_centi_c = 2508, .humidity_centi_pct = 5146, .pressure_deci_pa = 1003012},
+    };
+    frame->size = Telemetry_Encode(frame->bytes, &sample);
+}
+
+static bool Bench_TelemetrySameSample(const Telemetry_Sample *a, const Telemetry_Sample *b) {
+    if (a->type != b->type || a->seq != b->seq || a->timestamp_ms != b->timestamp_ms) {
+        return false;
+    }
+    switch (a->type) {
+        case TELEMETRY_ENVIRONMENT:
+            return a->environment.temperature_centi_c == b->environment.temperature_centi_c &&
+                   a->environment.humidity_centi_pct == b->environment.humidity_centi_pct &&
+                   a->environment.pressure_deci_pa == b->environment.pressure_deci_pa;
+        case TELEMETRY_DISTANCE:
+            return a->distance.distance_mm == b->distance.distance_mm;
+        case TELEMETRY_MOTOR:
+            return a->motor.motor == b->motor.motor && a->motor.command == b->motor.command &&
+                   a->motor.speed == b->motor.speed;
+    }
+    return false;
+}
+
+/* Frames of every type with the extremes of their fields go through the parser behind a byte of line noise; one of
+ * them is corrupted, which the CRC has to catch and seq has to count as lost.
+ */
+static void Bench_CheckTelemetry(void) {
+    const Telemetry_Sample samples[] = {
+            {.type = TELEMETRY_ENVIRONMENT, .seq = 0xFFFE, .timestamp_ms = 0xFFFFFFF0U,
+                    .environment = {.temperature_centi_c = -4012, .humidity_centi_pct = 10000,
+                            .pressure_deci_pa = 1100000}},
+            {.type = TELEMETRY_DISTANCE, .seq = 0xFFFF, .timestamp_ms = 0xFFFFFFFFU,
+                    .distance = {.distance_mm = 1234}},
+            {.type = TELEMETRY_DISTANCE, .seq = 0, .timestamp_ms = 0, .distance = {.distance_mm = TELEMETRY_DISTANCE_INVALID}},
+            {.type = TELEMETRY_MOTOR, .seq = 1, .timestamp_ms = 7, .motor = {.motor = MOTOR_4, .command = BACKWARD,
+                    .speed = 255}},
+            {.type = TELEMETRY_ENVIRONMENT, .seq = 2, .timestamp_ms = 8,
+                    .environment = {.temperature_centi_c = 2508, .humidity_centi_pct = 0, .pressure_deci_pa = 0}},
+    };
+    const size_t count = sizeof samples / sizeof samples[0];
+    const size_t corrupted = 3;
+    Telemetry_Parser parser = {0};
+    Telemetry_Sample sample;
+    Telemetry_Parse(&parser, TELEMETRY_SYNC_0, &sample);
+    size_t decoded = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t frame[TELEMETRY_MAX_FRAME_SIZE];
+        const size_t size = Telemetry_Encode(frame, &samples[i]);
+        Bench_Expect(size > 0 && Telemetry_Crc16(&frame[2], size - 2 - TELEMETRY_CRC_SIZE) ==
+                                 (uint16_t) (frame[size - 2] | frame[size - 1] << 8),
+                     "telemetry frame %zu does not end with its CRC", i);
+        if (i == corrupted) {
+            frame[TELEMETRY_HEADER_SIZE] ^= 0x10U;
+        }
+        bool parsed = false;
+        for (size_t j = 0; j < size; j++) {
+            parsed = Telemetry_Parse(&parser, frame[j], &sample) || parsed;
+        }
+        if (i == corrupted) {
+            Bench_Expect(!parsed, "corrupted telemetry frame %zu was accepted", i);
+            continue;
+        }
+        Bench_Expect(parsed && Bench_TelemetrySameSample(&sample, &samples[i]),
+                     "telemetry frame %zu of type %d did not decode to the sample encoded", i, samples[i].type);
+        decoded += parsed;
+    }
+    Bench_Expect(decoded == count - 1U && parser.crc_errors == 1U && parser.lost_frames == 1U,
+                 "telemetry parser: %zu frames decoded, %u CRC errors, %u lost", decoded, parser.crc_errors,
+                 parser.lost_frames);
+}
+
+static void Bench_TextFormat(void *ctx) {
+    Bench_Frame *frame = ctx;
+    const int size = snprintf((char *) frame->bytes, sizeof frame->bytes, "%u %u T:%.2f P:%.2f H:%.2f\r\n",
+                              frame->i, frame->i, 25.08f, 100301.2f, 51.46f);
+    frame->i++;
+    frame->size = (size_t) size;
+}
+
+static void Bench_MotorRun(void *ctx) {
+    AFMotorShield **motors = ctx;
+    AFMotorShield_RunDCMotor(motors[0], FORWARD);
+    AFMotorShield_RunDCMotor(motors[1], BACKWARD);
+}
+
+// Both wheels of the rover turn around with one batch, so every call changes the latch
+static void Bench_MotorRunPair(void *ctx) {
+    uint32_t *counter = ctx;
+    const bool forward = (*counter)++ % 2U == 0;
+    const AFMotorShieldCommand commands[AF_MOTOR_SHIELD_MOTORS] = {
+            [MOTOR_3 - 1] = {.command = forward ? FORWARD : BACKWARD, .speed = 128},
+            [MOTOR_4 - 1] = {.command = forward ? BACKWARD : FORWARD, .speed = 192},
+    };
+    AFMotorShield_RunDCMotors(commands);
+}
+
+// One update interrupt of a ramp in progress; a new ramp starts in the other direction when it ends
+static void Bench_MotorRampUpdate(void *ctx) {
+    AFMotorShield *motor = ctx;
+    if (!AFMotorShield_IsRamping(motor)) {
+        const bool up = __HAL_TIM_GET_COMPARE(&htim8, TIM_CHANNEL_1) == 0U;
+        AFMotorShield_RampSpeed(motor, up ? 255 : 0, 1000);
+    }
+    AFMotorShield_PeriodElapsedCallback(&htim8);
+}
+
+#define BENCH_WHEEL_SETPOINT 4000        // counts/s, some 5000 rpm of the motor shaft
+#define BENCH_WHEEL_LOAD_N_M 2e-3       // a quarter of the stall torque at 6 V
+#define BENCH_WHEEL_PHASE_MS 800U
+#define BENCH_WHEEL_SETTLED_MS 600U     // the errors are averaged over the rest of a phase
+
+// Step of both wheels with the loop closed on the motor models, then a load on motor 3, then the same load with
+// the duty cycle the loop had settled at but without the loop
+typedef struct Bench_WheelStep {
+    WheelControl *wheels[2];
+    AFMotorShield *motor;
+    double rise_ms;             // to 90 % of the setpoint
+    double peak;
+    double settled_error;
+    double load_dip;
+    double load_error;
+    uint32_t settled_compare;
+    double open_loop_speed;
+    double open_loop_loaded_speed;
+} Bench_WheelStep;
+
+static double Bench_WheelSpeed(const HostDCMotor *motor) {
+    return motor->speed_rad_s * motor->counts_per_rad;
+}
+
+// One control period of the simulation: the motors run 1 ms, then the loop interrupt reads their encoders
+static void Bench_WheelTick(void) {
+    HAL_Delay(1);
+    HostDCMotor_Advance(&host_board.motor3);
+    HostDCMotor_Advance(&host_board.motor4);
+    HostTIM_ServeOverflows(&htim6);
+}
+
+// Runs one phase and returns the mean absolute error of motor 3 once settled; min and max of its speed go to range
+static double Bench_WheelPhase(double setpoint, double *range_min, double *range_max, double *rise_ms) {
+    double error = 0.0;
+    for (uint32_t ms = 1; ms <= BENCH_WHEEL_PHASE_MS; ms++) {
+        Bench_WheelTick();
+        const double speed = Bench_WheelSpeed(&host_board.motor3);
+        if (rise_ms != NULL && *rise_ms == 0.0 && speed >= 0.9 * setpoint) {
+            *rise_ms = ms;
+        }
+        if (range_min != NULL) {
+            *range_min = fmin(*range_min, speed);
+        }
+        if (range_max != NULL) {
+            *range_max = fmax(*range_max, speed);
+        }
+        if (ms > BENCH_WHEEL_SETTLED_MS) {
+            error += fabs(speed - setpoint);
+        }
+    }
+    return error / (BENCH_WHEEL_PHASE_MS - BENCH_WHEEL_SETTLED_MS);
+}
+
+static void Bench_WheelStepRun(Bench_WheelStep *step) {
+    // the motor benchmarks before leave the motors running, the models catch up and coast to a stop first
+    HostDCMotor_Advance(&host_board.motor3);
+    HostDCMotor_Advance(&host_board.motor4);
+    static const int32_t stop[2] = {0, 0};
+    WheelControl_SetSpeeds(step->wheels, stop, 2);
+    HAL_Delay(BENCH_WHEEL_PHASE_MS);
+    HostDCMotor_Advance(&host_board.motor3);
+    HostDCMotor_Advance(&host_board.motor4);
+    assert(host_board.motor3.speed_rad_s == 0.0 && host_board.motor4.speed_rad_s == 0.0);
+    WheelControl_Start(&htim6);
+    // both wheels set off in one transfer of the latch
+    static const int32_t setpoints[2] = {BENCH_WHEEL_SETPOINT, BENCH_WHEEL_SETPOINT};
+    const uint32_t latches = host_board.latch.latches;
+    WheelControl_SetSpeeds(step->wheels, setpoints, 2);
+    assert(host_board.latch.latches == latches + 1U);
+    step->peak = 0.0;
+    step->settled_error = Bench_WheelPhase(BENCH_WHEEL_SETPOINT, NULL, &step->peak, &step->rise_ms);
+    step->settled_compare = __HAL_TIM_GET_COMPARE(&htim8, TIM_CHANNEL_1);
+    host_board.motor3.load_n_m = BENCH_WHEEL_LOAD_N_M;
+    step->load_dip = BENCH_WHEEL_SETPOINT;
+    step->load_error = Bench_WheelPhase(BENCH_WHEEL_SETPOINT, &step->load_dip, NULL, NULL);
+
+    host_board.motor3.load_n_m = 0.0;
+    WheelControl_SetSpeed(step->wheels[0], 0);
+    AFMotorShield_RunDCMotor(step->motor, FORWARD);
+    AFMotorShield_SetCompare(step->motor, step->settled_compare);
+    Bench_WheelPhase(BENCH_WHEEL_SETPOINT, NULL, NULL, NULL);
+    step->open_loop_speed = Bench_WheelSpeed(&host_board.motor3);
+    host_board.motor3.load_n_m = BENCH_WHEEL_LOAD_N_M;
+    Bench_WheelPhase(BENCH_WHEEL_SETPOINT, NULL, NULL, NULL);
+    step->open_loop_loaded_speed = Bench_WheelSpeed(&host_board.motor3);
+    host_board.motor3.load_n_m = 0.0;
+    AFMotorShield_RunDCMotor(step->motor, RELEASE);
+    AFMotorShield_SetSpeed(step->motor, 0);
+    // the other wheel keeps its setpoint for the timing of the loop
+}
+
+// One period of the loop with both wheels driving; the encoders stand still, so the outputs saturate
+static void Bench_WheelControlUpdate(void *ctx) {
+    (void) ctx;
+    WheelControl_PeriodElapsedCallback(&htim6);
+}
+
+static bool Bench_RampInterruptOn(void) {
+    return READ_BIT(htim8.Instance->DIER, TIM_IT_UPDATE) != 0U;
+}
+
+typedef struct Bench_Ramp {
+    uint32_t ramp_ms;
+    double elapsed_ms;
+    double pwm_hz;
+    uint32_t compare;
+    bool interrupt_left_on;
+} Bench_Ramp;
+
+// Full ramp of motor 3 from standstill, with the update interrupts served as the simulation clock moves on
+static void Bench_MotorRamp(AFMotorShield *motor, Bench_Ramp *ramp) {
+    AFMotorShield_SetSpeed(motor, 0);
+    const uint64_t start_ns = HostSim_Nanos();
+    AFMotorShield_RampSpeed(motor, 255, ramp->ramp_ms);
+    while (AFMotorShield_IsRamping(motor) && HostSim_Nanos() - start_ns < 2ULL * ramp->ramp_ms * 1000000ULL) {
+        HAL_Delay(1);
+        HostTIM_ServeOverflows(&htim8);
+    }
+    ramp->elapsed_ms = (double) (HostSim_Nanos() - start_ns) / 1e6;
+    ramp->pwm_hz = (double) SystemCoreClock / (htim8.Instance->PSC + 1U) / (htim8.Instance->ARR + 1U);
+    ramp->compare = __HAL_TIM_GET_COMPARE(&htim8, TIM_CHANNEL_1);
+    ramp->interrupt_left_on = Bench_RampInterruptOn();
+}
+
+// A ramp cut short by any of the speed setters must not leave the update interrupt of the PWM timer on
+static void Bench_CheckRampCancel(AFMotorShield *const motors[2]) {
+    AFMotorShield_RampSpeed(motors[0], 255, 1000);
+    AFMotorShield_RampSpeed(motors[1], 255, 1000);
+    AFMotorShield_PeriodElapsedCallback(&htim8);
+    AFMotorShield_SetSpeed(motors[0], 0);
+    Bench_Expect(Bench_RampInterruptOn(), "motor ramp update interrupt off while motor 4 still ramps");
+    AFMotorShield_SetSpeed(motors[1], 0);
+    Bench_Expect(!Bench_RampInterruptOn(), "motor ramp update interrupt left on by AFMotorShield_SetSpeed");
+
+    AFMotorShield_RampSpeed(motors[0], 255, 1000);
+    AFMotorShield_PeriodElapsedCallback(&htim8);
+    AFMotorShield_RampSpeed(motors[0], 128, 0);
+    Bench_Expect(!Bench_RampInterruptOn(), "motor ramp update interrupt left on by a ramp of 0 ms");
+
+    AFMotorShield_RampSpeed(motors[0], 255, 1000);
+    AFMotorShield_PeriodElapsedCallback(&htim8);
+    const AFMotorShieldCommand commands[AF_MOTOR_SHIELD_MOTORS] = {
+            [MOTOR_3 - 1] = {.command = RELEASE},
+    };
+    AFMotorShield_RunDCMotors(commands);
+    Bench_Expect(!Bench_RampInterruptOn(), "motor ramp update interrupt left on by AFMotorShield_RunDCMotors");
+    AFMotorShield_SetSpeed(motors[0], 0);
+}
+
+int main(int argc, char **argv) {
+    const char *trace_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else {
+            HostBench_SetFilter(argv[i]);
+        }
+    }
+    if (trace_path != NULL) {
+        if (!Bench_LoadTrace(&trace, trace_path)) {
+            fprintf(stderr, "%s: no distance frames\n", trace_path);
+            return 1;
+        }
+    } else {
+        Bench_GenerateTrace(&trace);
+    }
+    HostUART_SetEcho(false);
+    HostBoard_Init();
+
+    Console_Init(&huart2);
+    I2CBus_Init(&hi2c1);
+    const uint64_t bme280_init_ns = HostSim_Nanos();
+    bench_environment = BME280_Init((BME280Peripheral) {
+            .hi2c = &hi2c1,
+            .address = BME280_ADDRESS_SDO_LOW,
+    }, OSRS_16, OSRS_16, OSRS_16, MODE_NORMAL, T_SB_0p5, IIR_16);
+    const double bme280_init_ms = (double) (HostSim_Nanos() - bme280_init_ns) / 1e6;
+    assert(bench_environment != NULL);
+    BME280_Measure(bench_environment);
+    // the echo model flies through the air of the simulated BME280, like the driver assumes
+    host_board.hcsr04.speed_of_sound_ms = 331.3f + 0.606f * BME280_GetTemperature(bench_environment) +
+                                          0.0124f * BME280_GetHumidity(bench_environment);
+    Display_Init(&hi2c1);
+    assert(Display_IsInitialized());
+    HCSR04 *sonar = HCSR04_Init((HCSR04Peripheral) {
+            .trigger_htim = &htim16,
+            .trigger_channel = TIM_CHANNEL_1,
+            .echo_htim = &htim15,
+            .echo_channel = TIM_CHANNEL_1,
+    }, Bench_GetHumidity, Bench_GetTemperature);
+    static Bench_Rover rover;
+    Bench_Rover_Init(&rover, sonar);
+    AFMotorShield *motors[2] = {
+            AFMotorShield_InitDCMotor(MOTOR_3, 4, (AFMotorShieldPeripheral) {.htim = &htim8, .channel = TIM_CHANNEL_1}),
+            AFMotorShield_InitDCMotor(MOTOR_4, 4, (AFMotorShieldPeripheral) {.htim = &htim8, .channel = TIM_CHANNEL_2}),
+    };
+
+    printf("BME280: %.2f C %.2f Pa %.2f %%RH\n", BME280_GetTemperature(bench_environment),
+           BME280_GetPressure(bench_environment), BME280_GetHumidity(bench_environment));
+
+    uint32_t frame_counter = 0;
+    uint32_t print_counter = 0;
+    uint32_t fill_counter = 0;
+    Bench_Frame telemetry_frame = {0};
+    Bench_Frame text_frame = {0};
+    Bench_Glyphs pixel_glyphs = {.font = Font_11x18};
+    pixel_glyphs.font.columns = NULL;
+    Bench_Glyphs column_glyphs = {.font = Font_11x18};
+    Bench_Distance distance = {.sensor = sonar};
+    static Bench_Ranging ranging = {0};
+    ranging.sensor = sonar;
+    ranging.ticks_per_us = SystemCoreClock / (htim15.Init.Prescaler + 1U) / 1000000U;
+    static Bench_Filter median_filter, hampel_filter, smoothed_filter;
+    Bench_Filter_Init(&median_filter, 5, 0, 0);
+    Bench_Filter_Init(&hampel_filter, 7, 48, 0);
+    Bench_Filter_Init(&smoothed_filter, 7, 48, 1);
+    Bench_SortedMedian sorted_median = {0};
+
+    Bench_CheckFontColumns("Font_11x18", Font_11x18);
+    Bench_CheckDisplayRetry();
+    Bench_CheckTelemetry();
+    Bench_CheckCompensation(BME280_GetCalibration(bench_environment));
+    Bench_Range range;
+    Bench_HCSR04MeasureRange(sonar, &range);
+    Bench_CheckRange(&range);
+    Bench_CheckMedian();
+    Bench_CheckRoundRobinAlone(&rover);
+    Bench_CheckRampCancel(motors);
+
+    HostBench_PrintHeader();
+    HostBench_Run("display_update_screen", Bench_DisplayUpdateScreen, &frame_counter, 2000);
+    HostBench_Run("display_print", Bench_DisplayPrint, &print_counter, 2000);
+    const double pixel_ns = HostBench_Run("display_write_char_pixels", Bench_DisplayWriteChar, &pixel_glyphs, 200000);
+    const double column_ns = HostBench_Run("display_write_char_columns", Bench_DisplayWriteChar, &column_glyphs, 200000);
+    HostBench_Run("display_fill_screen", Bench_DisplayFillScreen, &fill_counter, 20000);
+    HostBench_Run("display_fill_bar", Bench_DisplayFillBar, &fill_counter, 20000);
+    HostBench_Run("display_draw_rectangle", Bench_DisplayDrawRectangle, &fill_counter, 20000);
+    HostBench_Run("bme280_measure", Bench_BME280Measure, bench_environment, 100000);
+    Bench_Detach detach;
+    Bench_BME280Detach(bench_environment, &detach);
+    BME280_Status_t bme280_status = BME280_Configure(bench_environment, OSRS_1, OSRS_1, OSRS_1, MODE_FORCED,
+                                                     T_SB_0p5, IIR_OFF);
+    assert(bme280_status == BME280_OK);
+    const uint32_t forced_us = BME280_GetMeasurementTimeUs(bench_environment);
+    HostBench_Run("bme280_forced_osrs1", Bench_BME280Forced, bench_environment, 1000);
+    static Bench_Zones zones_in_turn, zones_all;
+    Bench_Zones_Init(&zones_in_turn, bench_environment);
+    zones_all = zones_in_turn;
+    HostBench_Run("bme280_zones_in_turn", Bench_BME280ZonesInTurn, &zones_in_turn, 250);
+    HostBench_Run("bme280_zones_measure_all", Bench_BME280ZonesAll, &zones_all, 250);
+    bme280_status = BME280_Configure(bench_environment, OSRS_16, OSRS_16, OSRS_16, MODE_NORMAL, T_SB_0p5, IIR_16);
+    // the three compensations work on the same raw samples
+    static Bench_Compensation double_compensation, batch_64bit, batch_32bit;
+    Bench_Compensation_Init(&double_compensation, BME280_GetCalibration(bench_environment), false);
+    batch_64bit = double_compensation;
+    batch_32bit = double_compensation;
+    batch_32bit.calib.pressure_32bit = true;
+    HostBench_Run("bme280_compensate_double", Bench_BME280CompensateDouble, &double_compensation, 2000);
+    HostBench_Run("bme280_compensate_batch_p64", Bench_BME280CompensateBatch, &batch_64bit, 2000);
+    HostBench_Run("bme280_compensate_batch_p32", Bench_BME280CompensateBatch, &batch_32bit, 2000);
+    assert(bme280_status == BME280_OK);
+    HostBench_Run("hcsr04_measure", Bench_HCSR04Measure, &distance, 10000);
+    HostBench_Run("hcsr04_sample_to_m", Bench_HCSR04SampleToMeters, &ranging, 1000000);
+    HostBench_Run("hcsr04_sample_to_mm", Bench_HCSR04SampleToMm, &ranging, 1000000);
+    ranging.count = 0;
+    HostBench_Run("hcsr04_filter_median5", Bench_HCSR04Filter, &median_filter, trace.size);
+    HostBench_Run("hcsr04_filter_hampel7", Bench_HCSR04Filter, &hampel_filter, trace.size);
+    HostBench_Run("hcsr04_filter_hampel7_ema", Bench_HCSR04Filter, &smoothed_filter, trace.size);
+    HostBench_Run("hcsr04_sorted_median7", Bench_HCSR04SortedMedian, &sorted_median, trace.size);
+    // the trigger timer runs free, so the clock must not skip ahead to its next period
+    HostSim_SetRealTimeDelays(true);
+    const bool ranging_started = HCSR04_StartContinuous(sonar, HCSR04_MAX_RATE_HZ);
+    assert(ranging_started);
+    HostBench_Run("hcsr04_continuous_batch", Bench_HCSR04Continuous, &ranging, 20);
+    HCSR04_StopContinuous(sonar);
+    // every sensor of the rover runs free at the same rate, against one sensor at a time
+    static Bench_Rover free_running, round_robin;
+    HAL_Delay(HCSR04_ECHO_TIMEOUT_MS);
+    Bench_Rover_Reset(&rover);
+    for (size_t i = 0; i < BENCH_ROVER_SENSORS; i++) {
+        const bool started = HCSR04_StartContinuous(rover.sensors[i], BENCH_ROVER_RATE_HZ);
+        assert(started);
+    }
+    HostBench_Run("hcsr04_rover_continuous_batch", Bench_HCSR04RoverBatch, &rover, BENCH_ROVER_BATCHES);
+    for (size_t i = 0; i < BENCH_ROVER_SENSORS; i++) {
+        HCSR04_StopContinuous(rover.sensors[i]);
+    }
+    Bench_Rover_Finish(&rover);
+    free_running = rover;
+    // the period in progress still sends its burst
+    HAL_Delay(1000U / BENCH_ROVER_RATE_HZ + HCSR04_ECHO_TIMEOUT_MS);
+    Bench_Rover_Reset(&rover);
+    const bool round_robin_started = HCSR04_StartRoundRobin(rover.sensors, BENCH_ROVER_SENSORS, BENCH_ROVER_GUARD_US);
+    assert(round_robin_started);
+    HostBench_Run("hcsr04_rover_round_robin_batch", Bench_HCSR04RoverBatch, &rover, BENCH_ROVER_BATCHES);
+    HCSR04_StopRoundRobin();
+    Bench_Rover_Finish(&rover);
+    round_robin = rover;
+    HostSim_SetRealTimeDelays(false);
+    // the line drains at 115200 baud in real time, so the buffer overflows and most messages are dropped
+    HostSim_SetRealTimeDelays(true);
+    HostBench_Run("console_print", Bench_ConsolePrint, NULL, 2000);
+    HostSim_SetRealTimeDelays(false);
+    HostBench_Run("telemetry_encode_environment", Bench_TelemetryEncode, &telemetry_frame, 1000000);
+    HostBench_Run("text_format_environment", Bench_TextFormat, &text_frame, 1000000);
+    const uint32_t latches = host_board.latch.latches;
+    const double motor_ns = HostBench_Run("motor_run_dc", Bench_MotorRun, motors, 100000);
+    // motor 3 forward and motor 4 backward, every command shifts out the whole latch
+    const uint32_t latch_transfers = host_board.latch.latches - latches;
+    const uint32_t latch_gpio_writes = HostGPIO_GetWriteCount();
+    assert(latch_transfers == 0 || host_board.latch.output == ((1U << MOTOR3_A) | (1U << MOTOR4_B)));
+    uint32_t pair_counter = 0;
+    const uint32_t pair_latches = host_board.latch.latches;
+    const double motor_pair_ns = HostBench_Run("motor_run_dc_pair", Bench_MotorRunPair, &pair_counter, 100000);
+    const uint32_t pair_transfers = host_board.latch.latches - pair_latches;
+    const uint32_t pair_gpio_writes = HostGPIO_GetWriteCount();
+    // the warm-up call makes the count odd, which ends on motor 3 forward and motor 4 backward
+    assert(pair_transfers == 0 || (pair_counter % 2U == 1 &&
+                                   host_board.latch.output == ((1U << MOTOR3_A) | (1U << MOTOR4_B))));
+    assert(pair_transfers == 0 || (htim8.Instance->CCR1 == 128U && htim8.Instance->CCR2 == 192U));
+    assert((htim8.Instance->CR1 & TIM_CR1_UDIS) == 0);
+    const double ramp_update_ns = HostBench_Run("motor_ramp_update", Bench_MotorRampUpdate, motors[0], 100000);
+    Bench_Ramp ramp = {.ramp_ms = 50};
+    Bench_MotorRamp(motors[0], &ramp);
+    // 255 is past the end of the period, the output stays on
+    assert(ramp.compare == htim8.Instance->ARR + 1U && !ramp.interrupt_left_on);
+    Bench_WheelStep wheel_step = {
+            .wheels = {
+                    WheelControl_Init((WheelControlPeripheral) {.encoder_htim = &htim2, .motor = motors[0]},
+                                      WHEEL_CONTROL_GEAR_MOTOR_GAINS),
+                    WheelControl_Init((WheelControlPeripheral) {.encoder_htim = &htim4, .motor = motors[1]},
+                                      WHEEL_CONTROL_GEAR_MOTOR_GAINS),
+            },
+            .motor = motors[0],
+    };
+    Bench_WheelStepRun(&wheel_step);
+    WheelControl_SetSpeed(wheel_step.wheels[0], BENCH_WHEEL_SETPOINT);
+    HostBench_Run("wheel_control_update", Bench_WheelControlUpdate, NULL, 100000);
+    WheelControl_SetSpeed(wheel_step.wheels[0], 0);
+    WheelControl_SetSpeed(wheel_step.wheels[1], 0);
+    WheelControl_Stop();
+
+    printf("BME280: init in %.1f ms, forced measurement at OSRS_1 within %u us\n", bme280_init_ms, forced_us);
+    printf("BME280 detached: status %d, plugged back: status %d, then %u transaction(s) per sample, %.2f C\n",
+           detach.detached, detach.reattached, detach.transactions, detach.temperature);
+    if (zones_in_turn.rounds > 0 && zones_all.rounds > 0) {
+        printf("BME280 %u zones on 2 buses: %.1f ms per round in turn, %.1f ms all at once, %u of %u samples;",
+               BENCH_ZONES, (double) zones_in_turn.sim_ns / 1e6 / zones_in_turn.rounds,
+               (double) zones_all.sim_ns / 1e6 / zones_all.rounds, zones_in_turn.sampled + zones_all.sampled,
+               (zones_in_turn.rounds + zones_all.rounds) * BENCH_ZONES);
+        for (size_t i = 0; i < BENCH_ZONES; i++) {
+            printf(" %.2f C", BME280_GetTemperature(zones_all.sensors[i]));
+        }
+        printf("\n");
+    }
+    if (double_compensation.batches > 0 && batch_64bit.batches > 0 && batch_32bit.batches > 0) {
+        double error_64bit[3], error_32bit[3];
+        Bench_Compensation_MaxError(&batch_64bit, &double_compensation, error_64bit);
+        Bench_Compensation_MaxError(&batch_32bit, &double_compensation, error_32bit);
+        printf("BME280 compensation of %u samples, TSC cycles per sample: %.0f double, %.0f integer with 64 bit "
+               "pressure, %.0f with 32 bit pressure\n", BENCH_COMPENSATION_BATCH,
+               Bench_Compensation_CyclesPerSample(&double_compensation), Bench_Compensation_CyclesPerSample(&batch_64bit),
+               Bench_Compensation_CyclesPerSample(&batch_32bit));
+        printf("  largest difference from double: %.3f C, %.3f Pa (64 bit) or %.3f Pa (32 bit), %.3f %%RH\n",
+               fmax(error_64bit[0], error_32bit[0]), error_64bit[1], error_32bit[1],
+               fmax(error_64bit[2], error_32bit[2]));
+    }
+    if (latch_transfers > 0) {
+        // the warm-up call of the benchmark is not in the GPIO count
+        printf("Motor command: %.0f ns on the host per latch transfer, %.1f GPIO writes each\n", motor_ns / 2.0,
+               (double) latch_gpio_writes / (latch_transfers - 2U));
+    }
+    if (pair_transfers > 0) {
+        // the warm-up call keeps the directions of motor_run_dc and does not shift the latch out
+        printf("Motor pair command: %.0f ns on the host, %.1f GPIO writes for both motors\n", motor_pair_ns,
+               (double) pair_gpio_writes / pair_transfers);
+    }
+    printf("Motor ramp 0 -> 255 within %u ms at %.0f Hz PWM: done after %.0f ms, compare %u, "
+           "%.0f ns on the host per update interrupt\n", ramp.ramp_ms, ramp.pwm_hz, ramp.elapsed_ms, ramp.compare,
+           ramp_update_ns);
+    printf("Wheel control at %u Hz, step to %d counts/s: 90 %% after %.0f ms, peak %.0f, mean error %.0f;\n",
+           WHEEL_CONTROL_RATE_HZ, BENCH_WHEEL_SETPOINT, wheel_step.rise_ms, wheel_step.peak,
+           wheel_step.settled_error);
+    printf("  load of %.1f mN m: dips to %.0f, mean error %.0f; open loop at the same duty cycle (%u) "
+           "%.0f -> %.0f counts/s\n", BENCH_WHEEL_LOAD_N_M * 1e3, wheel_step.load_dip, wheel_step.load_error,
+           wheel_step.settled_compare, wheel_step.open_loop_speed, wheel_step.open_loop_loaded_speed);
+    if (pixel_ns > 0.0 && column_ns > 0.0) {
+        printf("Font_11x18: %.0f chars/s per pixel, %.0f chars/s by columns\n", 1e9 / pixel_ns, 1e9 / column_ns);
+    }
+    if (telemetry_frame.size > 0 && text_frame.size > 0) {
+        printf("Environment sample: %zu B as telemetry frame, %zu B as text\n", telemetry_frame.size, text_frame.size);
+    }
+    const Console_Stats console_stats = Console_GetStats();
+    printf("Console: %u B queued, %u B dropped, %u of %u B used at most\n", console_stats.bytes,
+           console_stats.dropped_bytes, console_stats.max_used, CONSOLE_TX_BUFFER_SIZE);
+    if (hampel_filter.filter.stats.samples > 0) {
+        printf("HC-SR04 filter on %s trace of %u samples: %u outliers rejected", trace.name, trace.size,
+               HCSR04Filter_GetStats(&hampel_filter.filter).outliers);
+        if (hampel_filter.compared > 0 && median_filter.compared > 0 && smoothed_filter.compared > 0) {
+            printf("; mean error and share beyond %u mm", BENCH_GROSS_ERROR_MM);
+            Bench_Filter_Print("raw", &hampel_filter, true);
+            Bench_Filter_Print("median5", &median_filter, false);
+            Bench_Filter_Print("hampel7", &hampel_filter, false);
+            Bench_Filter_Print("hampel7+ema", &smoothed_filter, false);
+        }
+        printf("\n");
+    }
+    printf("HC-SR04 continuous at %u Hz: %u samples in %u batches, %u dropped, last %.4f m\n", HCSR04_MAX_RATE_HZ,
+           ranging.count, 20U, HCSR04_GetDroppedSamples(sonar),
+           ranging.count > 0 ? HCSR04_SampleToMeters(sonar, &ranging.samples[0]) : 0.0f);
+    if (free_running.samples[0] > 0 || round_robin.samples[0] > 0) {
+        printf("HC-SR04 rover of %u sensors over %u ms, samples per sensor\n", BENCH_ROVER_SENSORS,
+               BENCH_ROVER_BATCHES * 100U);
+        printf("  continuous at %u Hz each:", BENCH_ROVER_RATE_HZ);
+        Bench_Rover_Print(&free_running);
+        printf("  round robin with %u us guard:", BENCH_ROVER_GUARD_US);
+        Bench_Rover_Print(&round_robin);
+    }
+    Bench_HCSR04PrintRange(&range);
+    printf("HC-SR04: %.4f m (model %.4f m), latch 0x%02X\n", distance.distance_m, host_board.hcsr04.distance_m, host_board.latch.output);
+    if (bench_failures > 0) {
+        printf("%u check(s) failed\n", bench_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
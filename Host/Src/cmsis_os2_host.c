@@ -0,0 +1,651 @@
+/*
+ * CMSIS-RTOS v2 on POSIX threads.
+ *
+ * Implements the part of cmsis_os2.h that the application uses, so that the task set created in main.c
+ * can run on the development machine. Every RTOS thread is a pthread; when HostRTOS_Config.single_core
+ * is set the whole process is pinned to one CPU and the threads get SCHED_RR priorities mapped from
+ * osPriority_t (if the process is allowed to), which approximates the preemptive, time-sliced scheduler
+ * of the target.
+ *
+ * Unlike on the target, osKernelStart() returns after releasing the threads, so that the host program
+ * decides how long the simulation runs (see HostRTOS_Run()).
+ *
+ * Every thread records how late it woke up from osDelay()/osDelayUntil() and how long it took from
+ * osThreadFlagsSet() to the return of the matching osThreadFlagsWait(), and how much CPU time it used.
+ * Message queues record their high-water mark.
+ */
+#define _GNU_SOURCE
+#include "cmsis_os2.h"
+#include "host_rtos.h"
+#include "host_sim.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HOST_RTOS_MAX_THREADS 16
+#define HOST_RTOS_MAX_QUEUES  16
+
+typedef struct HostThread {
+    pthread_t pthread;
+    const char *name;
+    osThreadFunc_t func;
+    void *argument;
+    osPriority_t priority;
+    uint32_t stack_size;
+    clockid_t cpu_clock;
+    bool has_cpu_clock;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t flags;
+    uint64_t flags_set_ns;
+
+    uint64_t wakeups;
+    uint64_t latency_sum_ns;
+    uint64_t latency_max_ns;
+} HostThread;
+
+typedef struct HostQueue {
+    const char *name;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;
+    uint32_t msg_size;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t count;
+
+    uint32_t max_count;
+    uint64_t puts;
+    uint64_t gets;
+    uint64_t put_failures;
+} HostQueue;
+
+typedef struct HostMutex {
+    pthread_mutex_t mutex;
+    HostThread *owner;
+} HostMutex;
+
+typedef struct HostSemaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t count;
+    uint32_t max_count;
+} HostSemaphore;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t started_cond;
+    osKernelState_t state;
+    HostRTOS_Config config;
+    bool priorities_enforced;
+    uint64_t start_ns;
+    HostThread *threads[HOST_RTOS_MAX_THREADS];
+    uint32_t thread_count;
+    HostQueue *queues[HOST_RTOS_MAX_QUEUES];
+    uint32_t queue_count;
+} kernel = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .started_cond = PTHREAD_COND_INITIALIZER,
+        .state = osKernelInactive,
+};
+
+static __thread HostThread *current_thread;
+
+/* Helpers -------------------------------------------------------------------*/
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static struct timespec to_timespec(uint64_t ns) {
+    return (struct timespec) {.tv_sec = (time_t) (ns / 1000000000ULL), .tv_nsec = (long) (ns % 1000000000ULL)};
+}
+
+static uint64_t ticks_to_ns(uint32_t ticks) {
+    return (uint64_t) ticks * 1000000000ULL / HOST_RTOS_TICK_RATE_HZ;
+}
+
+static void init_cond(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// Waits on cond until the absolute deadline; returns false on timeout
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, uint32_t timeout, uint64_t deadline_ns) {
+    if (timeout == osWaitForever) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    const struct timespec deadline = to_timespec(deadline_ns);
+    return pthread_cond_timedwait(cond, lock, &deadline) != ETIMEDOUT;
+}
+
+static void record_wakeup(HostThread *thread, uint64_t latency_ns) {
+    if (thread == NULL) {
+        return;
+    }
+    thread->wakeups++;
+    thread->latency_sum_ns += latency_ns;
+    if (latency_ns > thread->latency_max_ns) {
+        thread->latency_max_ns = latency_ns;
+    }
+}
+
+static HostThread *register_thread(const char *name, osPriority_t priority) {
+    HostThread *thread = calloc(1, sizeof *thread);
+    assert(thread != NULL);
+    thread->name = name;
+    thread->priority = priority;
+    pthread_mutex_init(&thread->lock, NULL);
+    init_cond(&thread->cond);
+
+    pthread_mutex_lock(&kernel.lock);
+    assert(kernel.thread_count < HOST_RTOS_MAX_THREADS);
+    kernel.threads[kernel.thread_count++] = thread;
+    pthread_mutex_unlock(&kernel.lock);
+    return thread;
+}
+
+static HostThread *self_thread(void) {
+    if (current_thread == NULL) {
+        // a thread that was not created through osThreadNew, e.g. the main thread of a benchmark
+        current_thread = register_thread("main", osPriorityNormal);
+        current_thread->pthread = pthread_self();
+        current_thread->has_cpu_clock = pthread_getcpuclockid(pthread_self(), &current_thread->cpu_clock) == 0;
+    }
+    return current_thread;
+}
+
+static bool apply_priority(pthread_t pthread, osPriority_t priority) {
+    if (!kernel.config.single_core) {
+        return false;
+    }
+    // round robin between equal priorities, like configUSE_TIME_SLICING; the top level is kept for HostRTOS_Run()
+    const int min = sched_get_priority_min(SCHED_RR);
+    const int max = sched_get_priority_max(SCHED_RR) - 1;
+    struct sched_param param = {.sched_priority = min + (int) priority * (max - min) / osPriorityISR};
+    return pthread_setschedparam(pthread, SCHED_RR, &param) == 0;
+}
+
+/* Kernel --------------------------------------------------------------------*/
+void HostRTOS_Configure(const HostRTOS_Config *config) {
+    kernel.config = *config;
+}
+
+osStatus_t osKernelInitialize(void) {
+    if (kernel.state != osKernelInactive) {
+        return osError;
+    }
+    if (kernel.config.single_core) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(0, &set);
+        sched_setaffinity(0, sizeof set, &set);
+    }
+    kernel.start_ns = now_ns();
+    kernel.state = osKernelReady;
+    return osOK;
+}
+
+osKernelState_t osKernelGetState(void) {
+    return kernel.state;
+}
+
+osStatus_t osKernelStart(void) {
+    pthread_mutex_lock(&kernel.lock);
+    if (kernel.state != osKernelReady) {
+        pthread_mutex_unlock(&kernel.lock);
+        return osError;
+    }
+    kernel.state = osKernelRunning;
+    kernel.priorities_enforced = true;
+    for (uint32_t i = 0; i < kernel.thread_count; i++) {
+        if (kernel.threads[i]->func != NULL) {
+            kernel.priorities_enforced &= apply_priority(kernel.threads[i]->pthread, kernel.threads[i]->priority);
+        }
+    }
+    pthread_cond_broadcast(&kernel.started_cond);
+    pthread_mutex_unlock(&kernel.lock);
+    return osOK;
+}
+
+uint32_t osKernelGetTickCount(void) {
+    return (uint32_t) (HostSim_Nanos() * HOST_RTOS_TICK_RATE_HZ / 1000000000ULL);
+}
+
+uint32_t osKernelGetTickFreq(void) {
+    return HOST_RTOS_TICK_RATE_HZ;
+}
+
+uint32_t osKernelGetSysTimerCount(void) {
+    return (uint32_t) (HostSim_Nanos() * (SystemCoreClock / 1000000U) / 1000U);
+}
+
+uint32_t osKernelGetSysTimerFreq(void) {
+    return SystemCoreClock;
+}
+
+/* Threads -------------------------------------------------------------------*/
+static void *thread_entry(void *arg) {
+    HostThread *thread = arg;
+    current_thread = thread;
+    thread->has_cpu_clock = pthread_getcpuclockid(pthread_self(), &thread->cpu_clock) == 0;
+
+    pthread_mutex_lock(&kernel.lock);
+    while (kernel.state != osKernelRunning) {
+        pthread_cond_wait(&kernel.started_cond, &kernel.lock);
+    }
+    pthread_mutex_unlock(&kernel.lock);
+
+    thread->func(thread->argument);
+    return NULL;
+}
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void *argument, const osThreadAttr_t *attr) {
+    if (func == NULL) {
+        return NULL;
+    }
+    const char *name = (attr && attr->name) ? attr->name : "thread";
+    const osPriority_t priority = (attr && attr->priority != osPriorityNone) ? attr->priority : osPriorityNormal;
+    HostThread *thread = register_thread(name, priority);
+    thread->func = func;
+    thread->argument = argument;
+    thread->stack_size = attr ? attr->stack_size : 0;
+
+    if (pthread_create(&thread->pthread, NULL, thread_entry, thread) != 0) {
+        return NULL;
+    }
+    pthread_detach(thread->pthread);
+    if (kernel.state == osKernelRunning) {
+        apply_priority(thread->pthread, priority);
+    }
+    return thread;
+}
+
+const char *osThreadGetName(osThreadId_t thread_id) {
+    return thread_id ? ((HostThread *) thread_id)->name : NULL;
+}
+
+osThreadId_t osThreadGetId(void) {
+    return self_thread();
+}
+
+osPriority_t osThreadGetPriority(osThreadId_t thread_id) {
+    return thread_id ? ((HostThread *) thread_id)->priority : osPriorityError;
+}
+
+osStatus_t osThreadYield(void) {
+    sched_yield();
+    return osOK;
+}
+
+uint32_t osThreadGetCount(void) {
+    return kernel.thread_count;
+}
+
+/* Thread flags --------------------------------------------------------------*/
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags) {
+    HostThread *thread = thread_id;
+    if (thread == NULL || (flags & osFlagsError)) {
+        return osFlagsErrorParameter;
+    }
+    pthread_mutex_lock(&thread->lock);
+    thread->flags |= flags;
+    thread->flags_set_ns = now_ns();
+    const uint32_t result = thread->flags;
+    pthread_cond_broadcast(&thread->cond);
+    pthread_mutex_unlock(&thread->lock);
+    return result;
+}
+
+uint32_t osThreadFlagsClear(uint32_t flags) {
+    HostThread *thread = self_thread();
+    pthread_mutex_lock(&thread->lock);
+    const uint32_t result = thread->flags;
+    thread->flags &= ~flags;
+    pthread_mutex_unlock(&thread->lock);
+    return result;
+}
+
+uint32_t osThreadFlagsGet(void) {
+    HostThread *thread = self_thread();
+    pthread_mutex_lock(&thread->lock);
+    const uint32_t result = thread->flags;
+    pthread_mutex_unlock(&thread->lock);
+    return result;
+}
+
+static bool flags_satisfied(uint32_t current, uint32_t flags, uint32_t options) {
+    return (options & osFlagsWaitAll) ? ((current & flags) == flags) : ((current & flags) != 0U);
+}
+
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout) {
+    if (flags & osFlagsError) {
+        return osFlagsErrorParameter;
+    }
+    HostThread *thread = self_thread();
+    const uint64_t deadline_ns = now_ns() + ticks_to_ns(timeout);
+    bool waited = false;
+
+    pthread_mutex_lock(&thread->lock);
+    while (!flags_satisfied(thread->flags, flags, options)) {
+        if (timeout == 0U) {
+            pthread_mutex_unlock(&thread->lock);
+            return osFlagsErrorResource;
+        }
+        waited = true;
+        if (!wait_until(&thread->cond, &thread->lock, timeout, deadline_ns) &&
+            !flags_satisfied(thread->flags, flags, options)) {
+            pthread_mutex_unlock(&thread->lock);
+            return osFlagsErrorTimeout;
+        }
+    }
+    const uint32_t result = thread->flags;
+    if (!(options & osFlagsNoClear)) {
+        thread->flags &= ~flags;
+    }
+    if (waited) {
+        record_wakeup(thread, now_ns() - thread->flags_set_ns);
+    }
+    pthread_mutex_unlock(&thread->lock);
+    return result;
+}
+
+/* Delays --------------------------------------------------------------------*/
+static void sleep_until(uint64_t deadline_ns) {
+    const struct timespec deadline = to_timespec(deadline_ns);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+    record_wakeup(self_thread(), now_ns() - deadline_ns);
+}
+
+osStatus_t osDelay(uint32_t ticks) {
+    if (ticks != 0U) {
+        sleep_until(now_ns() + ticks_to_ns(ticks));
+    }
+    return osOK;
+}
+
+// Like the FreeRTOS port, which passes the difference to vTaskDelayUntil(): a deadline due now trips its
+// configASSERT, one already passed wraps around and sleeps for some 49 days
+osStatus_t osDelayUntil(uint32_t ticks) {
+    const uint32_t delta = ticks - osKernelGetTickCount();
+    assert(delta != 0U && "vTaskDelayUntil() asserts on an increment of 0");
+    sleep_until(now_ns() + ticks_to_ns(delta));
+    return osOK;
+}
+
+/* Mutexes -------------------------------------------------------------------*/
+osMutexId_t osMutexNew(const osMutexAttr_t *attr) {
+    (void) attr;
+    HostMutex *mutex = calloc(1, sizeof *mutex);
+    assert(mutex != NULL);
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&mutex->mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+    return mutex;
+}
+
+osStatus_t osMutexAcquire(osMutexId_t mutex_id, uint32_t timeout) {
+    HostMutex *mutex = mutex_id;
+    if (mutex == NULL) {
+        return osErrorParameter;
+    }
+    int rc;
+    if (timeout == osWaitForever) {
+        rc = pthread_mutex_lock(&mutex->mutex);
+    } else if (timeout == 0U) {
+        rc = pthread_mutex_trylock(&mutex->mutex);
+    } else {
+        const struct timespec deadline = to_timespec(now_ns() + ticks_to_ns(timeout));
+        rc = pthread_mutex_clocklock(&mutex->mutex, CLOCK_MONOTONIC, &deadline);
+    }
+    if (rc != 0) {
+        return timeout == 0U ? osErrorResource : osErrorTimeout;
+    }
+    mutex->owner = self_thread();
+    return osOK;
+}
+
+osStatus_t osMutexRelease(osMutexId_t mutex_id) {
+    HostMutex *mutex = mutex_id;
+    if (mutex == NULL) {
+        return osErrorParameter;
+    }
+    return pthread_mutex_unlock(&mutex->mutex) == 0 ? osOK : osErrorResource;
+}
+
+osThreadId_t osMutexGetOwner(osMutexId_t mutex_id) {
+    return mutex_id ? ((HostMutex *) mutex_id)->owner : NULL;
+}
+
+/* Semaphores ----------------------------------------------------------------*/
+osSemaphoreId_t osSemaphoreNew(uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t *attr) {
+    (void) attr;
+    if (max_count == 0U || initial_count > max_count) {
+        return NULL;
+    }
+    HostSemaphore *semaphore = calloc(1, sizeof *semaphore);
+    assert(semaphore != NULL);
+    pthread_mutex_init(&semaphore->lock, NULL);
+    init_cond(&semaphore->cond);
+    semaphore->count = initial_count;
+    semaphore->max_count = max_count;
+    return semaphore;
+}
+
+osStatus_t osSemaphoreAcquire(osSemaphoreId_t semaphore_id, uint32_t timeout) {
+    HostSemaphore *semaphore = semaphore_id;
+    if (semaphore == NULL) {
+        return osErrorParameter;
+    }
+    const uint64_t deadline_ns = now_ns() + ticks_to_ns(timeout);
+    pthread_mutex_lock(&semaphore->lock);
+    while (semaphore->count == 0U) {
+        if (timeout == 0U) {
+            pthread_mutex_unlock(&semaphore->lock);
+            return osErrorResource;
+        }
+        if (!wait_until(&semaphore->cond, &semaphore->lock, timeout, deadline_ns) && semaphore->count == 0U) {
+            pthread_mutex_unlock(&semaphore->lock);
+            return osErrorTimeout;
+        }
+    }
+    semaphore->count--;
+    pthread_mutex_unlock(&semaphore->lock);
+    return osOK;
+}
+
+osStatus_t osSemaphoreRelease(osSemaphoreId_t semaphore_id) {
+    HostSemaphore *semaphore = semaphore_id;
+    if (semaphore == NULL) {
+        return osErrorParameter;
+    }
+    osStatus_t status = osOK;
+    pthread_mutex_lock(&semaphore->lock);
+    if (semaphore->count < semaphore->max_count) {
+        semaphore->count++;
+        pthread_cond_signal(&semaphore->cond);
+    } else {
+        status = osErrorResource;
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return status;
+}
+
+uint32_t osSemaphoreGetCount(osSemaphoreId_t semaphore_id) {
+    HostSemaphore *semaphore = semaphore_id;
+    if (semaphore == NULL) {
+        return 0U;
+    }
+    pthread_mutex_lock(&semaphore->lock);
+    const uint32_t count = semaphore->count;
+    pthread_mutex_unlock(&semaphore->lock);
+    return count;
+}
+
+/* Message queues ------------------------------------------------------------*/
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t *attr) {
+    if (msg_count == 0U || msg_size == 0U) {
+        return NULL;
+    }
+    HostQueue *queue = calloc(1, sizeof *queue);
+    assert(queue != NULL);
+    queue->name = (attr && attr->name) ? attr->name : "queue";
+    queue->storage = calloc(msg_count, msg_size);
+    assert(queue->storage != NULL);
+    queue->msg_size = msg_size;
+    queue->capacity = msg_count;
+    pthread_mutex_init(&queue->lock, NULL);
+    init_cond(&queue->not_empty);
+    init_cond(&queue->not_full);
+
+    pthread_mutex_lock(&kernel.lock);
+    if (kernel.queue_count < HOST_RTOS_MAX_QUEUES) {
+        kernel.queues[kernel.queue_count++] = queue;
+    }
+    pthread_mutex_unlock(&kernel.lock);
+    return queue;
+}
+
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void *msg_ptr, uint8_t msg_prio, uint32_t timeout) {
+    (void) msg_prio;
+    HostQueue *queue = mq_id;
+    if (queue == NULL || msg_ptr == NULL) {
+        return osErrorParameter;
+    }
+    const uint64_t deadline_ns = now_ns() + ticks_to_ns(timeout);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity) {
+        if (timeout == 0U || (!wait_until(&queue->not_full, &queue->lock, timeout, deadline_ns) &&
+                              queue->count == queue->capacity)) {
+            queue->put_failures++;
+            pthread_mutex_unlock(&queue->lock);
+            return timeout == 0U ? osErrorResource : osErrorTimeout;
+        }
+    }
+    const uint32_t tail = (queue->head + queue->count) % queue->capacity;
+    memcpy(queue->storage + (size_t) tail * queue->msg_size, msg_ptr, queue->msg_size);
+    queue->count++;
+    queue->puts++;
+    if (queue->count > queue->max_count) {
+        queue->max_count = queue->count;
+    }
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return osOK;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void *msg_ptr, uint8_t *msg_prio, uint32_t timeout) {
+    HostQueue *queue = mq_id;
+    if (queue == NULL || msg_ptr == NULL) {
+        return osErrorParameter;
+    }
+    const uint64_t deadline_ns = now_ns() + ticks_to_ns(timeout);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0U) {
+        if (timeout == 0U || (!wait_until(&queue->not_empty, &queue->lock, timeout, deadline_ns) &&
+                              queue->count == 0U)) {
+            pthread_mutex_unlock(&queue->lock);
+            return timeout == 0U ? osErrorResource : osErrorTimeout;
+        }
+    }
+    memcpy(msg_ptr, queue->storage + (size_t) queue->head * queue->msg_size, queue->msg_size);
+    queue->head = (queue->head + 1U) % queue->capacity;
+    queue->count--;
+    queue->gets++;
+    if (msg_prio != NULL) {
+        *msg_prio = 0U;
+    }
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return osOK;
+}
+
+uint32_t osMessageQueueGetCapacity(osMessageQueueId_t mq_id) {
+    return mq_id ? ((HostQueue *) mq_id)->capacity : 0U;
+}
+
+uint32_t osMessageQueueGetMsgSize(osMessageQueueId_t mq_id) {
+    return mq_id ? ((HostQueue *) mq_id)->msg_size : 0U;
+}
+
+uint32_t osMessageQueueGetCount(osMessageQueueId_t mq_id) {
+    HostQueue *queue = mq_id;
+    if (queue == NULL) {
+        return 0U;
+    }
+    pthread_mutex_lock(&queue->lock);
+    const uint32_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+uint32_t osMessageQueueGetSpace(osMessageQueueId_t mq_id) {
+    return mq_id ? osMessageQueueGetCapacity(mq_id) - osMessageQueueGetCount(mq_id) : 0U;
+}
+
+/* Report --------------------------------------------------------------------*/
+void HostRTOS_PrintReport(void) {
+    const uint64_t wall_ns = now_ns() - kernel.start_ns;
+    pthread_mutex_lock(&kernel.lock);
+    // equal priorities share the CPU in quanta of the host scheduler, not in RTOS ticks
+    struct timespec quantum = {0};
+    sched_rr_get_interval(0, &quantum);
+    printf("run time %.3f s, %s, priorities %s, round-robin quantum %.1f ms\n", (double) wall_ns / 1e9,
+           kernel.config.single_core ? "single core" : "all cores",
+           kernel.priorities_enforced ? "enforced (SCHED_RR)" : "not enforced",
+           (double) quantum.tv_sec * 1e3 + (double) quantum.tv_nsec / 1e6);
+    printf("%-16s %5s %8s %10s %12s %12s %7s\n", "task", "prio", "stack", "wakeups", "lat avg us", "lat max us", "cpu %");
+    for (uint32_t i = 0; i < kernel.thread_count; i++) {
+        HostThread *thread = kernel.threads[i];
+        struct timespec cpu = {0};
+        if (thread->has_cpu_clock) {
+            clock_gettime(thread->cpu_clock, &cpu);
+        }
+        const uint64_t cpu_ns = (uint64_t) cpu.tv_sec * 1000000000ULL + (uint64_t) cpu.tv_nsec;
+        printf("%-16s %5d %8u %10llu %12.1f %12.1f %7.1f\n", thread->name, (int) thread->priority,
+               thread->stack_size, (unsigned long long) thread->wakeups,
+               thread->wakeups ? (double) thread->latency_sum_ns / (double) thread->wakeups / 1000.0 : 0.0,
+               (double) thread->latency_max_ns / 1000.0,
+               wall_ns ? 100.0 * (double) cpu_ns / (double) wall_ns : 0.0);
+    }
+    if (kernel.queue_count > 0U) {
+        printf("%-16s %8s %8s %10s %10s %10s\n", "queue", "capacity", "max", "puts", "gets", "put fails");
+        for (uint32_t i = 0; i < kernel.queue_count; i++) {
+            HostQueue *queue = kernel.queues[i];
+            printf("%-16s %8u %8u %10llu %10llu %10llu\n", queue->name, queue->capacity, queue->max_count,
+                   (unsigned long long) queue->puts, (unsigned long long) queue->gets,
+                   (unsigned long long) queue->put_failures);
+        }
+    }
+    pthread_mutex_unlock(&kernel.lock);
+    fflush(stdout);
+}
+
+void HostRTOS_Run(uint32_t run_ms) {
+    if (kernel.config.single_core) {
+        // the simulation has to end on time even if a task never blocks
+        struct sched_param param = {.sched_priority = sched_get_priority_max(SCHED_RR)};
+        pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+    }
+    osKernelStart();
+    const struct timespec duration = to_timespec((uint64_t) run_ms * 1000000ULL);
+    while (nanosleep(&duration, NULL) == EINTR) {
+    }
+    HostRTOS_PrintReport();
+}
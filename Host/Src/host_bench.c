@@ -0,0 +1,54 @@
+#include "host_bench.h"
+#include "host_sim.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const char *bench_filter = NULL;
+
+static uint64_t cpu_nanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void HostBench_SetFilter(const char *filter) {
+    bench_filter = filter;
+}
+
+void HostBench_PrintHeader(void) {
+    printf("%-32s %10s %12s %12s %10s %10s %12s %10s %10s\n",
+           "benchmark", "iterations", "host ns/op", "sim ns/op", "i2c tx/op", "i2c B/op", "i2c bus us", "uart B/op", "gpio wr/op");
+}
+
+double HostBench_Run(const char *name, HostBench_Fn_t fn, void *ctx, uint32_t iterations) {
+    if (bench_filter != NULL && strstr(name, bench_filter) == NULL) {
+        return 0.0;
+    }
+
+    // one warm-up call so that lazy initialization does not show up in the numbers
+    fn(ctx);
+
+    HostI2C_ResetStats();
+    HostUART_ResetStats();
+    HostGPIO_ResetWriteCount();
+    const uint64_t start = cpu_nanos();
+    const uint64_t sim_start = HostSim_Nanos();
+    for (uint32_t i = 0; i < iterations; i++) {
+        fn(ctx);
+    }
+    const uint64_t elapsed = cpu_nanos() - start;
+    const uint64_t sim_elapsed = HostSim_Nanos() - sim_start;
+    const HostI2C_Stats i2c = HostI2C_GetStats();
+    const HostUART_Stats uart = HostUART_GetStats();
+
+    printf("%-32s %10u %12.1f %12.1f %10.1f %10.1f %12.1f %10.1f %10.1f\n", name, iterations,
+           (double) elapsed / iterations,
+           (double) sim_elapsed / iterations,
+           (double) i2c.transactions / iterations,
+           (double) i2c.bytes / iterations,
+           (double) i2c.bus_ns / 1000.0 / iterations,
+           (double) uart.bytes / iterations,
+           (double) HostGPIO_GetWriteCount() / iterations);
+    return (double) elapsed / iterations;
+}
@@ -0,0 +1,76 @@
+#include "host_board.h"
+#include "main.h"
+#include "hcsr04.h"
+#include "af_motor_shield.h"
+#include "wheel_control.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+I2C_HandleTypeDef hi2c1;
+TIM_HandleTypeDef htim2;
+TIM_HandleTypeDef htim4;
+TIM_HandleTypeDef htim6;
+TIM_HandleTypeDef htim8;
+TIM_HandleTypeDef htim15;
+TIM_HandleTypeDef htim16;
+UART_HandleTypeDef huart2;
+
+HostBoard host_board;
+
+// As in main.c, less the HAL tick that the host clock provides
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
+    HCSR04_PeriodElapsedCallback(htim);
+    AFMotorShield_PeriodElapsedCallback(htim);
+    WheelControl_PeriodElapsedCallback(htim);
+}
+
+void Error_Handler(void) {
+    fprintf(stderr, "Error_Handler called\n");
+    abort();
+}
+
+void HostBoard_Init(void) {
+    hi2c1.Instance = I2C1;
+    hi2c1.Init.Timing = 0x2000090E;
+    huart2.Instance = USART2;
+    huart2.Init.BaudRate = 115200;
+
+    htim2.Instance = TIM2;
+    htim2.Init.Period = 4294967295;
+    TIM2->ARR = 4294967295;
+    htim4.Instance = TIM4;
+    htim4.Init.Period = 65535;
+    TIM4->ARR = 65535;
+    htim6.Instance = TIM6;
+    htim6.Init.Prescaler = 72 - 1;
+    htim6.Init.Period = 1000 - 1;
+    TIM6->PSC = 72 - 1;
+    TIM6->ARR = 1000 - 1;
+    htim8.Instance = TIM8;
+    htim8.Init.Prescaler = 72 - 1;
+    htim8.Init.Period = 256 - 1;
+    TIM8->PSC = 72 - 1;
+    TIM8->ARR = 256 - 1;
+    TIM8->CCR1 = 64 - 1;
+    htim15.Instance = TIM15;
+    htim15.Init.Prescaler = 8 - 1;
+    htim15.Init.Period = 65535;
+    htim16.Instance = TIM16;
+    htim16.Init.Prescaler = 72 - 1;
+    htim16.Init.Period = 11;
+    // what HAL_TIM_OnePulse_Init and HAL_TIM_PWM_ConfigChannel leave in the registers
+    TIM16->CR1 = TIM_CR1_OPM;
+    TIM16->PSC = 72 - 1;
+    TIM16->ARR = 11;
+    TIM16->CCR1 = 1;
+
+    HostBME280_Init(&host_board.bme280);
+    HostI2C_Attach(&hi2c1, 0xEC, &host_board.bme280.dev);
+    HostSSD1306_Init(&host_board.ssd1306);
+    HostI2C_Attach(&hi2c1, 0x3C << 1, &host_board.ssd1306.dev);
+    HostHCSR04_Init(&host_board.hcsr04, &htim16, &htim15, TIM_CHANNEL_1);
+    HostShiftRegister_Init(&host_board.latch, MOTORLATCH_GPIO_Port, MOTORLATCH_Pin, MOTORCLK_GPIO_Port, MOTORCLK_Pin,
+                           MOTORDATA_GPIO_Port, MOTORDATA_Pin);
+    HostDCMotor_Init(&host_board.motor3, &host_board.latch, MOTOR3_A, MOTOR3_B, &htim8, TIM_CHANNEL_1, &htim2);
+    HostDCMotor_Init(&host_board.motor4, &host_board.latch, MOTOR4_A, MOTOR4_B, &htim8, TIM_CHANNEL_2, &htim4);
+}
@@ -0,0 +1,403 @@
+/*
+ * Behavioural models of the devices wired to the Nucleo board: BME280 and SSD1306 on I2C,
+ * the HC-SR04 echo on a capture timer, the 74HCT595 latch of the motor shield and the DC motors it drives.
+ */
+#include "host_sim.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+/* BME280 --------------------------------------------------------------------*/
+#define HOST_BME280_NVM_COPY_NS 1000000U
+
+static uint32_t host_bme280_oversampling(uint8_t osrs) {
+    return (osrs == 0U) ? 0U : (osrs >= 5U) ? 16U : 1U << (osrs - 1U);
+}
+
+// Typical measurement time of the datasheet (appendix B), 1 ms + 2 ms per conversion + 0.5 ms per P and H
+static uint64_t host_bme280_measurement_ns(const HostBME280 *self) {
+    const uint32_t t = host_bme280_oversampling(self->regs[0xF4] >> 5U);
+    const uint32_t p = host_bme280_oversampling((self->regs[0xF4] >> 2U) & 0x07U);
+    const uint32_t h = host_bme280_oversampling(self->regs[0xF2] & 0x07U);
+    return 1000000ULL + 2000000ULL * t + (p ? 2000000ULL * p + 500000ULL : 0U) + (h ? 2000000ULL * h + 500000ULL : 0U);
+}
+
+static void host_bme280_write(HostI2C_Device *dev, uint16_t mem_addr, const uint8_t *data, uint16_t size) {
+    HostBME280 *self = (HostBME280 *) dev;
+    for (uint16_t i = 0; i < size; i++) {
+        const uint8_t reg = (uint8_t) (mem_addr + i);
+        if (reg == 0xE0) {
+            // soft reset, the register itself always reads 0
+            if (data[i] == 0xB6) {
+                self->regs[0xF2] = self->regs[0xF4] = self->regs[0xF5] = 0;
+                self->measuring_until_ns = 0;
+                self->nvm_copy_until_ns = HostSim_Nanos() + HOST_BME280_NVM_COPY_NS;
+            }
+            continue;
+        }
+        self->regs[reg] = data[i];
+        const uint8_t mode = self->regs[0xF4] & 0x03U;
+        if (reg == 0xF4 && (mode == 0x01U || mode == 0x02U)) {
+            self->measuring_until_ns = HostSim_Nanos() + host_bme280_measurement_ns(self);
+        }
+    }
+}
+
+static void host_bme280_read(HostI2C_Device *dev, uint16_t mem_addr, uint8_t *data, uint16_t size) {
+    HostBME280 *self = (HostBME280 *) dev;
+    const uint64_t now = HostSim_Nanos();
+    const uint8_t mode = self->regs[0xF4] & 0x03U;
+    if ((mode == 0x01U || mode == 0x02U) && now >= self->measuring_until_ns) {
+        // back to sleep after the forced measurement
+        self->regs[0xF4] &= (uint8_t) ~0x03U;
+    }
+    self->regs[0xF3] = (uint8_t) ((now < self->measuring_until_ns ? 0x08U : 0U) |
+                                  (now < self->nvm_copy_until_ns ? 0x01U : 0U));
+    for (uint16_t i = 0; i < size; i++) {
+        data[i] = self->regs[(uint8_t) (mem_addr + i)];
+    }
+    self->reads++;
+}
+
+static void put_le16(uint8_t *regs, uint8_t reg, uint16_t value) {
+    regs[reg] = value & 0xFF;
+    regs[reg + 1] = value >> 8;
+}
+
+void HostBME280_Init(HostBME280 *self) {
+    memset(self, 0, sizeof *self);
+    self->dev.write = host_bme280_write;
+    self->dev.read = host_bme280_read;
+    self->regs[0xD0] = 0x60;
+
+    // compensation parameters from the datasheet example (section 8.1) and a typical humidity trimming
+    put_le16(self->regs, 0x88, 27504);
+    put_le16(self->regs, 0x8A, 26435);
+    put_le16(self->regs, 0x8C, (uint16_t) -1000);
+    put_le16(self->regs, 0x8E, 36477);
+    put_le16(self->regs, 0x90, (uint16_t) -10685);
+    put_le16(self->regs, 0x92, 3024);
+    put_le16(self->regs, 0x94, 2855);
+    put_le16(self->regs, 0x96, 140);
+    put_le16(self->regs, 0x98, (uint16_t) -7);
+    put_le16(self->regs, 0x9A, 15500);
+    put_le16(self->regs, 0x9C, (uint16_t) -14600);
+    put_le16(self->regs, 0x9E, 6000);
+    self->regs[0xA1] = 75;                                  // dig_H1
+    put_le16(self->regs, 0xE1, 362);                        // dig_H2
+    self->regs[0xE3] = 0;                                   // dig_H3
+    const int16_t h4 = 324, h5 = 50;
+    self->regs[0xE4] = (uint8_t) (h4 >> 4);
+    self->regs[0xE5] = (uint8_t) ((h4 & 0x0F) | ((h5 & 0x0F) << 4));
+    self->regs[0xE6] = (uint8_t) (h5 >> 4);
+    self->regs[0xE7] = 30;                                  // dig_H6
+
+    HostBME280_SetRaw(self, 519888, 415148, 30000);
+}
+
+void HostBME280_SetRaw(HostBME280 *self, int32_t t_raw, int32_t p_raw, int32_t h_raw) {
+    self->regs[0xF7] = (uint8_t) (p_raw >> 12);
+    self->regs[0xF8] = (uint8_t) (p_raw >> 4);
+    self->regs[0xF9] = (uint8_t) ((p_raw & 0x0F) << 4);
+    self->regs[0xFA] = (uint8_t) (t_raw >> 12);
+    self->regs[0xFB] = (uint8_t) (t_raw >> 4);
+    self->regs[0xFC] = (uint8_t) ((t_raw & 0x0F) << 4);
+    self->regs[0xFD] = (uint8_t) (h_raw >> 8);
+    self->regs[0xFE] = (uint8_t) h_raw;
+}
+
+/* SSD1306 -------------------------------------------------------------------*/
+static uint8_t ssd1306_argument_count(uint8_t cmd) {
+    switch (cmd) {
+        case 0x21:
+        case 0x22:
+            return 2;
+        case 0x20:
+        case 0x81:
+        case 0x8D:
+        case 0xA8:
+        case 0xD3:
+        case 0xD5:
+        case 0xD9:
+        case 0xDA:
+        case 0xDB:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void ssd1306_execute(HostSSD1306 *self, uint8_t cmd) {
+    if (cmd == 0x20) {
+        self->addressing_mode = self->args[0] & 0x03;
+    } else if (cmd == 0x21) {
+        self->column_start = self->args[0] & 0x7F;
+        self->column_end = self->args[1] & 0x7F;
+        self->column = self->column_start;
+    } else if (cmd == 0x22) {
+        self->page_start = self->args[0] & 0x07;
+        self->page_end = self->args[1] & 0x07;
+        self->page = self->page_start;
+    } else if (cmd == 0xAE || cmd == 0xAF) {
+        self->on = (cmd == 0xAF);
+    } else if (cmd >= 0xB0 && cmd <= 0xB7) {
+        self->page = cmd & 0x07;
+    } else if (cmd <= 0x0F) {
+        self->column = (self->column & 0xF0) | cmd;
+    } else if (cmd >= 0x10 && cmd <= 0x17) {
+        self->column = (self->column & 0x0F) | ((cmd & 0x07) << 4);
+    }
+}
+
+static void ssd1306_command(HostSSD1306 *self, uint8_t byte) {
+    self->commands++;
+    if (self->pending_args > 0) {
+        const uint8_t total = ssd1306_argument_count(self->pending_cmd);
+        self->args[total - self->pending_args] = byte;
+        if (--self->pending_args == 0) {
+            ssd1306_execute(self, self->pending_cmd);
+        }
+        return;
+    }
+    self->pending_cmd = byte;
+    self->pending_args = ssd1306_argument_count(byte);
+    if (self->pending_args == 0) {
+        ssd1306_execute(self, byte);
+    }
+}
+
+static void ssd1306_data(HostSSD1306 *self, uint8_t byte) {
+    self->data_bytes++;
+    self->gddram[self->page * HOST_SSD1306_COLUMNS + self->column] = byte;
+    switch (self->addressing_mode) {
+        case 0x00: // horizontal
+            if (self->column++ >= self->column_end) {
+                self->column = self->column_start;
+                self->page = (self->page >= self->page_end) ? self->page_start : self->page + 1;
+            }
+            break;
+        case 0x01: // vertical
+            if (self->page++ >= self->page_end) {
+                self->page = self->page_start;
+                self->column = (self->column >= self->column_end) ? self->column_start : self->column + 1;
+            }
+            break;
+        default: // page addressing
+            self->column = (self->column + 1) % HOST_SSD1306_COLUMNS;
+            break;
+    }
+}
+
+static void host_ssd1306_write(HostI2C_Device *dev, uint16_t mem_addr, const uint8_t *data, uint16_t size) {
+    HostSSD1306 *self = (HostSSD1306 *) dev;
+    for (uint16_t i = 0; i < size; i++) {
+        if (mem_addr == 0x40) {
+            ssd1306_data(self, data[i]);
+        } else {
+            ssd1306_command(self, data[i]);
+        }
+    }
+}
+
+static void host_ssd1306_read(HostI2C_Device *dev, uint16_t mem_addr, uint8_t *data, uint16_t size) {
+    (void) dev;
+    (void) mem_addr;
+    memset(data, 0, size);
+}
+
+void HostSSD1306_Init(HostSSD1306 *self) {
+    memset(self, 0, sizeof *self);
+    self->dev.write = host_ssd1306_write;
+    self->dev.read = host_ssd1306_read;
+    self->addressing_mode = 0x02;
+    self->page_end = HOST_SSD1306_PAGES - 1;
+    self->column_end = HOST_SSD1306_COLUMNS - 1;
+}
+
+/* HC-SR04 -------------------------------------------------------------------*/
+// The module sends its 40 kHz burst after the trigger and raises the echo line once the burst is out
+#define HOST_HCSR04_BURST_NS 200000U
+// Echo pulse when nothing reflects the burst
+#define HOST_HCSR04_NO_OBSTACLE_NS 38000000U
+#define HOST_HCSR04_MAX_DISTANCE_M 4.0f
+#define HOST_HCSR04_MAX_MODULES 8
+
+// Every module, to tell which bursts could be heard by another module
+static HostHCSR04 *hcsr04_modules[HOST_HCSR04_MAX_MODULES];
+
+/* Runs from the interrupt thread: the capture unit latched the counter at the echo edge, however late the
+ * interrupt thread gets to it
+ */
+static void host_hcsr04_capture(HostHCSR04 *self, uint64_t edge_ns) {
+    TIM_HandleTypeDef *htim = self->htim;
+    HostTIM_ServeOverflowsUntil(htim, edge_ns);
+    volatile uint32_t *ccr = &htim->Instance->CCR1 + (self->channel >> 2U);
+    *ccr = HostTim_GetCounterAt(htim, edge_ns);
+    htim->Channel = (HAL_TIM_ActiveChannel) (1U << (self->channel >> 2U));
+    HAL_TIM_IC_CaptureCallback(htim);
+    htim->Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+}
+
+static void host_hcsr04_echo_rise(void *ctx) {
+    HostHCSR04 *self = ctx;
+    host_hcsr04_capture(self, self->echo_ns);
+}
+
+static void host_hcsr04_echo_fall(void *ctx) {
+    HostHCSR04 *self = ctx;
+    host_hcsr04_capture(self, self->busy_until_ns);
+    self->echoes++;
+}
+
+// The module starts its burst on the falling edge of the trigger pulse
+static void host_hcsr04_on_pulse(void *ctx, TIM_HandleTypeDef *htim, uint64_t rising_ns, uint64_t falling_ns) {
+    HostHCSR04 *self = ctx;
+    (void) rising_ns;
+    // a trigger while the echo line is still high is ignored
+    if (htim != self->trigger_htim || falling_ns < self->busy_until_ns) {
+        return;
+    }
+
+    uint64_t width_ns = HOST_HCSR04_NO_OBSTACLE_NS;
+    if (self->distance_m <= HOST_HCSR04_MAX_DISTANCE_M) {
+        width_ns = (uint64_t) (2.0 * self->distance_m / self->speed_of_sound_ms * 1e9);
+    }
+    for (size_t i = 0; i < HOST_HCSR04_MAX_MODULES && hcsr04_modules[i] != NULL; i++) {
+        if (hcsr04_modules[i] != self && hcsr04_modules[i]->busy_until_ns > falling_ns) {
+            self->crosstalk++;
+            break;
+        }
+    }
+    self->echo_ns = falling_ns + HOST_HCSR04_BURST_NS;
+    self->busy_until_ns = self->echo_ns + width_ns;
+    HostIRQ_Schedule(self->echo_ns, host_hcsr04_echo_rise, self);
+    HostIRQ_Schedule(self->busy_until_ns, host_hcsr04_echo_fall, self);
+}
+
+void HostHCSR04_Init(HostHCSR04 *self, TIM_HandleTypeDef *trigger_htim, TIM_HandleTypeDef *htim, uint32_t channel) {
+    memset(self, 0, sizeof *self);
+    self->trigger_htim = trigger_htim;
+    self->htim = htim;
+    self->channel = channel;
+    self->distance_m = 1.0f;
+    self->speed_of_sound_ms = 343.0f;
+    HostTIM_AddPulseListener(host_hcsr04_on_pulse, self);
+    for (size_t i = 0; i < HOST_HCSR04_MAX_MODULES; i++) {
+        if (hcsr04_modules[i] == NULL || hcsr04_modules[i] == self) {
+            hcsr04_modules[i] = self;
+            return;
+        }
+    }
+    assert(false && "Too many HC-SR04 modules");
+}
+
+/* 74HCT595 ------------------------------------------------------------------*/
+static bool rising_edge(GPIO_TypeDef *GPIOx, uint16_t pins, uint32_t old_odr, uint32_t new_odr,
+                        GPIO_TypeDef *port, uint16_t pin) {
+    return GPIOx == port && (pins & pin) && !(old_odr & pin) && (new_odr & pin);
+}
+
+static void host_shift_register_on_gpio(void *ctx, GPIO_TypeDef *GPIOx, uint16_t pins, uint32_t old_odr, uint32_t new_odr) {
+    HostShiftRegister *self = ctx;
+    if (rising_edge(GPIOx, pins, old_odr, new_odr, self->clk_port, self->clk_pin)) {
+        const uint8_t bit = (self->data_port->ODR & self->data_pin) ? 1 : 0;
+        self->shift = (uint8_t) ((self->shift << 1) | bit);
+    }
+    if (rising_edge(GPIOx, pins, old_odr, new_odr, self->latch_port, self->latch_pin)) {
+        self->output = self->shift;
+        self->latches++;
+    }
+}
+
+void HostShiftRegister_Init(HostShiftRegister *self, GPIO_TypeDef *latch_port, uint16_t latch_pin,
+                            GPIO_TypeDef *clk_port, uint16_t clk_pin, GPIO_TypeDef *data_port, uint16_t data_pin) {
+    memset(self, 0, sizeof *self);
+    self->latch_port = latch_port;
+    self->latch_pin = latch_pin;
+    self->clk_port = clk_port;
+    self->clk_pin = clk_pin;
+    self->data_port = data_port;
+    self->data_pin = data_pin;
+    HostGPIO_AddListener(host_shift_register_on_gpio, self);
+}
+
+/* DC motor ------------------------------------------------------------------*/
+// Step of the integration, well below the mechanical time constant of some 50 ms
+#define HOST_DC_MOTOR_STEP_NS 20000U
+
+static double host_dc_motor_duty(const HostDCMotor *self) {
+    const TIM_TypeDef *tim = self->pwm_htim->Instance;
+    const double compare = (double) *(&tim->CCR1 + (self->pwm_channel >> 2U));
+    return fmin(compare / ((double) tim->ARR + 1.0), 1.0);
+}
+
+// Torque of the windings averaged over a PWM period; coasting carries no current
+static double host_dc_motor_torque(const HostDCMotor *self, double duty) {
+    const bool a = self->latch->output & (1U << self->bit_a);
+    const bool b = self->latch->output & (1U << self->bit_b);
+    const double back_emf_v = self->k_v_s * self->speed_rad_s;
+    double drive_v;
+    if (a && !b) {
+        drive_v = self->supply_v;
+    } else if (b && !a) {
+        drive_v = -self->supply_v;
+    } else if (a && b) {
+        // brake: both outputs high short the motor while enabled
+        drive_v = 0.0;
+    } else {
+        return 0.0;
+    }
+    return duty * self->k_v_s * (drive_v - back_emf_v) / self->resistance_ohm;
+}
+
+static void host_dc_motor_step(HostDCMotor *self, double duty, double dt_s) {
+    const double torque = host_dc_motor_torque(self, duty) - self->viscous_n_m_s * self->speed_rad_s;
+    const double resisting = self->friction_n_m + self->load_n_m;
+    double speed = self->speed_rad_s;
+    if (speed == 0.0 && fabs(torque) <= resisting) {
+        return;
+    }
+    const double direction = (speed != 0.0) ? copysign(1.0, speed) : copysign(1.0, torque);
+    speed += (torque - direction * resisting) / self->inertia_kg_m2 * dt_s;
+    // friction stops the motor rather than turning it around
+    if (speed * direction < 0.0) {
+        speed = 0.0;
+    }
+    self->angle_rad += (self->speed_rad_s + speed) / 2.0 * dt_s;
+    self->speed_rad_s = speed;
+}
+
+void HostDCMotor_Init(HostDCMotor *self, const HostShiftRegister *latch, uint8_t bit_a, uint8_t bit_b,
+                      TIM_HandleTypeDef *pwm_htim, uint32_t pwm_channel, TIM_HandleTypeDef *encoder_htim) {
+    *self = (HostDCMotor) {
+            .latch = latch,
+            .bit_a = bit_a,
+            .bit_b = bit_b,
+            .pwm_htim = pwm_htim,
+            .pwm_channel = pwm_channel,
+            .encoder_htim = encoder_htim,
+            .supply_v = 6.0,
+            .resistance_ohm = 4.0,
+            .k_v_s = 0.0055,
+            .inertia_kg_m2 = 5e-7,
+            .viscous_n_m_s = 2.5e-6,
+            .friction_n_m = 0.4e-3,
+            .counts_per_rad = 48.0 / (2.0 * M_PI),
+            .time_ns = HostSim_Nanos(),
+    };
+}
+
+void HostDCMotor_Advance(HostDCMotor *self) {
+    const uint64_t now_ns = HostSim_Nanos();
+    const double duty = host_dc_motor_duty(self);
+    while (self->time_ns < now_ns) {
+        const uint64_t step_ns = (now_ns - self->time_ns < HOST_DC_MOTOR_STEP_NS) ? now_ns - self->time_ns
+                                                                                 : HOST_DC_MOTOR_STEP_NS;
+        host_dc_motor_step(self, duty, (double) step_ns / 1e9);
+        self->time_ns += step_ns;
+    }
+    // the counter wraps at Init.Period like the timer
+    const int64_t counts = (int64_t) floor(self->angle_rad * self->counts_per_rad);
+    const uint64_t span = (uint64_t) self->encoder_htim->Init.Period + 1U;
+    self->encoder_htim->Instance->CNT = (uint32_t) (((counts % (int64_t) span) + (int64_t) span) % (int64_t) span);
+}
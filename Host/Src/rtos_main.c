@@ -0,0 +1,124 @@
+/*
+ * The task set of main.c on the host RTOS (cmsis_os2_host.c) with the simulated board of host_board.h.
+ * Runs for the given number of seconds and prints wake-up latency and CPU share per task,
+ * followed by the occupancy of the I2C bus and the timing of the motion task.
+ * The wheel speed loop is not served here, so the wheels get their setpoints but do not turn.
+ * --capture writes the console output (binary telemetry, see telemetry.h) to a file for my_sensors_telemetry.
+ *
+ * Usage: my_sensors_rtos [seconds] [--all-cores] [--capture file]
+ */
+#include "main.h"
+#include "cmsis_os2.h"
+#include "app.h"
+#include "host_board.h"
+#include "host_rtos.h"
+#include "console.h"
+#include "i2c_bus.h"
+#include "af_motor_shield.h"
+#include "wheel_control.h"
+#include "motion.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Same attributes as in main.c */
+static const osThreadAttr_t blinkLed_attributes = {
+        .name = "blinkLed",
+        .stack_size = 128 * 4,
+        .priority = (osPriority_t) osPriorityNormal,
+};
+static const osThreadAttr_t i2cBusUsersTask_attributes = {
+        .name = "i2cBusUsersTask",
+        .stack_size = 512 * 4,
+        .priority = (osPriority_t) osPriorityNormal,
+};
+static const osThreadAttr_t motionTask_attributes = {
+        .name = "motionTask",
+        .stack_size = 256 * 4,
+        .priority = (osPriority_t) osPriorityHigh,
+};
+
+static void StartBlinkLed(void *argument) {
+    (void) argument;
+    App_RunBlinkLed();
+}
+
+static void Starti2cUsersTask(void *argument) {
+    (void) argument;
+    App_RunI2cUsers();
+}
+
+static void StartMotionTask(void *argument) {
+    (void) argument;
+    App_RunMotion();
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds = 5;
+    HostRTOS_Config config = {.single_core = true};
+    FILE *capture = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--all-cores") == 0) {
+            config.single_core = false;
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture = fopen(argv[++i], "wb");
+            if (capture == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else {
+            seconds = (uint32_t) strtoul(argv[i], NULL, 10);
+        }
+    }
+
+    HostUART_SetEcho(false);
+    HostUART_SetCapture(capture);
+    HostSim_SetRealTimeDelays(true);
+    HostBoard_Init();
+    // the motors and wheels of main.c
+    AFMotorShield *motor3 = AFMotorShield_InitDCMotor(MOTOR_3, 4, (AFMotorShieldPeripheral) {
+            .htim = &htim8,
+            .channel = TIM_CHANNEL_1
+    });
+    AFMotorShield *motor4 = AFMotorShield_InitDCMotor(MOTOR_4, 4, (AFMotorShieldPeripheral) {
+            .htim = &htim8,
+            .channel = TIM_CHANNEL_2
+    });
+    WheelControl *const wheels[] = {
+            WheelControl_Init((WheelControlPeripheral) {.encoder_htim = &htim2, .motor = motor3},
+                              WHEEL_CONTROL_GEAR_MOTOR_GAINS),
+            WheelControl_Init((WheelControlPeripheral) {.encoder_htim = &htim4, .motor = motor4},
+                              WHEEL_CONTROL_GEAR_MOTOR_GAINS),
+    };
+
+    HostRTOS_Configure(&config);
+    osKernelInitialize();
+    Motion_Init(wheels, sizeof wheels / sizeof wheels[0]);
+    const osThreadId_t threads[] = {
+            osThreadNew(StartBlinkLed, NULL, &blinkLed_attributes),
+            osThreadNew(Starti2cUsersTask, NULL, &i2cBusUsersTask_attributes),
+            osThreadNew(StartMotionTask, NULL, &motionTask_attributes),
+    };
+    for (size_t i = 0; i < sizeof threads / sizeof threads[0]; i++) {
+        assert(threads[i] != NULL);
+    }
+    HostRTOS_Run(seconds * 1000U);
+
+    const HostI2C_Stats bus = HostI2C_GetStats();
+    const I2CBus_Stats queue = I2CBus_GetStats(&hi2c1);
+    printf("\nI2C bus: %u transactions, %.0f B/s, busy %.1f %%, max %u queued, %u errors\n",
+           queue.transactions, (double) bus.bytes / seconds, (double) bus.bus_ns / 1e7 / seconds,
+           queue.max_pending, queue.errors);
+    const Console_Stats console = Console_GetStats();
+    printf("Console: %.0f B/s queued, %u B dropped, %u of %u B buffered at most\n", (double) console.bytes / seconds,
+           console.dropped_bytes, console.max_used, CONSOLE_TX_BUFFER_SIZE);
+    const Motion_Stats motion = Motion_GetStats();
+    printf("Motion: %u segments played, %u rejected, ticks up to %u ms late\n", motion.segments, motion.rejected,
+           motion.max_late_ms);
+    if (capture != NULL) {
+        HostUART_SetCapture(NULL);
+        fclose(capture);
+    }
+    return 0;
+}
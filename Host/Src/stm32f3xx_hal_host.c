@@ -0,0 +1,738 @@
+/*
+ * Host implementation of the HAL subset declared in Host/Inc/stm32f3xx_hal.h.
+ *
+ * Peripherals have no real side effects: I2C transfers are routed to the device models attached with
+ * HostI2C_Attach(), UART output is optionally echoed to stdout, and GPIO writes and one-pulse timer outputs
+ * are reported to listeners.
+ * Bus and line occupancy is accounted for, so the cost of a driver call can be expressed in the
+ * time it would keep the real bus busy.
+ *
+ * The calls are serialized with one lock, so the models can be driven from several RTOS threads.
+ * Interrupts are simulated by one high-priority thread that runs the handlers scheduled with
+ * HostIRQ_Schedule() at their simulation time, with the interrupt lock (__disable_irq()) held.
+ * DMA transfers complete from such an interrupt once the bus would have finished them.
+ */
+#include "stm32f3xx_hal.h"
+#include "host_sim.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+
+#define HOST_MAX_I2C_DEVICES    8
+#define HOST_MAX_I2C_BUSES      2
+#define HOST_MAX_GPIO_LISTENERS 8
+#define HOST_MAX_TIM_LISTENERS 8
+#define HOST_MAX_PENDING_IRQS   32
+
+uint32_t SystemCoreClock = 72000000U;
+
+GPIO_TypeDef HostGPIOA, HostGPIOB, HostGPIOC, HostGPIOF;
+TIM_TypeDef HostTIM1, HostTIM2, HostTIM3, HostTIM4, HostTIM6, HostTIM8, HostTIM15, HostTIM16, HostTIM17;
+int HostI2C1, HostI2C2;
+int HostUSART2;
+
+static pthread_mutex_t hal_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Clock ---------------------------------------------------------------------*/
+static struct {
+    uint64_t start_ns;
+    uint64_t skipped_ns;
+    bool started;
+    bool real_time_delays;
+} sim_clock;
+
+static uint64_t host_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+uint64_t HostSim_Nanos(void) {
+    if (!sim_clock.started) {
+        sim_clock.start_ns = host_monotonic_ns();
+        sim_clock.started = true;
+    }
+    return host_monotonic_ns() - sim_clock.start_ns + __atomic_load_n(&sim_clock.skipped_ns, __ATOMIC_RELAXED);
+}
+
+uint64_t HostSim_Micros(void) {
+    return HostSim_Nanos() / 1000U;
+}
+
+void HostSim_Advance(uint64_t ns) {
+    __atomic_fetch_add(&sim_clock.skipped_ns, ns, __ATOMIC_RELAXED);
+}
+
+void HostSim_SetRealTimeDelays(bool real_time) {
+    sim_clock.real_time_delays = real_time;
+}
+
+void HAL_Delay(uint32_t Delay) {
+    if (!sim_clock.real_time_delays) {
+        HostSim_Advance((uint64_t) Delay * 1000000ULL);
+        return;
+    }
+    // HAL_Delay polls the tick on the target as well
+    const uint64_t deadline = HostSim_Nanos() + (uint64_t) Delay * 1000000ULL;
+    while (HostSim_Nanos() < deadline) {
+    }
+}
+
+uint32_t HAL_GetTick(void) {
+    return (uint32_t) (HostSim_Nanos() / 1000000U);
+}
+
+/* Interrupts ----------------------------------------------------------------*/
+static pthread_once_t irq_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t irq_lock;
+static pthread_mutex_t irq_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t irq_queue_cond;
+static struct {
+    uint64_t at_ns;
+    HostIRQ_Handler_t handler;
+    void *ctx;
+} pending_irqs[HOST_MAX_PENDING_IRQS];
+static size_t pending_irq_count;
+
+static void *host_irq_thread(void *arg) {
+    (void) arg;
+    pthread_mutex_lock(&irq_queue_lock);
+    while (true) {
+        if (pending_irq_count == 0) {
+            pthread_cond_wait(&irq_queue_cond, &irq_queue_lock);
+            continue;
+        }
+        size_t next = 0;
+        for (size_t i = 1; i < pending_irq_count; i++) {
+            if (pending_irqs[i].at_ns < pending_irqs[next].at_ns) {
+                next = i;
+            }
+        }
+        const uint64_t now = HostSim_Nanos();
+        if (now < pending_irqs[next].at_ns) {
+            if (sim_clock.real_time_delays) {
+                const uint64_t wake_ns = host_monotonic_ns() + (pending_irqs[next].at_ns - now);
+                const struct timespec deadline = {
+                        .tv_sec = (time_t) (wake_ns / 1000000000ULL),
+                        .tv_nsec = (long) (wake_ns % 1000000000ULL),
+                };
+                pthread_cond_timedwait(&irq_queue_cond, &irq_queue_lock, &deadline);
+                continue;
+            }
+            HostSim_Advance(pending_irqs[next].at_ns - now);
+        }
+        const HostIRQ_Handler_t handler = pending_irqs[next].handler;
+        void *ctx = pending_irqs[next].ctx;
+        pending_irqs[next] = pending_irqs[--pending_irq_count];
+        pthread_mutex_unlock(&irq_queue_lock);
+
+        pthread_mutex_lock(&irq_lock);
+        handler(ctx);
+        pthread_mutex_unlock(&irq_lock);
+
+        pthread_mutex_lock(&irq_queue_lock);
+    }
+    return NULL;
+}
+
+static void host_irq_setup(void) {
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&irq_lock, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&irq_queue_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, host_irq_thread, NULL) != 0) {
+        assert(false && "Cannot create the interrupt thread");
+    }
+    // interrupts preempt every task; without the permission to do so they are merely not starved
+    const struct sched_param param = {.sched_priority = sched_get_priority_max(SCHED_FIFO)};
+    pthread_setschedparam(thread, SCHED_FIFO, &param);
+    pthread_detach(thread);
+}
+
+void HostIRQ_Schedule(uint64_t at_ns, HostIRQ_Handler_t handler, void *ctx) {
+    pthread_once(&irq_once, host_irq_setup);
+    pthread_mutex_lock(&irq_queue_lock);
+    assert(pending_irq_count < HOST_MAX_PENDING_IRQS && "Too many pending interrupts");
+    pending_irqs[pending_irq_count].at_ns = at_ns;
+    pending_irqs[pending_irq_count].handler = handler;
+    pending_irqs[pending_irq_count].ctx = ctx;
+    pending_irq_count++;
+    pthread_cond_signal(&irq_queue_cond);
+    pthread_mutex_unlock(&irq_queue_lock);
+}
+
+void HostIRQ_Disable(void) {
+    pthread_once(&irq_once, host_irq_setup);
+    pthread_mutex_lock(&irq_lock);
+}
+
+void HostIRQ_Enable(void) {
+    pthread_mutex_unlock(&irq_lock);
+}
+
+/* GPIO ----------------------------------------------------------------------*/
+static struct {
+    HostGPIO_Listener_t listener;
+    void *ctx;
+} gpio_listeners[HOST_MAX_GPIO_LISTENERS];
+static uint32_t gpio_write_count;
+
+void HostGPIO_AddListener(HostGPIO_Listener_t listener, void *ctx) {
+    for (size_t i = 0; i < HOST_MAX_GPIO_LISTENERS; i++) {
+        if (gpio_listeners[i].listener == NULL) {
+            gpio_listeners[i].listener = listener;
+            gpio_listeners[i].ctx = ctx;
+            return;
+        }
+    }
+    assert(false && "Too many GPIO listeners");
+}
+
+uint32_t HostGPIO_GetWriteCount(void) {
+    return gpio_write_count;
+}
+
+void HostGPIO_ResetWriteCount(void) {
+    gpio_write_count = 0;
+}
+
+// Called with hal_lock held
+static void host_gpio_update(GPIO_TypeDef *GPIOx, uint16_t pins, uint32_t new_odr) {
+    const uint32_t old_odr = GPIOx->ODR;
+    GPIOx->ODR = new_odr;
+    gpio_write_count++;
+    for (size_t i = 0; i < HOST_MAX_GPIO_LISTENERS && gpio_listeners[i].listener; i++) {
+        gpio_listeners[i].listener(gpio_listeners[i].ctx, GPIOx, pins, old_odr, new_odr);
+    }
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    pthread_mutex_lock(&hal_lock);
+    const uint32_t odr = (PinState == GPIO_PIN_SET) ? (GPIOx->ODR | GPIO_Pin) : (GPIOx->ODR & ~(uint32_t) GPIO_Pin);
+    host_gpio_update(GPIOx, GPIO_Pin, odr);
+    pthread_mutex_unlock(&hal_lock);
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    pthread_mutex_lock(&hal_lock);
+    host_gpio_update(GPIOx, GPIO_Pin, GPIOx->ODR ^ GPIO_Pin);
+    pthread_mutex_unlock(&hal_lock);
+}
+
+void HostReg_Write(volatile uint32_t *reg, uint32_t value) {
+    GPIO_TypeDef *const ports[] = {GPIOA, GPIOB, GPIOC, GPIOF};
+    for (size_t i = 0; i < sizeof ports / sizeof ports[0]; i++) {
+        GPIO_TypeDef *GPIOx = ports[i];
+        if (reg == &GPIOx->BSRR || reg == &GPIOx->BRR) {
+            // BSRR: the set half wins over the reset half
+            const uint16_t set = (reg == &GPIOx->BSRR) ? (uint16_t) value : 0U;
+            const uint16_t reset = (reg == &GPIOx->BSRR) ? (uint16_t) (value >> 16U) : (uint16_t) value;
+            pthread_mutex_lock(&hal_lock);
+            host_gpio_update(GPIOx, set | reset, (GPIOx->ODR & ~(uint32_t) reset) | set);
+            pthread_mutex_unlock(&hal_lock);
+            return;
+        }
+    }
+    *reg = value;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+/* I2C -----------------------------------------------------------------------*/
+static struct {
+    I2C_HandleTypeDef *hi2c;
+    uint16_t dev_address;
+    HostI2C_Device *dev;
+} i2c_devices[HOST_MAX_I2C_DEVICES];
+static uint32_t i2c_scl_hz = 100000U;
+static HostI2C_Stats i2c_stats;
+
+void HostI2C_Attach(I2C_HandleTypeDef *hi2c, uint16_t dev_address, HostI2C_Device *dev) {
+    for (size_t i = 0; i < HOST_MAX_I2C_DEVICES; i++) {
+        if (i2c_devices[i].dev == NULL) {
+            i2c_devices[i].hi2c = hi2c;
+            i2c_devices[i].dev_address = dev_address;
+            i2c_devices[i].dev = dev;
+            return;
+        }
+    }
+    assert(false && "Too many I2C devices");
+}
+
+void HostI2C_Detach(I2C_HandleTypeDef *hi2c, uint16_t dev_address) {
+    pthread_mutex_lock(&hal_lock);
+    for (size_t i = 0; i < HOST_MAX_I2C_DEVICES && i2c_devices[i].dev; i++) {
+        if (i2c_devices[i].hi2c == hi2c && i2c_devices[i].dev_address == dev_address) {
+            // the attached devices stay contiguous
+            for (; i + 1 < HOST_MAX_I2C_DEVICES; i++) {
+                i2c_devices[i] = i2c_devices[i + 1];
+            }
+            i2c_devices[HOST_MAX_I2C_DEVICES - 1].dev = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&hal_lock);
+}
+
+void HostI2C_SetClockHz(uint32_t scl_hz) {
+    i2c_scl_hz = scl_hz;
+}
+
+HostI2C_Stats HostI2C_GetStats(void) {
+    return i2c_stats;
+}
+
+void HostI2C_ResetStats(void) {
+    i2c_stats = (HostI2C_Stats) {0};
+}
+
+static HostI2C_Device *host_i2c_find(I2C_HandleTypeDef *hi2c, uint16_t dev_address) {
+    for (size_t i = 0; i < HOST_MAX_I2C_DEVICES && i2c_devices[i].dev; i++) {
+        if (i2c_devices[i].hi2c == hi2c && i2c_devices[i].dev_address == dev_address) {
+            return i2c_devices[i].dev;
+        }
+    }
+    return NULL;
+}
+
+static uint64_t host_i2c_account(uint32_t wire_bytes) {
+    // 9 clocks per byte (8 data bits + ACK) plus START/STOP, which take roughly one clock each
+    const uint64_t bus_ns = ((uint64_t) wire_bytes * 9U + 2U) * 1000000000ULL / i2c_scl_hz;
+    i2c_stats.transactions++;
+    i2c_stats.bytes += wire_bytes;
+    i2c_stats.bus_ns += bus_ns;
+    return bus_ns;
+}
+
+static bool host_i2c_busy(const I2C_HandleTypeDef *hi2c) {
+    return hi2c->State == HAL_I2C_STATE_BUSY_TX || hi2c->State == HAL_I2C_STATE_BUSY_RX;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                    uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    (void) Timeout;
+    pthread_mutex_lock(&hal_lock);
+    if (host_i2c_busy(hi2c)) {
+        pthread_mutex_unlock(&hal_lock);
+        return HAL_BUSY;
+    }
+    HostI2C_Device *dev = host_i2c_find(hi2c, DevAddress);
+    if (dev == NULL) {
+        host_i2c_account(1U);
+        pthread_mutex_unlock(&hal_lock);
+        return HAL_ERROR;
+    }
+    host_i2c_account(1U + MemAddSize + Size);
+    dev->write(dev, MemAddress, pData, Size);
+    pthread_mutex_unlock(&hal_lock);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                   uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    (void) Timeout;
+    pthread_mutex_lock(&hal_lock);
+    if (host_i2c_busy(hi2c)) {
+        pthread_mutex_unlock(&hal_lock);
+        return HAL_BUSY;
+    }
+    HostI2C_Device *dev = host_i2c_find(hi2c, DevAddress);
+    if (dev == NULL) {
+        host_i2c_account(1U);
+        pthread_mutex_unlock(&hal_lock);
+        return HAL_ERROR;
+    }
+    // address + register, repeated START, address again, then the data
+    host_i2c_account(2U + MemAddSize + Size);
+    dev->read(dev, MemAddress, pData, Size);
+    pthread_mutex_unlock(&hal_lock);
+    return HAL_OK;
+}
+
+static struct HostI2C_Transfer {
+    I2C_HandleTypeDef *hi2c;
+    HostI2C_Device *dev;    // NULL when no device acknowledged the address
+    uint16_t mem_addr;
+    uint8_t *data;
+    uint16_t size;
+    bool read;
+} i2c_transfers[HOST_MAX_I2C_BUSES];
+
+// Runs from the interrupt thread: the device sees the data only when the transfer is over, like on the wire
+static void host_i2c_dma_complete(void *ctx) {
+    struct HostI2C_Transfer *transfer = ctx;
+    I2C_HandleTypeDef *hi2c = transfer->hi2c;
+    pthread_mutex_lock(&hal_lock);
+    const bool acknowledged = transfer->dev != NULL;
+    if (acknowledged && transfer->read) {
+        transfer->dev->read(transfer->dev, transfer->mem_addr, transfer->data, transfer->size);
+    } else if (acknowledged) {
+        transfer->dev->write(transfer->dev, transfer->mem_addr, transfer->data, transfer->size);
+    }
+    const bool read = transfer->read;
+    hi2c->ErrorCode = acknowledged ? HAL_I2C_ERROR_NONE : HAL_I2C_ERROR_AF;
+    hi2c->State = HAL_I2C_STATE_READY;
+    pthread_mutex_unlock(&hal_lock);
+
+    if (!acknowledged) {
+        HAL_I2C_ErrorCallback(hi2c);
+    } else if (read) {
+        HAL_I2C_MemRxCpltCallback(hi2c);
+    } else {
+        HAL_I2C_MemTxCpltCallback(hi2c);
+    }
+}
+
+static HAL_StatusTypeDef host_i2c_start_dma(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                            uint16_t MemAddSize, uint8_t *pData, uint16_t Size, bool read) {
+    pthread_mutex_lock(&hal_lock);
+    if (host_i2c_busy(hi2c)) {
+        pthread_mutex_unlock(&hal_lock);
+        return HAL_BUSY;
+    }
+    struct HostI2C_Transfer *transfer = NULL;
+    for (size_t i = 0; i < HOST_MAX_I2C_BUSES && transfer == NULL; i++) {
+        if (i2c_transfers[i].hi2c == hi2c || i2c_transfers[i].hi2c == NULL) {
+            transfer = &i2c_transfers[i];
+        }
+    }
+    assert(transfer != NULL && "Too many I2C buses");
+    transfer->hi2c = hi2c;
+    transfer->dev = host_i2c_find(hi2c, DevAddress);
+    transfer->mem_addr = MemAddress;
+    transfer->data = pData;
+    transfer->size = Size;
+    transfer->read = read;
+
+    uint64_t bus_ns;
+    if (transfer->dev == NULL) {
+        bus_ns = host_i2c_account(1U);
+    } else {
+        bus_ns = host_i2c_account((read ? 2U : 1U) + MemAddSize + Size);
+    }
+    hi2c->State = read ? HAL_I2C_STATE_BUSY_RX : HAL_I2C_STATE_BUSY_TX;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    pthread_mutex_unlock(&hal_lock);
+
+    HostIRQ_Schedule(HostSim_Nanos() + bus_ns, host_i2c_dma_complete, transfer);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                        uint16_t MemAddSize, uint8_t *pData, uint16_t Size) {
+    return host_i2c_start_dma(hi2c, DevAddress, MemAddress, MemAddSize, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData, uint16_t Size) {
+    return host_i2c_start_dma(hi2c, DevAddress, MemAddress, MemAddSize, pData, Size, true);
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(const I2C_HandleTypeDef *hi2c) {
+    return hi2c->State;
+}
+
+uint32_t HAL_I2C_GetError(const I2C_HandleTypeDef *hi2c) {
+    return hi2c->ErrorCode;
+}
+
+/* UART ----------------------------------------------------------------------*/
+static bool uart_echo = true;
+static FILE *uart_capture;
+static HostUART_Stats uart_stats;
+
+void HostUART_SetEcho(bool echo) {
+    uart_echo = echo;
+}
+
+void HostUART_SetCapture(FILE *capture) {
+    pthread_mutex_lock(&hal_lock);
+    uart_capture = capture;
+    pthread_mutex_unlock(&hal_lock);
+}
+
+// Called with hal_lock held once the bytes are on the line
+static void host_uart_output(const uint8_t *data, uint16_t size) {
+    if (uart_echo) {
+        fwrite(data, 1, size, stdout);
+    }
+    if (uart_capture != NULL) {
+        fwrite(data, 1, size, uart_capture);
+    }
+}
+
+HostUART_Stats HostUART_GetStats(void) {
+    return uart_stats;
+}
+
+void HostUART_ResetStats(void) {
+    uart_stats = (HostUART_Stats) {0};
+}
+
+static bool host_uart_busy(const UART_HandleTypeDef *huart) {
+    return huart->gState == HAL_UART_STATE_BUSY_TX;
+}
+
+// Called with hal_lock held; returns the time the line is busy with the bytes
+static uint64_t host_uart_account(const UART_HandleTypeDef *huart, uint16_t size) {
+    const uint32_t baud = huart->Init.BaudRate ? huart->Init.BaudRate : 115200U;
+    // start bit + 8 data bits + stop bit
+    const uint64_t line_ns = (uint64_t) size * 10U * 1000000000ULL / baud;
+    uart_stats.transmits++;
+    uart_stats.bytes += size;
+    uart_stats.line_ns += line_ns;
+    return line_ns;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    (void) Timeout;
+    pthread_mutex_lock(&hal_lock);
+    if (host_uart_busy(huart)) {
+        pthread_mutex_unlock(&hal_lock);
+        return HAL_BUSY;
+    }
+    const uint64_t line_ns = host_uart_account(huart, Size);
+    host_uart_output(pData, Size);
+    pthread_mutex_unlock(&hal_lock);
+
+    // the caller polls the TXE flag until the last byte is out, like HAL_Delay() polls the tick
+    if (!sim_clock.real_time_delays) {
+        HostSim_Advance(line_ns);
+        return HAL_OK;
+    }
+    const uint64_t deadline = HostSim_Nanos() + line_ns;
+    while (HostSim_Nanos() < deadline) {
+    }
+    return HAL_OK;
+}
+
+static struct HostUART_Transfer {
+    UART_HandleTypeDef *huart;
+    const uint8_t *data;
+    uint16_t size;
+} uart_transfer;
+
+// Runs from the interrupt thread once the last byte has left the shift register
+static void host_uart_it_complete(void *ctx) {
+    struct HostUART_Transfer *transfer = ctx;
+    UART_HandleTypeDef *huart = transfer->huart;
+    pthread_mutex_lock(&hal_lock);
+    host_uart_output(transfer->data, transfer->size);
+    huart->gState = HAL_UART_STATE_READY;
+    pthread_mutex_unlock(&hal_lock);
+
+    HAL_UART_TxCpltCallback(huart);
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size) {
+    pthread_mutex_lock(&hal_lock);
+    if (host_uart_busy(huart)) {
+        pthread_mutex_unlock(&hal_lock);
+        return HAL_BUSY;
+    }
+    assert((uart_transfer.huart == NULL || uart_transfer.huart == huart) && "Only one UART transmits by interrupt");
+    uart_transfer.huart = huart;
+    uart_transfer.data = pData;
+    uart_transfer.size = Size;
+    const uint64_t line_ns = host_uart_account(huart, Size);
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+    pthread_mutex_unlock(&hal_lock);
+
+    HostIRQ_Schedule(HostSim_Nanos() + line_ns, host_uart_it_complete, &uart_transfer);
+    return HAL_OK;
+}
+
+HAL_UART_StateTypeDef HAL_UART_GetState(const UART_HandleTypeDef *huart) {
+    return huart->gState;
+}
+
+/* TIM -----------------------------------------------------------------------*/
+static uint64_t host_tim_ticks_at(const TIM_HandleTypeDef *htim, uint64_t at_ns) {
+    const uint64_t tick_hz = SystemCoreClock / (htim->Init.Prescaler + 1U);
+    return at_ns * tick_hz / 1000000000ULL;
+}
+
+static uint64_t host_tim_ticks(const TIM_HandleTypeDef *htim) {
+    return host_tim_ticks_at(htim, HostSim_Nanos());
+}
+
+uint32_t HostTim_GetCounterAt(TIM_HandleTypeDef *htim, uint64_t at_ns) {
+    if (htim->Instance->HOST_ENCODER) {
+        return htim->Instance->CNT;
+    }
+    const uint64_t period = (uint64_t) htim->Init.Period + 1U;
+    return (uint32_t) ((host_tim_ticks_at(htim, at_ns) - htim->Instance->HOST_OFFSET) % period);
+}
+
+uint32_t HostTim_GetCounter(TIM_HandleTypeDef *htim) {
+    return HostTim_GetCounterAt(htim, HostSim_Nanos());
+}
+
+void HostTim_SetCounter(TIM_HandleTypeDef *htim, uint32_t counter) {
+    if (htim->Instance->HOST_ENCODER) {
+        htim->Instance->CNT = counter;
+        return;
+    }
+    htim->Instance->HOST_OFFSET = (int64_t) host_tim_ticks(htim) - counter;
+}
+
+static struct {
+    HostTIM_PulseListener_t listener;
+    void *ctx;
+} tim_listeners[HOST_MAX_TIM_LISTENERS];
+
+void HostTIM_AddPulseListener(HostTIM_PulseListener_t listener, void *ctx) {
+    for (size_t i = 0; i < HOST_MAX_TIM_LISTENERS; i++) {
+        if (tim_listeners[i].listener == NULL) {
+            tim_listeners[i].listener = listener;
+            tim_listeners[i].ctx = ctx;
+            return;
+        }
+    }
+    assert(false && "Too many TIM listeners");
+}
+
+static uint64_t host_tim_ticks_to_ns(const TIM_TypeDef *tim, uint64_t ticks) {
+    return ticks * (tim->PSC + 1U) * 1000000000ULL / SystemCoreClock;
+}
+
+// Called with hal_lock held; reports the pulse of the period that starts at start_ns and returns its end
+static uint64_t host_tim_period(TIM_HandleTypeDef *htim, uint64_t start_ns) {
+    const TIM_TypeDef *tim = htim->Instance;
+    const uint64_t rising_ns = start_ns + host_tim_ticks_to_ns(tim, tim->CCR1);
+    const uint64_t falling_ns = start_ns + host_tim_ticks_to_ns(tim, (uint64_t) tim->ARR + 1U);
+    for (size_t i = 0; i < HOST_MAX_TIM_LISTENERS && tim_listeners[i].listener; i++) {
+        tim_listeners[i].listener(tim_listeners[i].ctx, htim, rising_ns, falling_ns);
+    }
+    return falling_ns;
+}
+
+// Update event of a free-running timer: starts the next period unless the counter was stopped meanwhile
+static void host_tim_update(void *ctx) {
+    TIM_HandleTypeDef *htim = ctx;
+    TIM_TypeDef *tim = htim->Instance;
+    pthread_mutex_lock(&hal_lock);
+    if (READ_BIT(tim->CR1, TIM_CR1_CEN) && !READ_BIT(tim->CR1, TIM_CR1_OPM)) {
+        tim->HOST_UPDATE_NS = host_tim_period(htim, tim->HOST_UPDATE_NS);
+        HostIRQ_Schedule(tim->HOST_UPDATE_NS, host_tim_update, htim);
+    } else {
+        CLEAR_BIT(tim->CR1, TIM_CR1_CEN);
+        tim->HOST_RUNNING = false;
+    }
+    pthread_mutex_unlock(&hal_lock);
+}
+
+void HostTim_Enable(TIM_HandleTypeDef *htim) {
+    TIM_TypeDef *tim = htim->Instance;
+    pthread_mutex_lock(&hal_lock);
+    if (READ_BIT(tim->CR1, TIM_CR1_OPM)) {
+        // the counter stops by itself at the update event
+        host_tim_period(htim, HostSim_Nanos());
+    } else if (!tim->HOST_RUNNING) {
+        SET_BIT(tim->CR1, TIM_CR1_CEN);
+        tim->HOST_RUNNING = true;
+        tim->HOST_UPDATE_NS = host_tim_period(htim, HostSim_Nanos());
+        HostIRQ_Schedule(tim->HOST_UPDATE_NS, host_tim_update, htim);
+    } else {
+        // re-enabled before the update event of the period in progress, which carries on
+        SET_BIT(tim->CR1, TIM_CR1_CEN);
+    }
+    pthread_mutex_unlock(&hal_lock);
+}
+
+static uint64_t host_tim_overflows_at(const TIM_HandleTypeDef *htim, uint64_t at_ns) {
+    return (host_tim_ticks_at(htim, at_ns) - htim->Instance->HOST_OFFSET) / ((uint64_t) htim->Init.Period + 1U);
+}
+
+static uint64_t host_tim_overflows(const TIM_HandleTypeDef *htim) {
+    return host_tim_overflows_at(htim, HostSim_Nanos());
+}
+
+void HostTim_EnableIT(TIM_HandleTypeDef *htim, uint32_t interrupt) {
+    TIM_TypeDef *tim = htim->Instance;
+    pthread_mutex_lock(&hal_lock);
+    if (READ_BIT(interrupt, TIM_IT_UPDATE) && !READ_BIT(tim->DIER, TIM_IT_UPDATE)) {
+        tim->HOST_OVERFLOWS = host_tim_overflows(htim);
+    }
+    SET_BIT(tim->DIER, interrupt);
+    pthread_mutex_unlock(&hal_lock);
+}
+
+void HostTIM_ServeOverflows(TIM_HandleTypeDef *htim) {
+    HostTIM_ServeOverflowsUntil(htim, HostSim_Nanos());
+}
+
+void HostTIM_ServeOverflowsUntil(TIM_HandleTypeDef *htim, uint64_t at_ns) {
+    TIM_TypeDef *tim = htim->Instance;
+    pthread_mutex_lock(&hal_lock);
+    const bool enabled = READ_BIT(tim->DIER, TIM_IT_UPDATE);
+    const uint64_t overflows = host_tim_overflows_at(htim, at_ns);
+    // an edge before an overflow already served finds nothing left to serve
+    uint64_t pending = 0;
+    if (overflows > tim->HOST_OVERFLOWS) {
+        pending = enabled ? overflows - tim->HOST_OVERFLOWS : 0U;
+        tim->HOST_OVERFLOWS = overflows;
+    }
+    pthread_mutex_unlock(&hal_lock);
+    for (uint64_t i = 0; i < pending; i++) {
+        // the flag is cleared before the callback, as HAL_TIM_IRQHandler does
+        HAL_TIM_PeriodElapsedCallback(htim);
+    }
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    (void) htim;
+    (void) Channel;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    (void) htim;
+    (void) Channel;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    (void) htim;
+    (void) Channel;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OnePulse_Start(TIM_HandleTypeDef *htim, uint32_t OutputChannel) {
+    (void) htim;
+    (void) OutputChannel;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    (void) Channel;
+    htim->Instance->HOST_ENCODER = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) {
+    HostTim_EnableIT(htim, TIM_IT_UPDATE);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim) {
+    __HAL_TIM_DISABLE_IT(htim, TIM_IT_UPDATE);
+    return HAL_OK;
+}
+
+uint32_t HAL_TIM_ReadCapturedValue(const TIM_HandleTypeDef *htim, uint32_t Channel) {
+    return *(&htim->Instance->CCR1 + (Channel >> 2U));
+}
@@ -0,0 +1,59 @@
+/*
+ * Replays a capture of the console UART and prints one line per telemetry frame (see telemetry.h),
+ * followed by the number of frames, CRC errors and frames lost according to the sequence numbers.
+ *
+ * Usage: my_sensors_telemetry [capture file, - or nothing for stdin]
+ */
+#include "telemetry.h"
+#include <stdio.h>
+#include <string.h>
+
+static void print_sample(const Telemetry_Sample *sample) {
+    printf("%10u ms  seq %5u  ", sample->timestamp_ms, sample->seq);
+    switch (sample->type) {
+        case TELEMETRY_ENVIRONMENT:
+            printf("environment  %.2f C  %.1f Pa  %.2f %%RH\n", sample->environment.temperature_centi_c / 100.0,
+                   sample->environment.pressure_deci_pa / 10.0, sample->environment.humidity_centi_pct / 100.0);
+            break;
+        case TELEMETRY_DISTANCE:
+            if (sample->distance.distance_mm == TELEMETRY_DISTANCE_INVALID) {
+                printf("distance     no echo\n");
+            } else {
+                printf("distance     %u mm\n", sample->distance.distance_mm);
+            }
+            break;
+        case TELEMETRY_MOTOR:
+            printf("motor        M%u command %u speed %u\n", sample->motor.motor, sample->motor.command,
+                   sample->motor.speed);
+            break;
+    }
+}
+
+int main(int argc, char **argv) {
+    FILE *input = stdin;
+    if (argc > 1 && strcmp(argv[1], "-") != 0) {
+        input = fopen(argv[1], "rb");
+        if (input == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    Telemetry_Parser parser = {0};
+    Telemetry_Sample sample;
+    uint64_t bytes = 0;
+    int c;
+    while ((c = fgetc(input)) != EOF) {
+        bytes++;
+        if (Telemetry_Parse(&parser, (uint8_t) c, &sample)) {
+            print_sample(&sample);
+        }
+    }
+    if (input != stdin) {
+        fclose(input);
+    }
+
+    printf("%u frames in %llu B, %u CRC errors, %u frames lost\n", parser.frames, (unsigned long long) bytes,
+           parser.crc_errors, parser.lost_frames);
+    return parser.crc_errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""
+Transposes a row-major font of display.c into the column-major layout of the SSD1306 display RAM.
+
+Every glyph becomes FontWidth words, one per column, with bit n set when row n of the column is lit,
+so that Display_WriteChar() can shift a whole column into place and write it page byte by page byte.
+
+Usage: tools/gen_font_columns.py [Core/Src/display.c] > Core/Inc/display_font_columns.h
+"""
+import re
+import sys
+
+FONTS = [
+    # name of the row table, width, height, name of the column table
+    ("Font_data_11x18", 11, 18, "Font_columns_11x18"),
+]
+FIRST_CHAR, LAST_CHAR = 32, 126
+
+
+def read_rows(source, name):
+    match = re.search(r"\b" + name + r"\s*\[\]\s*=\s*\{(.*?)\};", source, re.S)
+    if match is None:
+        sys.exit("%s not found" % name)
+    body = re.sub(r"//[^\n]*", "", match.group(1))
+    return [int(value, 16) for value in re.findall(r"0x[0-9A-Fa-f]+", body)]
+
+
+def transpose(rows, width, height):
+    columns = []
+    for glyph in range(LAST_CHAR - FIRST_CHAR + 1):
+        glyph_rows = rows[glyph * height:(glyph + 1) * height]
+        for x in range(width):
+            word = 0
+            for y, row in enumerate(glyph_rows):
+                if (row << x) & 0x8000:
+                    word |= 1 << y
+            columns.append(word)
+    return columns
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "Core/Src/display.c"
+    with open(path) as f:
+        source = f.read()
+
+    print("// Generated by tools/gen_font_columns.py from the fonts of display.c, do not edit.")
+    print("#ifndef MY_SENSORS_DISPLAY_FONT_COLUMNS_H")
+    print("#define MY_SENSORS_DISPLAY_FONT_COLUMNS_H")
+    print()
+    print("#include <stdint.h>")
+    for name, width, height, columns_name in FONTS:
+        rows = read_rows(source, name)
+        assert len(rows) == (LAST_CHAR - FIRST_CHAR + 1) * height, name
+        columns = transpose(rows, width, height)
+        print()
+        print("// %dx%d, one word per column, bit n is row n" % (width, height))
+        print("static const uint32_t %s [] = {" % columns_name)
+        for glyph in range(LAST_CHAR - FIRST_CHAR + 1):
+            words = columns[glyph * width:(glyph + 1) * width]
+            char = chr(FIRST_CHAR + glyph)
+            # a line comment ending in a backslash would swallow the next line
+            comment = {" ": "// sp", "\\": "/* \\ */"}.get(char, "// " + char)
+            print("        " + ", ".join("0x%05X" % word for word in words) + ",   " + comment)
+        print("};")
+    print()
+    print("#endif //MY_SENSORS_DISPLAY_FONT_COLUMNS_H")
+
+
+if __name__ == "__main__":
+    main()